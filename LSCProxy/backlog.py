@@ -0,0 +1,118 @@
+"""
+Receive Backlog Control
+
+This module keeps the receive latency of a stream bounded by dropping frames
+at safe points instead of flushing the TUTK buffers on a timer. It mirrors
+Backlog in libs/framepump.
+
+The lag of a frame is how much later than its camera timestamp promised it
+was received, relative to the lowest lag seen so far. The SDK does not report
+how many video frames it holds, but a backlog shows up in the lag of every
+frame that comes out of it.
+
+Once the lag passes the limit, video is dropped up to the next keyframe that
+is back within the limit, so the decoder never sees a GOP with frames missing.
+Audio frames decode on their own, so audio is only dropped until the lag is
+back below half the limit.
+
+Author:
+    Berobloom
+"""
+
+import time
+
+# The camera and host clocks drift apart. Letting the baseline rise by up to
+# 1 ms per second absorbs that, while a real backlog grows much faster.
+BASELINE_DRIFT_MS_PER_S = 1
+
+# Timestamp jumps beyond this restart the measurement
+MAX_TIMESTAMP_JUMP_MS = 5000
+
+
+class Backlog():
+    """
+    Backlog Control Class, use one per stream.
+
+    Methods:
+        __init__(self, max_lag_ms, keyframes_only): Creates the control, 0 never drops.
+        accept(self, camera_timestamp_ms, keyframe): Decides whether to pass a frame on.
+
+    Attributes:
+        last_lag_ms: Lag of the last frame with a camera timestamp, also measured
+            when dropping is disabled.
+        dropping: True while frames are dropped.
+    """
+
+    def __init__(self, max_lag_ms, keyframes_only):
+        self._max_lag_ms = max_lag_ms
+        self._keyframes_only = keyframes_only
+        self._started = False
+        self.dropping = False
+        self.last_lag_ms = 0
+        self._dropped = 0
+        self._min_offset_ms = 0
+        self._last_timestamp_ms = 0
+        self._baseline_time = 0.0
+
+    def _lag_ms(self, camera_timestamp_ms, now):
+        offset_ms = int(now * 1000) - camera_timestamp_ms
+        step_ms = (camera_timestamp_ms - self._last_timestamp_ms) & 0xFFFFFFFF
+        if step_ms >= 0x80000000:
+            step_ms -= 0x100000000
+        self._last_timestamp_ms = camera_timestamp_ms
+
+        if (not self._started or step_ms < 0 or step_ms > MAX_TIMESTAMP_JUMP_MS
+                or offset_ms <= self._min_offset_ms):
+            self._started = True
+            self._min_offset_ms = offset_ms
+            self._baseline_time = now
+            return 0
+
+        drift_s = int(now - self._baseline_time)
+        if drift_s > 0:
+            self._min_offset_ms = min(offset_ms,
+                                      self._min_offset_ms + drift_s * BASELINE_DRIFT_MS_PER_S)
+            self._baseline_time += drift_s
+        return offset_ms - self._min_offset_ms
+
+    def accept(self, camera_timestamp_ms, keyframe):
+        """
+        Decides whether a received frame should be passed on.
+
+        Args:
+            camera_timestamp_ms (int): FrameInfoT.timestamp of the frame.
+            keyframe (bool): Whether the frame starts a GOP, ignored for audio.
+
+        Returns:
+            bool: True if the frame should be passed on, False if it should be dropped.
+        """
+
+        # Without camera timestamps there is nothing to measure the lag against
+        if camera_timestamp_ms == 0:
+            return True
+
+        lag = self._lag_ms(camera_timestamp_ms, time.monotonic())
+        self.last_lag_ms = lag
+        if self._max_lag_ms <= 0:
+            return True
+
+        if self.dropping:
+            if self._keyframes_only:
+                caught_up = keyframe and lag <= self._max_lag_ms
+            else:
+                caught_up = lag < self._max_lag_ms / 2
+            if not caught_up:
+                self._dropped += 1
+                return False
+            print(f"[backlog] Caught up after dropping {self._dropped} frames")
+            self.dropping = False
+            self._dropped = 0
+            return True
+
+        if lag > self._max_lag_ms:
+            target = "keyframe" if self._keyframes_only else "live frame"
+            print(f"[backlog] {lag} ms behind, dropping to the next {target}")
+            self.dropping = True
+            self._dropped = 1
+            return False
+        return True
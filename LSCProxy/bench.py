@@ -0,0 +1,726 @@
+"""
+Benchmark and Replay Harness
+
+This script measures the TUTK to RTSP pipeline without a live camera. The
+capture mode records what the camera sends, the replay mode plays a capture back
+through the real pipeline and reports how the pipeline kept up.
+
+For the replay the TUTK library is replaced by libs/x64/libreplay.so, which
+plays back the capture behind the same API. Everything downstream is the code
+the proxy runs: the Python receive loops or the native frame pump, the FIFOs,
+ffmpeg or the native publisher, and mediamtx. An RTSP reader at the end of the
+pipeline matches the frames it receives to the frames of the capture.
+
+Usage:
+    python3 bench.py capture OUTPUT [--uid UID] [--seconds N]
+    python3 bench.py replay CAPTURE [--pipeline python|batch|fifo|native] [--speed 1|max]
+        [--reencode] [--json]
+
+Functions:
+    - capture(args): Records the frames of a camera into a capture file.
+    - replay(args): Plays a capture back through the pipeline and reports the results.
+
+Classes:
+    - CaptureWriter: Writes the capture file, see libs/replay/replay.h.
+    - RtspReader: Reads the published stream like an RTSP client would.
+    - Sampler: Samples the CPU time per stream and the memory of the proxy.
+
+Note:
+    - Run it from the LSCProxy directory, like main.py.
+    - ffmpeg reads the FIFOs as fast as the frames arrive, so at full speed
+      the FIFO pipelines are bounded by ffmpeg and not paced at 1x.
+
+Author:
+    Berobloom
+"""
+
+import argparse
+import ctypes
+import hashlib
+import json
+import os
+import pathlib
+import socket
+import statistics
+import struct
+import sys
+import tempfile
+import threading
+import time
+import yaml
+from tutk import FrameInfoT
+import constants
+
+REPLAY_LIB_PATH = constants.settings["IOTC_LIB_PATH"].parent / "libreplay.so"
+
+CAPTURE_MAGIC = b"LSCCAP01"
+RECORD_HEADER = struct.Struct("<B3xIQ")
+KIND_VIDEO = 0
+KIND_AUDIO = 1
+
+PIPELINES = {
+    "python": {"native_pump": False, "publisher": "ffmpeg", "recv_batch_frames": 1},
+    "batch": {"native_pump": False, "publisher": "ffmpeg"},
+    "fifo": {"native_pump": True, "publisher": "ffmpeg"},
+    "native": {"native_pump": True, "publisher": "native"},
+}
+
+# How long the pipeline gets to deliver the last frames after the capture ended
+DRAIN_S = 3
+
+# The capture plays at 1x until the reader receives video, so that the stream
+# is published and read before the measurement starts, but at most this long
+WARMUP_S = 15
+
+H264_SLICE_TYPES = (1, 5)
+
+
+class CaptureWriter():
+    """
+    Writes the capture file, see libs/replay/replay.h for the format.
+
+    Attributes:
+        frames: Number of frames written so far.
+        _file: The open capture file.
+        _lock: Serializes the writes of the video and the audio thread.
+        _started: Monotonic time the capture was started.
+
+    Methods:
+        __init__(self, path): Creates the capture file.
+        write(self, kind, frame_info, data): Appends a frame.
+        close(self): Closes the capture file.
+    """
+
+    def __init__(self, path):
+        self.frames = 0
+        # pylint: disable=consider-using-with
+        self._file = open(path, "wb")
+        self._file.write(CAPTURE_MAGIC)
+        self._lock = threading.Lock()
+        self._started = time.monotonic()
+
+    def write(self, kind, frame_info, data):
+        """
+        Appends a frame.
+
+        Args:
+            kind (int): KIND_VIDEO or KIND_AUDIO.
+            frame_info (FrameInfoT): Frame information of the frame.
+            data: Bytes-like object with the frame.
+
+        Returns:
+            None
+        """
+
+        received_us = int((time.monotonic() - self._started) * 1e6)
+        with self._lock:
+            self._file.write(RECORD_HEADER.pack(kind, len(data), received_us))
+            self._file.write(bytes(frame_info))
+            self._file.write(data)
+            self.frames += 1
+
+    def close(self):
+        """
+        Closes the capture file.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            self._file.close()
+
+
+def read_video_frames(path):
+    """
+    Reads the video frames of a capture.
+
+    Args:
+        path (str): Path to the capture.
+
+    Returns:
+        list: The data of every video frame, in order.
+    """
+
+    frames = []
+    frame_info_size = ctypes.sizeof(FrameInfoT)
+    with open(path, "rb") as file:
+        if file.read(len(CAPTURE_MAGIC)) != CAPTURE_MAGIC:
+            raise ValueError(f"{path} is not a capture")
+        while True:
+            header = file.read(RECORD_HEADER.size + frame_info_size)
+            if len(header) < RECORD_HEADER.size + frame_info_size:
+                break
+            kind, size, _ = RECORD_HEADER.unpack_from(header)
+            data = file.read(size)
+            if kind == KIND_VIDEO:
+                frames.append(data)
+    return frames
+
+
+def frame_key(nal_units):
+    """
+    Identifies a frame by its slices, which pass through the pipeline unchanged
+    unless ffmpeg re-encodes. Parameter sets and SEI may be added or dropped.
+
+    Args:
+        nal_units (list): NAL units of the frame, without start codes.
+
+    Returns:
+        bytes: Digest of the slices, or None if the frame has none.
+    """
+
+    digest = hashlib.blake2b(digest_size=16)
+    found = False
+    for nal in nal_units:
+        nal = nal.rstrip(b"\0")
+        if nal and nal[0] & 0x1F in H264_SLICE_TYPES:
+            digest.update(nal)
+            found = True
+    return digest.digest() if found else None
+
+
+def split_annex_b(data):
+    """
+    Splits an H.264 Annex B byte stream into its NAL units.
+
+    Args:
+        data (bytes): The byte stream.
+
+    Returns:
+        list: The NAL units, without start codes.
+    """
+
+    nal_units = []
+    start = data.find(b"\0\0\1")
+    while start >= 0:
+        end = data.find(b"\0\0\1", start + 3)
+        nal_units.append(data[start + 3:end if end >= 0 else len(data)])
+        start = end
+    return nal_units
+
+
+class RtspReader():
+    """
+    Reads the published stream like an RTSP client would, over TCP, and records
+    when every video frame arrived.
+
+    Attributes:
+        video_frames: List of (arrival time in microseconds, frame key).
+        audio_packets: Number of audio RTP packets received.
+        _url: RTSP URL to read.
+        _stop: Event that ends the reading.
+
+    Methods:
+        __init__(self, url): Initializes the reader.
+        run(self): Connects, retrying until the stream is published, and reads.
+        stop(self): Stops reading.
+    """
+
+    def __init__(self, url):
+        self.video_frames = []
+        self.audio_packets = 0
+        self._url = url
+        self._stop = threading.Event()
+        self._cseq = 0
+        self._session = None
+
+    def _request(self, sock, reader, method, url, headers=""):
+        self._cseq += 1
+        session = f"Session: {self._session}\r\n" if self._session else ""
+        sock.sendall(f"{method} {url} RTSP/1.0\r\nCSeq: {self._cseq}\r\n{session}{headers}\r\n"
+                     .encode("utf-8"))
+        status = reader.readline().decode("utf-8")
+        response = {}
+        while True:
+            line = reader.readline().decode("utf-8").strip()
+            if not line:
+                break
+            key, value = line.split(":", 1)
+            response[key.lower()] = value.strip()
+        body = reader.read(int(response.get("content-length", 0)))
+        if "session" in response:
+            self._session = response["session"].split(";")[0]
+        return status.startswith("RTSP/1.0 200"), body.decode("utf-8")
+
+    def _setup(self, sock, reader):
+        ok, sdp = self._request(sock, reader, "DESCRIBE", self._url,
+                                "Accept: application/sdp\r\n")
+        if not ok:
+            return None
+        channels = {}
+        media = None
+        for line in sdp.splitlines():
+            if line.startswith("m="):
+                media = line[2:].split()[0]
+            elif line.startswith("a=control:") and media is not None:
+                control = line[len("a=control:"):]
+                url = control if control.startswith("rtsp://") else f"{self._url}/{control}"
+                channel = 2 * len(channels)
+                ok, _ = self._request(sock, reader, "SETUP", url,
+                                      "Transport: RTP/AVP/TCP;unicast;"
+                                      f"interleaved={channel}-{channel + 1}\r\n")
+                if not ok:
+                    return None
+                channels[channel] = media
+                media = None
+        ok, _ = self._request(sock, reader, "PLAY", self._url)
+        return channels if ok else None
+
+    def _read(self, reader, channels):
+        nal_units = []
+        fragment = None
+        while not self._stop.is_set():
+            if reader.read(1) != b"$":
+                continue
+            channel = reader.read(1)[0]
+            packet = reader.read(struct.unpack(">H", reader.read(2))[0])
+            media = channels.get(channel)
+            if media == "audio":
+                self.audio_packets += 1
+            if media != "video" or len(packet) < 12:
+                continue
+
+            offset = 12 + 4 * (packet[0] & 0x0F)
+            if packet[0] & 0x10:
+                offset += 4 + 4 * struct.unpack_from(">H", packet, offset + 2)[0]
+            payload = packet[offset:]
+            nal_type = payload[0] & 0x1F
+            if nal_type == 24:
+                position = 1
+                while position + 2 <= len(payload):
+                    size = struct.unpack_from(">H", payload, position)[0]
+                    nal_units.append(payload[position + 2:position + 2 + size])
+                    position += 2 + size
+            elif nal_type == 28:
+                if payload[1] & 0x80:
+                    fragment = bytearray([(payload[0] & 0xE0) | (payload[1] & 0x1F)])
+                if fragment is not None:
+                    fragment += payload[2:]
+                    if payload[1] & 0x40:
+                        nal_units.append(bytes(fragment))
+                        fragment = None
+            else:
+                nal_units.append(payload)
+
+            # The marker bit ends an access unit
+            if packet[1] & 0x80:
+                self.video_frames.append((time.monotonic_ns() // 1000, frame_key(nal_units)))
+                nal_units = []
+
+    def run(self):
+        """
+        Connects, retrying until the stream is published, and reads it until stop().
+
+        Returns:
+            None
+        """
+
+        host, port = self._url.split("/")[2].split(":")
+        while not self._stop.is_set():
+            try:
+                with socket.create_connection((host, int(port)), timeout=5) as sock:
+                    reader = sock.makefile("rb")
+                    channels = self._setup(sock, reader)
+                    if channels is not None:
+                        self._read(reader, channels)
+            except (OSError, IndexError, ValueError, struct.error):
+                pass
+            self._session = None
+            self._stop.wait(0.2)
+
+    def stop(self):
+        """
+        Stops reading.
+
+        Returns:
+            None
+        """
+
+        self._stop.set()
+
+
+def _proc_stat(path):
+    with open(path, "r", encoding="utf-8") as file:
+        stat = file.read()
+    comm = stat[stat.index("(") + 1:stat.rindex(")")]
+    fields = stat[stat.rindex(")") + 2:].split()
+    # ppid, utime and stime, see proc(5)
+    return comm, int(fields[1]), int(fields[11]) + int(fields[12])
+
+
+def _rss_kb(pid):
+    try:
+        with open(f"/proc/{pid}/status", "r", encoding="utf-8") as file:
+            for line in file:
+                if line.startswith("VmRSS:"):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return 0
+
+
+class Sampler():
+    """
+    Samples the CPU time per stream and the memory of the proxy and its children.
+
+    Threads count towards the stream their name names: the native threads are
+    called fp-video-rx etc., the Python threads <camera>-video-rx etc. ffmpeg and
+    mediamtx are counted as a whole.
+
+    Attributes:
+        ticks: Dictionary of group name to CPU clock ticks used.
+        peak_rss_kb: Dictionary of process name to the largest resident set seen.
+
+    Methods:
+        sample(self): Takes a sample.
+        cpu_percent(self, seconds): Returns the CPU use per group over the given time.
+    """
+
+    def __init__(self):
+        self.ticks = {}
+        self.peak_rss_kb = {}
+        self._last = {}
+
+    @staticmethod
+    def _group(name):
+        for group in ("video", "audio", "ffmpeg", "mediamtx"):
+            if group in name:
+                return group
+        return "other"
+
+    def _add(self, key, group, ticks):
+        self.ticks[group] = self.ticks.get(group, 0) + ticks - self._last.get(key, ticks)
+        self._last[key] = ticks
+
+    def sample(self):
+        """
+        Takes a sample.
+
+        Returns:
+            None
+        """
+
+        python_names = {thread.native_id: thread.name for thread in threading.enumerate()}
+        for task in os.listdir("/proc/self/task"):
+            try:
+                comm, _, ticks = _proc_stat(f"/proc/self/task/{task}/stat")
+            except OSError:
+                continue
+            name = python_names.get(int(task), comm)
+            self._add(("task", int(task)), self._group(name), ticks)
+        self.peak_rss_kb["proxy"] = max(self.peak_rss_kb.get("proxy", 0), _rss_kb(os.getpid()))
+
+        for pid in os.listdir("/proc"):
+            if not pid.isdigit():
+                continue
+            try:
+                comm, ppid, ticks = _proc_stat(f"/proc/{pid}/stat")
+            except OSError:
+                continue
+            if ppid != os.getpid():
+                continue
+            group = self._group(comm)
+            self._add(("process", int(pid)), group, ticks)
+            self.peak_rss_kb[group] = max(self.peak_rss_kb.get(group, 0), _rss_kb(pid))
+
+    def cpu_percent(self, seconds):
+        """
+        Returns the CPU use per group.
+
+        Args:
+            seconds (float): Time the samples span.
+
+        Returns:
+            dict: Group name to the percentage of one core.
+        """
+
+        clock_ticks = os.sysconf("SC_CLK_TCK")
+        return {group: round(100 * ticks / clock_ticks / seconds, 1)
+                for group, ticks in sorted(self.ticks.items())}
+
+
+def percentile(values, fraction):
+    """
+    Returns a percentile of the values.
+
+    Args:
+        values (list): The values, not empty.
+        fraction (float): The percentile, e.g. 0.99.
+
+    Returns:
+        float: The value below which the given fraction of the values lies.
+    """
+
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def match_latencies(capture_frames, delivered_us, received, since_us):
+    """
+    Matches the frames the reader received to the frames of the capture.
+
+    Args:
+        capture_frames (list): Data of the video frames in the capture.
+        delivered_us (list): Time every capture frame was handed to the pipeline.
+        received (list): (arrival time, frame key) of every frame the reader received.
+        since_us (int): Only frames handed to the pipeline from then on are matched.
+
+    Returns:
+        list: Latency in milliseconds of every matched frame.
+    """
+
+    pending = {}
+    for data, delivered in zip(capture_frames, delivered_us):
+        key = frame_key(split_annex_b(data))
+        if key is not None and delivered >= since_us:
+            pending.setdefault(key, []).append(delivered)
+
+    latencies = []
+    for arrived, key in received:
+        times = pending.get(key, [])
+        # Frames with the same slices, e.g. a static scene, are matched to the
+        # latest one sent before the arrival, the earlier ones count as lost
+        sent = [delivered for delivered in times if delivered <= arrived]
+        if sent:
+            latencies.append((arrived - sent[-1]) / 1000)
+            del times[:len(sent)]
+    return latencies
+
+
+def capture(args):
+    """
+    Records the frames of a camera into a capture file until the time is up or
+    Ctrl+C is pressed.
+
+    Args:
+        args (argparse.Namespace): The command line arguments.
+
+    Returns:
+        None
+    """
+
+    # Imported here, so that a replay loads the TUTK library in its place
+    # pylint: disable=import-outside-toplevel
+    from camera import load_cameras
+    from supervisor import SessionSupervisor
+    from utils import usleep, Poller
+
+    with open(constants.settings["SETTINGS_PATH"], "r", encoding="utf-8") as file:
+        data = yaml.safe_load(file)
+    camera = load_cameras(data, args.uid)[0]
+    tutk = camera.tutk
+    tutk.iotc_initialize2(0)
+    tutk.av_initialize(2)
+
+    supervisor = SessionSupervisor(camera)
+    if not supervisor.connect():
+        return
+    writer = CaptureWriter(args.output)
+    deadline = time.monotonic() + args.seconds
+    closed = (constants.av_error["AV_ER_SESSION_CLOSE_BY_REMOTE"],
+              constants.av_error["AV_ER_REMOTE_TIMEOUT_DISCONNECT"],
+              constants.iotc_error["IOTC_ER_INVALID_SID"])
+
+    def record_video():
+        buf = tutk.create_buf(constants.settings["VIDEO_BUF_SIZE"])
+        poller = Poller()
+        while time.monotonic() < deadline and not tutk.graceful_shutdown:
+            status = tutk.av_recv_framedata2(buf, constants.settings["VIDEO_BUF_SIZE"])
+            if status == constants.av_error["AV_ER_DATA_NOREADY"]:
+                usleep(poller.next_delay())
+            elif status in closed:
+                break
+            elif status >= 0:
+                poller.frame_received()
+                writer.write(KIND_VIDEO, tutk.video_frame_info, buf.raw[:status])
+
+    def record_audio():
+        buf = tutk.create_buf(constants.settings["AUDIO_BUF_SIZE"])
+        poller = Poller()
+        while time.monotonic() < deadline and not tutk.graceful_shutdown:
+            status = tutk.av_check_audio_buf()
+            if status < 0:
+                break
+            if status == 0:
+                usleep(poller.next_delay())
+                continue
+            status = tutk.av_recv_audio_data(buf, constants.settings["AUDIO_BUF_SIZE"])
+            if status in closed:
+                break
+            if status >= 0:
+                poller.frame_received()
+                writer.write(KIND_AUDIO, tutk.audio_frame_info, buf.raw[:status])
+
+    threads = [threading.Thread(target=record_video, name="capture-video"),
+               threading.Thread(target=record_audio, name="capture-audio")]
+    for thread in threads:
+        thread.start()
+    print(f"Capturing {args.seconds} s from {camera.uid} to {args.output}...")
+    try:
+        for thread in threads:
+            while thread.is_alive():
+                thread.join(1)
+    except KeyboardInterrupt:
+        tutk.graceful_shutdown = True
+        for thread in threads:
+            thread.join()
+    writer.close()
+    supervisor.disconnect()
+    tutk.iotc_de_initialize()
+    print(f"Captured {writer.frames} frames")
+
+
+def replay(args):
+    """
+    Plays a capture back through the pipeline and reports frames/s, CPU per
+    stream, latency and memory.
+
+    Args:
+        args (argparse.Namespace): The command line arguments.
+
+    Returns:
+        dict: The results.
+    """
+
+    if not REPLAY_LIB_PATH.exists():
+        print(f"{REPLAY_LIB_PATH} not built, see README.md")
+        sys.exit(1)
+
+    # Everything below loads the replay library instead of the SDK
+    constants.settings["IOTC_LIB_PATH"] = REPLAY_LIB_PATH
+    constants.settings["FIFOS_DIR"] = pathlib.Path(tempfile.mkdtemp(prefix="lscbench"))
+    # pylint: disable=import-outside-toplevel
+    from camera import Camera
+    from main import thread_connect_ccr
+    from services import RTSPServer
+
+    replay_lib = ctypes.CDLL(str(REPLAY_LIB_PATH), mode=os.RTLD_LAZY)
+    replay_lib.replay_open.argtypes = [ctypes.c_char_p]
+    replay_lib.replay_set_speed.argtypes = [ctypes.c_double]
+    replay_lib.replay_video_times.argtypes = [ctypes.POINTER(ctypes.c_int64), ctypes.c_int]
+    speed = 0.0 if args.speed == "max" else float(args.speed)
+    if replay_lib.replay_open(args.capture.encode("utf-8")) < 0:
+        print(f"Cannot read {args.capture}")
+        sys.exit(1)
+    capture_frames = read_video_frames(args.capture)
+
+    proxy_settings = dict(PIPELINES[args.pipeline])
+    proxy_settings.update({
+        "passthrough": not args.reencode,
+        # Every frame should arrive, so that the latency covers all of them
+        "max_latency_ms": 0,
+        "ring_policy": "block",
+    })
+
+    rtsp_server = RTSPServer()
+    threading.Thread(target=rtsp_server.start, daemon=True).start()
+    time.sleep(2)
+
+    camera = Camera("bench", "REPLAY", "bench", "bench")
+    camera.create_fifos()
+    camera.tutk.iotc_initialize2(0)
+    camera.tutk.av_initialize(2)
+
+    reader = RtspReader(camera.rtsp_url)
+    reader_thread = threading.Thread(target=reader.run, name="bench-reader", daemon=True)
+    reader_thread.start()
+    session = threading.Thread(target=thread_connect_ccr, name="bench-session",
+                               args=(camera, None, proxy_settings))
+    session.start()
+
+    sampler = Sampler()
+    done_at = None
+    try:
+        warmup_end = time.monotonic() + WARMUP_S
+        while not reader.video_frames and not replay_lib.replay_done() and \
+                time.monotonic() < warmup_end:
+            time.sleep(0.1)
+        if not reader.video_frames:
+            print("The reader received no video during the warmup")
+
+        replay_lib.replay_set_speed(speed)
+        started = time.monotonic()
+        _, streams_started = camera.metrics.values()
+        sampler.sample()
+        while done_at is None or time.monotonic() - done_at < DRAIN_S:
+            time.sleep(1)
+            sampler.sample()
+            if done_at is None and replay_lib.replay_done():
+                done_at = time.monotonic()
+    except KeyboardInterrupt:
+        print("Replay interrupted")
+    sampled_s = time.monotonic() - started
+    elapsed_s = (done_at or time.monotonic()) - started
+    # Read before the session ends and the frame pump with its counters is freed
+    _, streams = camera.metrics.values()
+
+    camera.tutk.graceful_shutdown = True
+    session.join(10)
+    reader.stop()
+    rtsp_server.stop()
+
+    delivered = (ctypes.c_int64 * len(capture_frames))()
+    count = replay_lib.replay_video_times(delivered, len(capture_frames))
+    latencies = match_latencies(capture_frames, list(delivered)[:count], reader.video_frames,
+                                int(started * 1e6))
+
+    results = {
+        "pipeline": args.pipeline,
+        "speed": args.speed,
+        "passthrough": not args.reencode,
+        "seconds": round(elapsed_s, 2),
+        "frames_per_s": {stream: round((values["written"] - streams_started[stream]["written"])
+                                       / elapsed_s, 1)
+                         for stream, values in streams.items()},
+        "frames": {stream: {key: values[key] for key in ("frames", "written", "dropped",
+                                                         "overflows")}
+                   for stream, values in streams.items()},
+        "reader_video_frames": len(reader.video_frames),
+        "reader_audio_packets": reader.audio_packets,
+        "matched_frames": len(latencies),
+        "latency_ms": {
+            "p50": round(statistics.median(latencies), 1) if latencies else None,
+            "p99": round(percentile(latencies, 0.99), 1) if latencies else None,
+        },
+        "cpu_percent": sampler.cpu_percent(sampled_s),
+        "peak_rss_kb": sampler.peak_rss_kb,
+    }
+    if not args.reencode and not latencies and reader.video_frames:
+        print("No frame matched the capture, the latency is not available")
+
+    if args.json:
+        print(json.dumps(results))
+    else:
+        for key, value in results.items():
+            print(f"{key:>22}: {value}")
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Benchmark the TUTK to RTSP pipeline.")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    capture_parser = commands.add_parser("capture", help="record a camera into a capture file")
+    capture_parser.add_argument("output", help="capture file to write")
+    capture_parser.add_argument("--uid", help="UID of the camera, default the first camera "
+                                              "in settings.yaml")
+    capture_parser.add_argument("--seconds", type=float, default=60, help="length of the capture")
+
+    replay_parser = commands.add_parser("replay", help="replay a capture through the pipeline")
+    replay_parser.add_argument("capture", help="capture file to replay")
+    replay_parser.add_argument("--pipeline", choices=PIPELINES, default="native",
+                               help="python: Python receive loops and ffmpeg, batch: the same "
+                                    "with batched receive calls, fifo: native frame pump and "
+                                    "ffmpeg, native: native publisher")
+    replay_parser.add_argument("--speed", default="1",
+                               help="playback rate, 1 for real time or max")
+    replay_parser.add_argument("--reencode", action="store_true",
+                               help="let ffmpeg re-encode instead of passing the H.264 through")
+    replay_parser.add_argument("--json", action="store_true", help="print the results as JSON")
+
+    arguments = parser.parse_args()
+    if arguments.command == "capture":
+        capture(arguments)
+    else:
+        replay(arguments)
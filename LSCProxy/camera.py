@@ -0,0 +1,133 @@
+"""
+Camera Module.
+
+This module describes the cameras served by the proxy. Every camera gets its own
+TUTK session, its own FIFOs and its own path on the shared RTSP server.
+
+Classes:
+    Camera: Settings and per-camera resources of one camera.
+
+Functions:
+    load_cameras(data, uid): Builds the cameras from settings.yaml.
+
+Author:
+    Berobloom
+"""
+
+import os
+import re
+import constants
+from demand import Demand
+from metrics import CameraMetrics
+from snapshot import Snapshot
+from tutk import Tutk
+
+# RTSP path of a camera configured the old way, with the UID on the command line
+DEFAULT_NAME = "stream"
+
+
+class Camera():
+    """
+    Camera Class.
+
+    Attributes:
+        name: Name of the camera, also its RTSP path.
+        uid: Unique identifier (UID) of the camera.
+        av_username: TUTK AV server username.
+        av_password: TUTK AV server password.
+        mqtt_name: Name the MQTT sensors of the camera are prefixed with, None for
+            the unprefixed topics of a single camera.
+        tutk: Instance of the Tutk class for the camera's session.
+        video_fifo: Path to the video FIFO.
+        audio_fifo: Path to the audio FIFO.
+        rtsp_url: RTSP URL the camera is published to.
+        metrics: CameraMetrics of the camera.
+        demand: Demand of the camera's stream, for the on demand mode.
+        snapshot: Snapshot of the camera's last keyframe.
+
+    Methods:
+        __init__(self, name, uid, av_username, av_password, mqtt_name): Initializes the camera.
+        create_fifos(self): Creates the FIFOs of the camera.
+    """
+
+    def __init__(self, name, uid, av_username, av_password, mqtt_name=None):
+        self.name = name
+        self.uid = uid
+        self.av_username = av_username
+        self.av_password = av_password
+        self.mqtt_name = mqtt_name
+        self.tutk = Tutk(uid)
+
+        fifos_dir = constants.settings["FIFOS_DIR"] / name
+        self.video_fifo = fifos_dir / "video_fifo"
+        self.audio_fifo = fifos_dir / "audio_fifo"
+        self.rtsp_url = f"{constants.settings['RTSP_BASE_URL']}/{name}"
+        self.metrics = CameraMetrics()
+        self.demand = Demand()
+        self.snapshot = Snapshot()
+
+    def create_fifos(self):
+        """
+        Creates the FIFOs of the camera.
+
+        Returns:
+            None
+        """
+
+        fifos_dir = self.video_fifo.parent
+        if not fifos_dir.exists():
+            fifos_dir.mkdir(parents=True, exist_ok=True)
+            print(f"Directory '{fifos_dir}' created.")
+
+        for fifo_file in (self.audio_fifo, self.video_fifo):
+            if not fifo_file.exists():
+                os.mkfifo(fifo_file)
+                print(f"FIFO '{fifo_file}' created.")
+
+
+def load_cameras(data, uid=None):
+    """
+    Builds the cameras from settings.yaml.
+
+    The cameras are listed under "cameras". Without that list a single camera
+    with the UID from the command line and the "tutk_credentials" is used.
+
+    Args:
+        data (dict): Contents of settings.yaml.
+        uid (str): UID given on the command line, or None.
+
+    Returns:
+        list: The Camera objects.
+
+    Raises:
+        KeyError: If a required key is missing.
+        ValueError: If the cameras cannot be told apart.
+    """
+
+    credentials = data.get('tutk_credentials') or {}
+    entries = data.get('cameras')
+
+    if not entries:
+        if uid is None:
+            raise KeyError('cameras')
+        return [Camera(DEFAULT_NAME, uid, credentials['av_username'],
+                       credentials['av_password'])]
+
+    cameras = []
+    for entry in entries:
+        name = str(entry['name'])
+        if not re.fullmatch(r"[A-Za-z0-9_-]+", name):
+            raise ValueError(f"Camera name '{name}' may only contain letters, digits, _ and -")
+        if name.endswith("_sub"):
+            raise ValueError(f"Camera name '{name}' may not end in _sub, mediamtx serves the "
+                             f"substreams of the cameras on the paths ending in _sub")
+        if any(camera.name == name for camera in cameras):
+            raise ValueError(f"Camera name '{name}' is used twice")
+
+        av_username = entry.get('av_username', credentials.get('av_username'))
+        av_password = entry.get('av_password', credentials.get('av_password'))
+        if av_username is None or av_password is None:
+            raise KeyError(f"av_username/av_password of camera '{name}'")
+
+        cameras.append(Camera(name, entry['uid'], av_username, av_password, mqtt_name=name))
+    return cameras
@@ -4,6 +4,8 @@ Constants used in the LSCProxy project.
 import pathlib
 
 av_error = {
+    "AV_ER_BUFPARA_MAXSIZE_INSUFF": -20009,
+    "AV_ER_TIMEOUT": -20011,
     "AV_ER_DATA_NOREADY": -20012,
     "AV_ER_LOSED_THIS_FRAME": -20014,
     "AV_ER_SESSION_CLOSE_BY_REMOTE": -20015,
@@ -14,12 +16,43 @@ iotc_error = {
     "IOTC_ER_INVALID_SID": -14
 }
 
+# Modes of IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ
+video_mode = {
+    "AVIOCTRL_VIDEOMODE_NORMAL": 0x00,
+    "AVIOCTRL_VIDEOMODE_FLIP": 0x01,
+    "AVIOCTRL_VIDEOMODE_MIRROR": 0x02,
+    "AVIOCTRL_VIDEOMODE_FLIP_MIRROR": 0x03
+}
+
+# Levels of SMsgAVIoctrlSetStreamCtrlReq.quality, the lower the better
+video_quality = {
+    "AVIOCTRL_QUALITY_MAX": 0x01,
+    "AVIOCTRL_QUALITY_HIGH": 0x02,
+    "AVIOCTRL_QUALITY_MIDDLE": 0x03,
+    "AVIOCTRL_QUALITY_LOW": 0x04,
+    "AVIOCTRL_QUALITY_MIN": 0x05
+}
+
+frame_flags = {
+    "IPC_FRAME_FLAG_IFRAME": 0x01
+}
+
+# FrameInfoT.codec_id of the audio frames
+audio_codec = {
+    "MEDIA_CODEC_AUDIO_AAC": 0x88,
+    "MEDIA_CODEC_AUDIO_G711U": 0x89,
+    "MEDIA_CODEC_AUDIO_G711A": 0x8A,
+    "MEDIA_CODEC_AUDIO_PCM": 0x8C
+}
+
 settings = {
     "FIFOS_DIR": pathlib.Path().absolute() / "fifos",
-    "AUDIO_FIFO_PATH": pathlib.Path().absolute() / "fifos/audio_fifo",
-    "VIDEO_FIFO_PATH": pathlib.Path().absolute() / "fifos/video_fifo",
     "MEDIAMTX_PATH": pathlib.Path().absolute() / "rtsp/mediamtx",
+    "RTSP_BASE_URL": "rtsp://localhost:8554",
+    "MEDIAMTX_METRICS_URL": "http://127.0.0.1:9998/metrics",
     "SETTINGS_PATH": pathlib.Path().absolute() / "settings.yaml",
+    "IOTC_LIB_PATH": pathlib.Path().absolute() / "libs/x64/libIOTCAPIs_ALL.so",
+    "FRAMEPUMP_PATH": pathlib.Path().absolute() / "libs/x64/libframepump.so",
     "AUDIO_BUF_SIZE": 512,
     "VIDEO_BUF_SIZE": 64000
 }
@@ -27,6 +60,11 @@ settings = {
 ioctrl = {
     "IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ": 0x5000,
     "IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ": 0x0320,
+    "IOTYPE_USER_IPCAM_SETSTREAMCTRL_RESP": 0x0321,
+    "IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ": 0x0370,
+    "IOTYPE_USER_IPCAM_SET_VIDEOMODE_RESP": 0x0371,
     "IOTYPE_USER_IPCAM_START": 0x01FF,
-    "IOTYPE_USER_IPCAM_AUDIOSTART": 0x0300
+    "IOTYPE_USER_IPCAM_STOP": 0x02FF,
+    "IOTYPE_USER_IPCAM_AUDIOSTART": 0x0300,
+    "IOTYPE_USER_IPCAM_AUDIOSTOP": 0x0301
 }
@@ -0,0 +1,220 @@
+"""
+Demand Module.
+
+This module tracks whether anyone reads the stream of a camera, for the on demand
+mode in which the camera only streams while it is watched. mediamtx reports it:
+when a reader asks for a path that no one publishes, its runOnDemand hook calls
+/demand?path=<path>&state=start on the HTTP server of the proxy, and once the last
+reader has been gone for the grace period its runOnUnDemand hook calls it with
+state=stop.
+
+The camera is only started for a reader while its Private switch is off, the
+Private mode keeps it stopped whatever the demand.
+
+Classes:
+    Demand: Whether the stream of one camera is wanted.
+    DemandControl: Serves the /demand route for the mediamtx hooks.
+    StreamControl: Idles the camera and its publisher while no one reads the stream.
+
+Author:
+    Berobloom
+"""
+
+
+class Demand():
+    """
+    Demand Class.
+
+    Attributes:
+        wanted: True while the stream has readers.
+
+    Methods:
+        __init__(self): Initializes the demand, no one reads the stream yet.
+        request(self, wanted): Sets whether the stream is wanted.
+    """
+
+    def __init__(self):
+        self.wanted = False
+
+    def request(self, wanted):
+        """
+        Sets whether the stream is wanted.
+
+        Args:
+            wanted (bool): True if the stream has readers.
+
+        Returns:
+            None
+        """
+
+        self.wanted = wanted
+
+
+class DemandControl():
+    """
+    Demand Control Class.
+
+    Attributes:
+        _demands: Dictionary of RTSP path to the Demand of its camera.
+
+    Methods:
+        __init__(self, cameras): Initializes the control for the cameras.
+        route(self, query): Route of /demand, sets the demand of a path.
+    """
+
+    def __init__(self, cameras):
+        self._demands = {camera.name: camera.demand for camera in cameras}
+
+    def route(self, query):
+        """
+        Route of /demand?path=<path>&state=start|stop, sets the demand of a path.
+
+        Args:
+            query (dict): Query parameters of the request.
+
+        Returns:
+            tuple: The status code, the content type and the body.
+        """
+
+        path = query.get("path", [""])[0]
+        state = query.get("state", [""])[0]
+        # The substreams have hooks of their own, they only read the main path
+        demand = self._demands.get(path)
+        if demand is None:
+            return 404, "text/plain", b"Unknown path\n"
+        if state not in ("start", "stop"):
+            return 400, "text/plain", b"state must be start or stop\n"
+
+        print(f"[{path}] Demand {state}")
+        demand.request(state == "start")
+        return 200, "text/plain", b"OK\n"
+
+
+class StreamControl():
+    """
+    Stream Control Class.
+
+    Attributes:
+        idle: True while the camera and the publisher are idle for lack of readers.
+        _camera: Camera whose stream is controlled.
+        _publisher: RTPPublisher of the camera, or None.
+        _ffmpeg: FFMPEG publishing the camera, or None.
+        _quality: QualityController of the camera, or None.
+        _on_demand: True to idle the camera while the stream has no readers.
+        _standby: True while the publisher is in standby.
+
+    Methods:
+        __init__(self, camera, publisher, ffmpeg, quality, on_demand): Initializes
+            the control, the camera streams.
+        set_idle(self, idle): Idles the camera or starts it again.
+        poll(self): Follows the readers and the link, call about once a second.
+        session_started(self): Stops the camera again if it should not stream.
+        _follow_private(self): Takes the publisher out of standby once Private is off.
+        _set_standby(self, standby): Puts the publisher into standby or takes it out.
+    """
+
+    def __init__(self, camera, publisher=None, ffmpeg=None, quality=None, on_demand=False):
+        self.idle = False
+        self._camera = camera
+        self._publisher = publisher
+        self._ffmpeg = ffmpeg
+        self._quality = quality
+        self._on_demand = on_demand
+        self._standby = False
+
+    def set_idle(self, idle):
+        """
+        Idles the camera and the publisher, or starts them again for a reader. In
+        the Private mode the camera and the publisher stay stopped, until the
+        Private switch is turned off.
+
+        Args:
+            idle (bool): True to idle, False to start again.
+
+        Returns:
+            None
+        """
+
+        camera = self._camera
+        tutk = camera.tutk
+        if idle:
+            print(f"[{camera.name}] No readers, idling the camera...")
+            self._set_standby(True)
+            if self._ffmpeg is not None:
+                self._ffmpeg.stop()
+            tutk.ioctrl_stop_audio()
+            tutk.ioctrl_stop_camera()
+        else:
+            if tutk.private:
+                print(f"[{camera.name}] Reader attached, the camera stays stopped in "
+                      f"Private mode")
+            else:
+                print(f"[{camera.name}] Reader attached, starting the camera...")
+                tutk.ioctrl_start_camera()
+            tutk.ioctrl_start_audio()
+            if self._ffmpeg is not None:
+                self._ffmpeg.restart()
+        self.idle = idle
+        if self._quality is not None:
+            self._quality.reset()
+        self._follow_private()
+
+    def poll(self):
+        """
+        Idles or starts the camera when the readers come and go, and adapts the
+        quality to the link. Call it about once a second.
+
+        Returns:
+            None
+        """
+
+        if self._on_demand and self._camera.demand.wanted == self.idle:
+            self.set_idle(not self.idle)
+        self._follow_private()
+        # An idle camera sends nothing to judge the link by
+        if self._quality is not None and not self.idle:
+            self._quality.poll()
+
+    def session_started(self):
+        """
+        Stops the camera again after start_ipcam_stream started it for a new
+        session, if it is idle or in the Private mode.
+
+        Returns:
+            None
+        """
+
+        tutk = self._camera.tutk
+        if self._quality is not None:
+            self._quality.reset()
+        if self.idle:
+            tutk.ioctrl_stop_audio()
+        if self.idle or tutk.private:
+            tutk.ioctrl_stop_camera()
+
+    def _follow_private(self):
+        """
+        Takes the publisher of a camera that has readers out of standby once the
+        Private switch is off.
+
+        Returns:
+            None
+        """
+
+        if self._standby and not self.idle and not self._camera.tutk.private:
+            self._set_standby(False)
+
+    def _set_standby(self, standby):
+        """
+        Puts the publisher into standby or takes it out again.
+
+        Args:
+            standby (bool): True for standby.
+
+        Returns:
+            None
+        """
+
+        if self._publisher is not None and self._standby != standby:
+            self._publisher.set_standby(standby)
+        self._standby = standby
@@ -0,0 +1,191 @@
+"""
+Video Encoders Module.
+
+This module picks the H.264 encoder of ffmpeg for the streams that have to be
+re-encoded, the flipped main stream and the substreams. Hardware encoders take
+the encode off the CPU, which on a small host is most of what a transcode costs.
+The frames are still decoded and filtered on the CPU and uploaded to the encoder,
+flipping and scaling are cheap in comparison.
+
+At startup every hardware encoder whose device exists is tried with a short test
+encode, in the order of AUTO_ORDER, and the first one that works is used. Without
+one, or if the configured one does not work, libx264 is used.
+
+Classes:
+    Encoder: The ffmpeg arguments of one encoder.
+
+Functions:
+    select(name): Returns the encoder to use, detected once per process.
+
+Attributes:
+    ENCODERS: Dictionary mapping the name of an encoder to the Encoder.
+    AUTO_ORDER: Order in which the hardware encoders are detected.
+
+Author:
+    Berobloom
+"""
+
+import glob
+import subprocess
+import threading
+
+# Bit rate of the hardware encoders for the main stream, libx264 uses its CRF
+MAIN_BITRATE = "2M"
+
+# Longest a test encode may take, the first use of a device can be slow
+PROBE_TIMEOUT_S = 15
+
+VAAPI_DEVICE = "/dev/dri/renderD128"
+
+
+class Encoder():
+    """
+    Encoder Class.
+
+    Attributes:
+        name: Name of the encoder, as in settings.yaml.
+        codec_args: ffmpeg arguments selecting and setting up the encoder.
+        device_args: Global ffmpeg arguments opening the device of the encoder.
+        upload: Filters that bring the CPU frames into the format of the encoder.
+        devices: Glob patterns of the devices one of which the encoder needs.
+        hardware: Flag indicating if the encoder is a hardware encoder.
+
+    Methods:
+        __init__(self, name, codec_args, device_args, upload, devices): Initializes
+            the encoder.
+        video_filter(self, video_filter): Returns the -vf argument for the encoder.
+        video_args(self, bitrate): Returns the arguments of the encoder.
+        available(self): Checks whether the device of the encoder exists.
+        probe(self): Checks with a short test encode whether the encoder works.
+    """
+
+    def __init__(self, name, codec_args, device_args=(), upload=None, devices=()):
+        self.name = name
+        self.codec_args = list(codec_args)
+        self.device_args = list(device_args)
+        self.upload = upload
+        self.devices = list(devices)
+        self.hardware = name != "libx264"
+
+    def video_filter(self, video_filter=None):
+        """
+        Returns the filter graph for the encoder, the given filters followed by the
+        upload to the encoder.
+
+        Args:
+            video_filter (str): Filters to apply on the CPU, or None.
+
+        Returns:
+            str: The filter graph, or None if there is nothing to filter.
+        """
+
+        filters = [f for f in (video_filter, self.upload) if f]
+        return ",".join(filters) if filters else None
+
+    def video_args(self, bitrate=None):
+        """
+        Returns the ffmpeg arguments of the encoder.
+
+        Args:
+            bitrate (str): Bit rate, e.g. "300k", or None for the default of the encoder.
+
+        Returns:
+            list: The arguments.
+        """
+
+        args = list(self.codec_args)
+        if bitrate is None and self.hardware:
+            bitrate = MAIN_BITRATE
+        if bitrate is not None:
+            args.extend(["-b:v", str(bitrate)])
+        return args
+
+    def available(self):
+        """
+        Checks whether a device the encoder needs exists.
+
+        Returns:
+            bool: True if the encoder needs no device or one of them exists.
+        """
+
+        return not self.devices or any(glob.glob(pattern) for pattern in self.devices)
+
+    def probe(self):
+        """
+        Checks with a short test encode whether the encoder works on this host.
+
+        Returns:
+            bool: True if the test encode succeeded, False otherwise.
+        """
+
+        command = [
+            "ffmpeg", "-hide_banner", "-loglevel", "error", *self.device_args,
+            "-f", "lavfi", "-i", "testsrc=size=640x360:rate=25", "-frames:v", "10",
+            "-vf", self.video_filter("format=yuv420p"), *self.video_args(),
+            "-f", "null", "-",
+        ]
+        try:
+            result = subprocess.run(command, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.PIPE, timeout=PROBE_TIMEOUT_S,
+                                    check=False)
+        except (OSError, subprocess.TimeoutExpired):
+            return False
+        return result.returncode == 0
+
+
+ENCODERS = {
+    "vaapi": Encoder("vaapi", ["-c:v", "h264_vaapi"], ["-vaapi_device", VAAPI_DEVICE],
+                     "format=nv12,hwupload", [VAAPI_DEVICE]),
+    # Raspberry Pi
+    "v4l2m2m": Encoder("v4l2m2m", ["-c:v", "h264_v4l2m2m"], upload="format=yuv420p",
+                       devices=["/dev/video1[0-9]"]),
+    "nvenc": Encoder("nvenc", ["-c:v", "h264_nvenc", "-preset", "p1", "-tune", "ll"],
+                     devices=["/dev/nvidia[0-9]"]),
+    "qsv": Encoder("qsv", ["-c:v", "h264_qsv", "-preset", "veryfast"], upload="format=nv12",
+                   devices=["/dev/dri/renderD*"]),
+    "libx264": Encoder("libx264", ["-c:v", "libx264", "-preset", "ultrafast",
+                                   "-tune", "zerolatency"]),
+}
+
+AUTO_ORDER = ["vaapi", "v4l2m2m", "nvenc", "qsv"]
+
+_selected = {}
+_selected_lock = threading.Lock()
+
+
+def select(name="auto"):
+    """
+    Returns the encoder to use. With "auto" the first hardware encoder that works
+    is used, otherwise the named one if it works. libx264 stands in for any that
+    does not. The result is detected once and then reused.
+
+    Args:
+        name (str): "auto" or a key of ENCODERS.
+
+    Returns:
+        Encoder: The encoder.
+    """
+
+    with _selected_lock:
+        if name in _selected:
+            return _selected[name]
+
+        if name == "auto":
+            candidates = AUTO_ORDER
+        elif name in ENCODERS:
+            candidates = [name]
+        else:
+            print(f"Unknown video_encoder {name}, must be auto or one of "
+                  f"{', '.join(ENCODERS)}")
+            candidates = []
+
+        encoder = ENCODERS["libx264"]
+        for candidate in candidates:
+            if ENCODERS[candidate].available() and ENCODERS[candidate].probe():
+                encoder = ENCODERS[candidate]
+                break
+        if name not in ("auto", "libx264") and encoder.name != name:
+            print(f"Video encoder {name} does not work on this host, using libx264")
+        print(f"Video encoder: {encoder.name}")
+        _selected[name] = encoder
+        return encoder
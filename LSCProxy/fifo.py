@@ -0,0 +1,78 @@
+"""
+FIFO Writer Module.
+
+This module provides the write end of a named FIFO that ffmpeg reads from.
+
+The writer outlives the TUTK session it is fed from, so the FIFO stays open while
+the camera reconnects and ffmpeg does not see an end of file.
+
+Author:
+    Berobloom
+"""
+
+import os
+from utils import usleep
+
+
+class FifoWriter():
+    """
+    FIFO Writer Class.
+
+    Attributes:
+        path: Path to the FIFO.
+        _fd: File descriptor of the open FIFO, or None.
+
+    Methods:
+        __init__(self, path): Initializes the writer, the FIFO is opened on the first write.
+        write(self, data): Writes data, reopening the FIFO when the reader went away.
+        close(self): Closes the FIFO.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self._fd = None
+
+    def _open(self):
+        # Blocks until ffmpeg opens the read end
+        self._fd = os.open(self.path, os.O_WRONLY)
+        if self._fd == -1:
+            print(f"Cannot open {self.path.name} file")
+        else:
+            print(f"OK open {self.path.name} file")
+
+    def write(self, data):
+        """
+        Writes data to the FIFO.
+
+        When the reader went away, e.g. because ffmpeg was restarted, the data is
+        dropped and the FIFO is reopened for the next write.
+
+        Args:
+            data: Bytes-like object to write.
+
+        Returns:
+            None
+        """
+
+        if self._fd is None:
+            self._open()
+
+        try:
+            status = os.write(self._fd, data)
+            if status < 0:
+                print(f"{self.path.name}::write , ret=[{status}]")
+        except BrokenPipeError:
+            self.close()
+            usleep(10000)
+
+    def close(self):
+        """
+        Closes the FIFO.
+
+        Returns:
+            None
+        """
+
+        if self._fd is not None:
+            os.close(self._fd)
+            self._fd = None
@@ -0,0 +1,491 @@
+"""
+Native Frame Pump Wrapper
+
+This module provides a Python wrapper for the native frame pump in
+libs/framepump. The pump owns the avRecvFrameData2/avRecvAudioData loops
+of an AV session on its own threads and writes the frames to the FIFOs or
+publishes them to the RTSP server, so no frame passes through the
+interpreter or needs the GIL.
+
+Structures:
+    - FpConfig: Mirror of fp_config in framepump.h.
+    - FpStats: Mirror of fp_stats in framepump.h.
+    - FpRecorderConfig: Mirror of fp_recorder_config in framepump.h.
+    - FpBatchFrame: Mirror of fp_batch_frame in framepump.h.
+
+FramePump Class:
+    - Creates the pump for a started AV client of a Tutk instance.
+    - Starts, waits for and stops the receive threads, and moves them to
+      a new session after a reconnect.
+    - Records the streams into fragmented MP4 segments on the side.
+    - Shares the frames with local readers through a shared memory frame bus.
+    - Reads the pump statistics and the last keyframe.
+
+BatchReceiver Class:
+    - Receives several frames per call for the Python receive loops, which
+      otherwise cross into the SDK once per frame.
+
+Note:
+    - The library must be built first, see README.md.
+
+Author:
+    Berobloom
+"""
+
+import ctypes
+import constants
+from tutk import FrameInfoT
+
+# fp_ring_policy in framepump.h
+RING_POLICIES = {"drop": 0, "block": 1}
+
+# Upper bounds of the write latency buckets in framepump.h, the last bucket is unbounded
+LATENCY_BOUNDS_US = (100, 500, 1000, 5000, 10000, 50000, 100000, 500000)
+LATENCY_BUCKETS = len(LATENCY_BOUNDS_US) + 1
+
+
+class FpConfig(ctypes.Structure):
+    """
+    Structure for the frame pump configuration.
+    """
+    _fields_ = [("video_buf_size", ctypes.c_int),
+                ("audio_buf_size", ctypes.c_int),
+                ("max_latency_ms", ctypes.c_int),
+                ("video_ring_frames", ctypes.c_int),
+                ("audio_ring_frames", ctypes.c_int),
+                ("ring_policy", ctypes.c_int),
+                ("memory_budget", ctypes.c_uint64)]
+
+
+class FpStats(ctypes.Structure):
+    """
+    Structure for the frame pump statistics.
+    """
+    _fields_ = [
+        ("video_frames", ctypes.c_uint64),
+        ("video_bytes", ctypes.c_uint64),
+        ("video_lost", ctypes.c_uint64),
+        ("audio_frames", ctypes.c_uint64),
+        ("audio_bytes", ctypes.c_uint64),
+        ("audio_lost", ctypes.c_uint64),
+        ("write_errors", ctypes.c_uint64),
+        ("fifo_reopens", ctypes.c_uint64),
+        ("rtp_packets", ctypes.c_uint64),
+        ("rtp_bytes", ctypes.c_uint64),
+        ("publisher_connects", ctypes.c_uint64),
+        ("video_dropped", ctypes.c_uint64),
+        ("audio_dropped", ctypes.c_uint64),
+        ("video_overflows", ctypes.c_uint64),
+        ("audio_overflows", ctypes.c_uint64),
+        ("video_written", ctypes.c_uint64),
+        ("video_written_bytes", ctypes.c_uint64),
+        ("audio_written", ctypes.c_uint64),
+        ("audio_written_bytes", ctypes.c_uint64),
+        ("video_flushes", ctypes.c_uint64),
+        ("audio_flushes", ctypes.c_uint64),
+        ("video_lag_ms", ctypes.c_int64),
+        ("audio_lag_ms", ctypes.c_int64),
+        ("video_write_us", ctypes.c_uint64 * LATENCY_BUCKETS),
+        ("video_write_us_sum", ctypes.c_uint64),
+        ("audio_write_us", ctypes.c_uint64 * LATENCY_BUCKETS),
+        ("audio_write_us_sum", ctypes.c_uint64),
+        ("video_codec", ctypes.c_uint64),
+        ("audio_codec", ctypes.c_uint64),
+        ("record_segments", ctypes.c_uint64),
+        ("record_bytes", ctypes.c_uint64),
+        ("record_dropped", ctypes.c_uint64),
+        ("bus_frames", ctypes.c_uint64),
+        ("bus_bytes", ctypes.c_uint64),
+        ("memory_bytes", ctypes.c_uint64),
+        ("memory_refused", ctypes.c_uint64),
+        ("video_oversized", ctypes.c_uint64),
+    ]
+
+
+class FpRecorderConfig(ctypes.Structure):
+    """
+    Structure for the recorder configuration.
+    """
+    _fields_ = [("segment_seconds", ctypes.c_int),
+                ("max_age_seconds", ctypes.c_int),
+                ("max_bytes", ctypes.c_uint64),
+                ("sync_seconds", ctypes.c_int)]
+
+
+class FpBatchFrame(ctypes.Structure):
+    """
+    Structure for one frame of a batched receive.
+    """
+    _fields_ = [("data", ctypes.c_void_p),
+                ("capacity", ctypes.c_int),
+                ("status", ctypes.c_int),
+                ("expected_size", ctypes.c_int),
+                ("info", FrameInfoT)]
+
+
+class FramePump():
+    """
+    Native Frame Pump Wrapper Class
+
+    Attributes:
+        _lib: The loaded frame pump library.
+        _pump: Handle of the native pump.
+        _keyframe_buf: Buffer the last keyframe is copied into.
+
+    Methods:
+        __init__(self, tutk, max_latency_ms, video_ring_frames, audio_ring_frames, ring_policy,
+                 memory_budget): Creates a pump for the started AV client of tutk.
+        available(): Checks whether the native library has been built.
+        record(self, directory, segment_s, max_age_s, max_bytes, sync_s):
+            Records the streams into MP4 segments once the pump is started.
+        frame_bus(self, name, data_size): Publishes the frames to a shared memory bus.
+        start(self, video_fifo, audio_fifo): Starts the video and audio receive threads.
+        start_publisher(self, url): Starts the receive threads and publishes the streams.
+        resume(self, tutk): Restarts the receive threads on the new AV session of tutk.
+        wait(self, timeout): Waits for the receive threads to exit.
+        stop(self): Stops the receive threads.
+        set_standby(self, standby): Puts the publisher into standby or takes it out again.
+        keyframe(self): Returns the last keyframe and its number.
+        stats(self): Returns the pump statistics as a dictionary.
+    """
+
+    def __init__(self, tutk, max_latency_ms=0, video_ring_frames=32, audio_ring_frames=64,
+                 ring_policy="drop", memory_budget=0):
+        self._lib = ctypes.CDLL(constants.settings["FRAMEPUMP_PATH"])
+
+        self._lib.fp_create.argtypes = [ctypes.c_char_p, ctypes.c_int,
+                                        ctypes.POINTER(FpConfig)]
+        self._lib.fp_create.restype = ctypes.c_void_p
+
+        self._lib.fp_record.argtypes = [ctypes.c_void_p, ctypes.c_char_p,
+                                        ctypes.POINTER(FpRecorderConfig)]
+        self._lib.fp_record.restype = ctypes.c_int
+
+        self._lib.fp_frame_bus.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64]
+        self._lib.fp_frame_bus.restype = ctypes.c_int
+
+        self._lib.fp_start.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        self._lib.fp_start.restype = ctypes.c_int
+
+        self._lib.fp_start_publisher.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        self._lib.fp_start_publisher.restype = ctypes.c_int
+
+        self._lib.fp_resume.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self._lib.fp_resume.restype = ctypes.c_int
+
+        self._lib.fp_wait.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self._lib.fp_wait.restype = ctypes.c_int
+
+        self._lib.fp_stop.argtypes = [ctypes.c_void_p]
+        self._lib.fp_set_standby.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self._lib.fp_set_standby.restype = ctypes.c_int
+        self._lib.fp_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(FpStats)]
+        self._lib.fp_destroy.argtypes = [ctypes.c_void_p]
+        self._lib.fp_get_keyframe.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int,
+                                              ctypes.POINTER(ctypes.c_uint64)]
+        self._lib.fp_get_keyframe.restype = ctypes.c_int
+
+        config = FpConfig()
+        config.video_buf_size = constants.settings["VIDEO_BUF_SIZE"]
+        config.audio_buf_size = constants.settings["AUDIO_BUF_SIZE"]
+        config.max_latency_ms = max_latency_ms
+        config.video_ring_frames = video_ring_frames
+        config.audio_ring_frames = audio_ring_frames
+        if ring_policy not in RING_POLICIES:
+            raise ValueError(f"Ring policy must be one of {', '.join(RING_POLICIES)}")
+        config.ring_policy = RING_POLICIES[ring_policy]
+        if memory_budget < 0:
+            raise ValueError("Memory budget must not be negative")
+        config.memory_budget = memory_budget
+
+        lib_iot = str(constants.settings["IOTC_LIB_PATH"]).encode('utf-8')
+        self._pump = self._lib.fp_create(lib_iot, tutk.av_index, ctypes.byref(config))
+        if not self._pump:
+            raise RuntimeError("Cannot create native frame pump")
+        # Grows if a keyframe does not fit
+        self._keyframe_buf = ctypes.create_string_buffer(constants.settings["VIDEO_BUF_SIZE"])
+
+    @staticmethod
+    def available():
+        """
+        Checks whether the native library has been built.
+
+        Returns:
+            bool: True if the library exists, False otherwise.
+        """
+
+        return constants.settings["FRAMEPUMP_PATH"].exists()
+
+    def record(self, directory, segment_s=60, max_age_s=0, max_bytes=0, sync_s=10):
+        """
+        Records the streams into fragmented MP4 segments in directory as well,
+        from the start of the pump on. Must be called before start or
+        start_publisher.
+
+        Args:
+            directory (Path): Existing directory for the segments.
+            segment_s (int): Length of a segment in seconds.
+            max_age_s (int): Segments older than this are removed, 0 keeps them.
+            max_bytes (int): The oldest segments are removed while the directory
+                holds more, 0 for no limit.
+            sync_s (int): Interval in which the data is synced to the disk.
+
+        Returns:
+            bool: True if the recorder was set up, False otherwise.
+        """
+
+        config = FpRecorderConfig()
+        config.segment_seconds = segment_s
+        config.max_age_seconds = max_age_s
+        config.max_bytes = max_bytes
+        config.sync_seconds = sync_s
+        return self._lib.fp_record(self._pump, str(directory).encode('utf-8'),
+                                   ctypes.byref(config)) == 0
+
+    def frame_bus(self, name, data_size):
+        """
+        Publishes the frames to the shared memory frame bus name as well, from
+        the start of the pump on, see libs/framepump/frame_bus.h. Must be called
+        before start or start_publisher.
+
+        Args:
+            name (str): Name of the shared memory object, starting with a slash.
+            data_size (int): Bytes the bus holds for the frames, at least 1 MB.
+
+        Returns:
+            bool: True if the bus was set up, False otherwise.
+        """
+
+        return self._lib.fp_frame_bus(self._pump, name.encode('utf-8'), data_size) == 0
+
+    def start(self, video_fifo, audio_fifo):
+        """
+        Starts the video and audio receive threads.
+
+        Args:
+            video_fifo (Path): Path to the video FIFO.
+            audio_fifo (Path): Path to the audio FIFO.
+
+        Returns:
+            bool: True if the threads were started, False otherwise.
+        """
+
+        return self._lib.fp_start(self._pump, str(video_fifo).encode('utf-8'),
+                                  str(audio_fifo).encode('utf-8')) == 0
+
+    def start_publisher(self, url):
+        """
+        Starts the video and audio receive threads and publishes the streams
+        to the RTSP server instead of writing them to the FIFOs.
+
+        Args:
+            url (str): RTSP URL to publish to.
+
+        Returns:
+            bool: True if the threads were started, False otherwise.
+        """
+
+        return self._lib.fp_start_publisher(self._pump, url.encode('utf-8')) == 0
+
+    def resume(self, tutk):
+        """
+        Restarts the receive threads on the new AV session of tutk after the
+        previous session was closed. The FIFOs or the RTSP connection stay open,
+        so their readers stay attached.
+
+        Args:
+            tutk (Tutk): The TUTK framework instance with the new session.
+
+        Returns:
+            bool: True if the threads were restarted, False otherwise.
+        """
+
+        return self._lib.fp_resume(self._pump, tutk.av_index) == 0
+
+    def wait(self, timeout):
+        """
+        Waits for the receive threads to exit.
+
+        Args:
+            timeout (float): Maximum time to wait in seconds.
+
+        Returns:
+            bool: True if the threads have exited, False on timeout.
+        """
+
+        return self._lib.fp_wait(self._pump, int(timeout * 1000)) == 1
+
+    def stop(self):
+        """
+        Stops the receive threads and frees the pump.
+
+        Returns:
+            None
+        """
+
+        if self._pump:
+            self._lib.fp_destroy(self._pump)
+            self._pump = None
+
+    def set_standby(self, standby):
+        """
+        Puts the publisher into standby while no one reads the stream, or takes
+        it out again. In standby it closes its RTSP session and drops the frames.
+
+        Args:
+            standby (bool): True to go into standby, False to publish again.
+
+        Returns:
+            bool: True if the pump has been started, False otherwise.
+        """
+
+        return self._lib.fp_set_standby(self._pump, int(standby)) == 0
+
+    def keyframe(self):
+        """
+        Returns the last keyframe handed to the output, with the SPS and PPS in
+        front so that it decodes on its own.
+
+        Returns:
+            tuple: The number of the keyframe, which changes with every keyframe,
+                and its bytes. 0 and None if no keyframe has been cached.
+        """
+
+        sequence = ctypes.c_uint64()
+        size = self._lib.fp_get_keyframe(self._pump, self._keyframe_buf,
+                                         len(self._keyframe_buf), ctypes.byref(sequence))
+        if size > len(self._keyframe_buf):
+            self._keyframe_buf = ctypes.create_string_buffer(size)
+            size = self._lib.fp_get_keyframe(self._pump, self._keyframe_buf,
+                                             len(self._keyframe_buf), ctypes.byref(sequence))
+        if size <= 0 or size > len(self._keyframe_buf):
+            return 0, None
+        return sequence.value, self._keyframe_buf.raw[:size]
+
+    def stats(self):
+        """
+        Returns the pump statistics.
+
+        Returns:
+            dict: Counter name to value, a list of bucket counts for the histograms.
+        """
+
+        stats = FpStats()
+        self._lib.fp_get_stats(self._pump, ctypes.byref(stats))
+        values = {}
+        for name, _ in FpStats._fields_:
+            value = getattr(stats, name)
+            values[name] = list(value) if isinstance(value, ctypes.Array) else value
+        return values
+
+
+class BatchReceiver():
+    """
+    Batched Receive Wrapper Class
+
+    Receives up to max_frames frames per call into the ring buffers of the
+    Python receive loops. The entries of the batch are allocated once and the
+    video and the audio thread each use their own.
+
+    Attributes:
+        _lib: The loaded frame pump library.
+        _receiver: Handle of the native receiver.
+        _tutk: The TUTK framework instance whose session is received from.
+        _video_frames: Entries of the video batch.
+        _audio_frames: Entries of the audio batch.
+        expected_video_size: Size of the last video frame that did not fit into
+            its buffer.
+
+    Methods:
+        __init__(self, tutk, max_frames): Creates a receiver for the sessions of tutk.
+        recv_video(self, buffers, buf_size): Receives video frames into the buffers.
+        recv_audio(self, buffers, buf_size, min_buffered): Receives audio frames into
+            the buffers.
+        close(self): Frees the receiver.
+    """
+
+    def __init__(self, tutk, max_frames):
+        self._lib = ctypes.CDLL(constants.settings["FRAMEPUMP_PATH"])
+
+        self._lib.fp_receiver_create.argtypes = [ctypes.c_char_p]
+        self._lib.fp_receiver_create.restype = ctypes.c_void_p
+
+        self._lib.fp_recv_video_batch.argtypes = [ctypes.c_void_p, ctypes.c_int,
+                                                  ctypes.POINTER(FpBatchFrame), ctypes.c_int]
+        self._lib.fp_recv_video_batch.restype = ctypes.c_int
+
+        self._lib.fp_recv_audio_batch.argtypes = [ctypes.c_void_p, ctypes.c_int,
+                                                  ctypes.POINTER(FpBatchFrame), ctypes.c_int,
+                                                  ctypes.c_int]
+        self._lib.fp_recv_audio_batch.restype = ctypes.c_int
+
+        self._lib.fp_receiver_destroy.argtypes = [ctypes.c_void_p]
+
+        lib_iot = str(constants.settings["IOTC_LIB_PATH"]).encode('utf-8')
+        self._receiver = self._lib.fp_receiver_create(lib_iot)
+        if not self._receiver:
+            raise RuntimeError("Cannot create native batch receiver")
+
+        self._tutk = tutk
+        self._video_frames = (FpBatchFrame * max_frames)()
+        self._audio_frames = (FpBatchFrame * max_frames)()
+        self.expected_video_size = 0
+
+    @staticmethod
+    def _fill(frames, buffers, buf_size):
+        for frame, buf in zip(frames, buffers):
+            frame.data = ctypes.addressof(buf)
+            frame.capacity = buf_size
+        return min(len(frames), len(buffers))
+
+    def recv_video(self, buffers, buf_size):
+        """
+        Receives video frames, one into each buffer, until none is ready.
+
+        Args:
+            buffers (list): Buffers to receive the frames into.
+            buf_size (int): Size of every buffer.
+
+        Returns:
+            list: (status, FrameInfoT) of every frame in the order of the buffers,
+                the last one may be an error.
+        """
+
+        count = self._fill(self._video_frames, buffers, buf_size)
+        received = self._lib.fp_recv_video_batch(self._receiver, self._tutk.av_index,
+                                                 self._video_frames, count)
+        if received:
+            self.expected_video_size = self._video_frames[received - 1].expected_size
+        return [(frame.status, frame.info) for frame in self._video_frames[:received]]
+
+    def recv_audio(self, buffers, buf_size, min_buffered):
+        """
+        Receives audio frames, one into each buffer, while min_buffered frames
+        are buffered.
+
+        Args:
+            buffers (list): Buffers to receive the frames into.
+            buf_size (int): Size of every buffer.
+            min_buffered (int): Frames the SDK has to buffer before one is received.
+
+        Returns:
+            list: (status, FrameInfoT) of every frame in the order of the buffers,
+                the last one may be an error.
+        """
+
+        count = self._fill(self._audio_frames, buffers, buf_size)
+        received = self._lib.fp_recv_audio_batch(self._receiver, self._tutk.av_index,
+                                                 self._audio_frames, count, min_buffered)
+        return [(frame.status, frame.info) for frame in self._audio_frames[:received]]
+
+    def close(self):
+        """
+        Frees the receiver.
+
+        Returns:
+            None
+        """
+
+        if self._receiver:
+            self._lib.fp_receiver_destroy(self._receiver)
+            self._receiver = None
@@ -0,0 +1,123 @@
+"""
+HTTP Server Module.
+
+This module provides the small HTTP server of the proxy. Other modules register
+the paths they serve, e.g. /metrics, and the requests are handled on a thread
+per connection next to the camera sessions.
+
+Classes:
+    HttpServer: Serves the registered paths.
+
+Author:
+    Berobloom
+"""
+
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlsplit
+
+
+class HttpServer():
+    """
+    HTTP Server Class.
+
+    A route is a function that takes the query parameters of the request as a
+    dictionary of lists and returns the status code, the content type and the body.
+
+    Attributes:
+        host: Address the server listens on.
+        port: Port the server listens on.
+        _routes: Dictionary of path to route function.
+        _server: The running ThreadingHTTPServer, or None.
+
+    Methods:
+        __init__(self, host, port): Initializes the server.
+        add_route(self, path, route): Serves path with the route function.
+        start(self): Serves the requests until stop() is called.
+        stop(self): Stops the server.
+    """
+
+    def __init__(self, host, port):
+        self.host = host
+        self.port = port
+        self._routes = {}
+        self._server = None
+
+    def add_route(self, path, route):
+        """
+        Serves path with the route function.
+
+        Args:
+            path (str): Path of the URL, e.g. "/metrics".
+            route: Function of the query parameters returning (status, content_type, body).
+
+        Returns:
+            None
+        """
+
+        self._routes[path] = route
+
+    def _handler_class(self):
+        routes = self._routes
+
+        class Handler(BaseHTTPRequestHandler):
+            """
+            Dispatches a request to its route.
+            """
+
+            def do_GET(self):
+                """
+                Handles a GET request.
+                """
+
+                url = urlsplit(self.path)
+                route = routes.get(url.path)
+                if route is None:
+                    status, content_type, body = 404, "text/plain", b"Not found\n"
+                else:
+                    try:
+                        status, content_type, body = route(parse_qs(url.query))
+                    except Exception as e:  # pylint: disable=broad-except
+                        print(f"[http] {url.path} failed: {e!r}")
+                        status, content_type, body = 500, "text/plain", b"Internal error\n"
+
+                self.send_response(status)
+                self.send_header("Content-Type", content_type)
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, format, *args):  # pylint: disable=redefined-builtin
+                # Scrapes every few seconds would flood the log
+                pass
+
+        return Handler
+
+    def start(self):
+        """
+        Serves the requests until stop() is called.
+
+        Returns:
+            None
+        """
+
+        try:
+            self._server = ThreadingHTTPServer((self.host, self.port), self._handler_class())
+        except OSError as e:
+            print(f"Cannot start HTTP server on {self.host}:{self.port}: {e}")
+            return
+        self._server.daemon_threads = True
+        print(f"HTTP server listening on {self.host}:{self.port}")
+        self._server.serve_forever()
+
+    def stop(self):
+        """
+        Stops the server.
+
+        Returns:
+            None
+        """
+
+        if self._server is not None:
+            self._server.shutdown()
+            self._server.server_close()
+            self._server = None
@@ -0,0 +1,186 @@
+"""
+IOCTRL Channel Module.
+
+This module sends the IOCTRL commands of a camera without waiting for each one
+and matches the responses of the camera to them. A command is sent right away
+and returns a Future. A thread of the channel receives the responses with
+avRecvIOCtrl and completes the oldest Future waiting for that response type, so
+several commands are on the way at once and a caller can tell whether the
+camera applied one.
+
+Commands without a response type complete once they are sent. A response that
+does not arrive within the timeout completes the Future with None, since not
+every firmware answers every command. The request waits for its response a
+while longer, so a late response is matched to it and not to the next request
+of the same type.
+
+Classes:
+    IoctrlChannel: Sends the IOCTRL commands of one camera and tracks their responses.
+
+Author:
+    Berobloom
+"""
+
+import collections
+import ctypes
+import threading
+import time
+from concurrent.futures import Future
+import constants
+
+RESPONSE_TIMEOUT_S = 2
+
+# How long past the timeout a late response is still taken for its request
+LATE_RESPONSE_S = 10
+
+# How long avRecvIOCtrl waits for a response per call
+RECV_TIMEOUT_MS = 500
+
+# Large enough for the responses of the commands the proxy sends
+RESPONSE_BUF_SIZE = 1024
+
+
+class IoctrlChannel():
+    """
+    IOCTRL Channel Class.
+
+    Attributes:
+        _tutk: Instance of the Tutk class whose session the commands go to.
+        _lock: Lock guarding the pending requests and the receive thread.
+        _pending: Dictionary mapping a response type to a deque of the requests
+            waiting for it, oldest first. A request is a tuple of the deadline,
+            the Future and the function reading the result from the response.
+            An expired request stays until LATE_RESPONSE_S past its deadline.
+        _thread: Thread receiving the responses, started with the first request.
+        _buf: Buffer the responses are received into.
+
+    Methods:
+        __init__(self, tutk): Initializes the channel for the session of tutk.
+        request(self, iotype_command, struct, response): Sends a command and
+            returns a Future of its result.
+        _send(self, iotype_command, struct): Sends a command, False if that failed.
+        _receive(self): Receives the responses and completes their Futures.
+        _expire(self): Completes the Futures whose response is overdue and drops
+            the requests that are past the grace for a late response.
+    """
+
+    def __init__(self, tutk):
+        self._tutk = tutk
+        self._lock = threading.Lock()
+        self._pending = collections.defaultdict(collections.deque)
+        self._thread = None
+        self._buf = ctypes.create_string_buffer(RESPONSE_BUF_SIZE)
+
+    def request(self, iotype_command, struct, response=None):
+        """
+        Sends an IOCTRL command and returns a Future of its result.
+
+        Args:
+            iotype_command (int): IOCTRL command type.
+            struct: IOCTRL command structure.
+            response (tuple): The response type and a function that returns
+                whether the response reports success, or None for a command the
+                camera does not answer.
+
+        Returns:
+            Future: True if the camera applied the command, or if it has no
+                response, False if it could not be sent or the camera rejected
+                it, None if the response did not arrive in time.
+        """
+
+        future = Future()
+        if response is None:
+            future.set_result(self._send(iotype_command, struct))
+            return future
+
+        # Waiting before the command is sent, so a quick response is not missed
+        response_type, succeeded = response
+        entry = (time.monotonic() + RESPONSE_TIMEOUT_S, future, succeeded)
+        with self._lock:
+            self._pending[response_type].append(entry)
+            if self._thread is None:
+                self._thread = threading.Thread(target=self._receive, daemon=True,
+                                                name=f"{self._tutk.uid}-ioctrl")
+                self._thread.start()
+
+        if not self._send(iotype_command, struct):
+            with self._lock:
+                waiting = self._pending[response_type]
+                if entry in waiting:
+                    waiting.remove(entry)
+                if not future.done():
+                    future.set_result(False)
+        return future
+
+    def _send(self, iotype_command, struct):
+        """
+        Sends an IOCTRL command, a failure of the SDK call counts as not sent.
+
+        Args:
+            iotype_command (int): IOCTRL command type.
+            struct: IOCTRL command structure.
+
+        Returns:
+            bool: True if the command was sent, False otherwise.
+        """
+
+        try:
+            return self._tutk.av_send_ioctrl(iotype_command, struct)
+        except Exception as e:  # pylint: disable=broad-except
+            print(f"[{self._tutk.uid}] Cannot send IOCTRL 0x{iotype_command:04x}: {e!r}")
+            return False
+
+    def _receive(self):
+        """
+        Receives the responses of the camera and completes the Futures waiting for
+        them, until the proxy shuts down.
+
+        Returns:
+            None
+        """
+
+        response_type = ctypes.c_uint()
+        while not self._tutk.graceful_shutdown:
+            if self._tutk.av_index is None:
+                # Reconnecting, the requests of the lost session expire
+                self._expire()
+                time.sleep(RECV_TIMEOUT_MS / 1000)
+                continue
+
+            status = self._tutk.av_recv_ioctrl(response_type, self._buf, RECV_TIMEOUT_MS)
+            if status >= 0:
+                with self._lock:
+                    waiting = self._pending.get(response_type.value)
+                    entry = waiting.popleft() if waiting else None
+                    # The late response of an expired request completes nothing
+                    if entry is not None and not entry[1].done():
+                        _, future, succeeded = entry
+                        future.set_result(succeeded(self._buf.raw[:status]))
+            elif status != constants.av_error["AV_ER_TIMEOUT"]:
+                # The session is gone, wait for the next one
+                time.sleep(RECV_TIMEOUT_MS / 1000)
+            self._expire()
+
+    def _expire(self):
+        """
+        Completes the Futures whose response is overdue with None, and drops the
+        requests that are LATE_RESPONSE_S past their deadline.
+
+        Returns:
+            None
+        """
+
+        now = time.monotonic()
+        expired = []
+        with self._lock:
+            for response_type, waiting in self._pending.items():
+                while waiting and waiting[0][0] + LATE_RESPONSE_S <= now:
+                    waiting.popleft()
+                for deadline, future, _ in waiting:
+                    if deadline > now:
+                        break
+                    if not future.done():
+                        future.set_result(None)
+                        expired.append(response_type)
+        for response_type in expired:
+            print(f"[{self._tutk.uid}] No IOCTRL response 0x{response_type:04x} in time")
@@ -0,0 +1,63 @@
+#include "aac.h"
+
+#include <cstdio>
+
+namespace framepump {
+namespace aac {
+
+namespace {
+
+constexpr size_t adts_header_size = 7;
+constexpr size_t adts_crc_size = 2;
+
+constexpr uint32_t sample_rates[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                     22050, 16000, 12000, 11025, 8000,  7350};
+
+}  // namespace
+
+uint32_t Config::sample_rate() const
+{
+    return sampling_index < sizeof(sample_rates) / sizeof(sample_rates[0])
+               ? sample_rates[sampling_index]
+               : 0;
+}
+
+std::string Config::audio_specific_config() const
+{
+    // 5 bits object type, 4 bits sampling index, 4 bits channel configuration
+    unsigned int v = (object_type << 11) | (sampling_index << 7) | (channels << 3);
+    char hex[5];
+    std::snprintf(hex, sizeof(hex), "%04x", v & 0xffff);
+    return hex;
+}
+
+std::vector<Frame> split(const uint8_t *data, size_t size, Config *config)
+{
+    std::vector<Frame> frames;
+    size_t pos = 0;
+    while (pos + adts_header_size <= size) {
+        const uint8_t *header = data + pos;
+        // 12 bits syncword
+        if (header[0] != 0xff || (header[1] & 0xf0) != 0xf0) {
+            break;
+        }
+        bool has_crc = (header[1] & 0x01) == 0;
+        size_t frame_size = ((header[3] & 0x03) << 11) | (header[4] << 3) | (header[5] >> 5);
+        size_t header_size = adts_header_size + (has_crc ? adts_crc_size : 0);
+        if (frame_size <= header_size || pos + frame_size > size) {
+            break;
+        }
+
+        if (config != nullptr && frames.empty()) {
+            config->object_type = static_cast<uint8_t>((header[2] >> 6) + 1);
+            config->sampling_index = static_cast<uint8_t>((header[2] >> 2) & 0x0f);
+            config->channels = static_cast<uint8_t>(((header[2] & 0x01) << 2) | (header[3] >> 6));
+        }
+        frames.push_back({header + header_size, frame_size - header_size});
+        pos += frame_size;
+    }
+    return frames;
+}
+
+}  // namespace aac
+}  // namespace framepump
@@ -0,0 +1,39 @@
+// Helpers for the ADTS AAC stream of cameras that encode their audio.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace framepump {
+namespace aac {
+
+// Samples every AAC frame carries, also its RTP timestamp increment.
+constexpr uint32_t samples_per_frame = 1024;
+
+// What the SDP needs to know about the stream, from the ADTS header.
+struct Config {
+    uint8_t object_type = 0;  // Audio object type, 2 is AAC LC
+    uint8_t sampling_index = 0;
+    uint8_t channels = 0;
+
+    bool valid() const { return object_type != 0; }
+    uint32_t sample_rate() const;
+
+    // The AudioSpecificConfig as hex, for the config of an SDP fmtp line.
+    std::string audio_specific_config() const;
+};
+
+struct Frame {
+    const uint8_t *data;  // Raw AAC frame, ADTS header stripped
+    size_t size;
+};
+
+// Splits a buffer of ADTS frames into their raw frames and stores the
+// config of the first one in config, if it is not null. Stops at the first
+// damaged header.
+std::vector<Frame> split(const uint8_t *data, size_t size, Config *config);
+
+}  // namespace aac
+}  // namespace framepump
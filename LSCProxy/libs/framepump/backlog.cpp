@@ -0,0 +1,84 @@
+#include "backlog.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+// The camera and host clocks drift apart. Letting the baseline rise by up
+// to 1 ms per second absorbs that, while a real backlog grows much faster.
+constexpr int64_t baseline_drift_ms_per_s = 1;
+
+// Timestamp jumps beyond this restart the measurement, like in SourceClock
+constexpr int64_t max_timestamp_jump_ms = 5000;
+
+}  // namespace
+
+Backlog::Backlog(int max_lag_ms, bool keyframes_only)
+    : max_lag_ms_(max_lag_ms), keyframes_only_(keyframes_only)
+{
+}
+
+int64_t Backlog::lag_ms(uint32_t camera_timestamp_ms, clock::time_point now)
+{
+    int64_t received_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    int64_t offset_ms = received_ms - camera_timestamp_ms;
+    int64_t step_ms = static_cast<int32_t>(camera_timestamp_ms - last_timestamp_ms_);
+    last_timestamp_ms_ = camera_timestamp_ms;
+
+    if (!started_ || step_ms < 0 || step_ms > max_timestamp_jump_ms || offset_ms <= min_offset_ms_) {
+        started_ = true;
+        min_offset_ms_ = offset_ms;
+        baseline_time_ = now;
+        return 0;
+    }
+
+    auto drift_s = std::chrono::duration_cast<std::chrono::seconds>(now - baseline_time_);
+    if (drift_s.count() > 0) {
+        min_offset_ms_ = std::min(offset_ms, min_offset_ms_ + drift_s.count() * baseline_drift_ms_per_s);
+        baseline_time_ += drift_s;
+    }
+    return offset_ms - min_offset_ms_;
+}
+
+bool Backlog::accept(uint32_t camera_timestamp_ms, bool keyframe)
+{
+    // Without camera timestamps there is nothing to measure the lag against
+    if (camera_timestamp_ms == 0) {
+        return true;
+    }
+
+    int64_t lag = lag_ms(camera_timestamp_ms, clock::now());
+    last_lag_ms_ = lag;
+    if (max_lag_ms_ <= 0) {
+        return true;
+    }
+
+    if (dropping_) {
+        bool caught_up = keyframes_only_ ? keyframe && lag <= max_lag_ms_ : lag < max_lag_ms_ / 2;
+        if (!caught_up) {
+            ++dropped_;
+            return false;
+        }
+        print("[backlog] Caught up after dropping %llu frames\n",
+              static_cast<unsigned long long>(dropped_));
+        dropping_ = false;
+        dropped_ = 0;
+        return true;
+    }
+
+    if (lag > max_lag_ms_) {
+        print("[backlog] %lld ms behind, dropping to the next %s\n", static_cast<long long>(lag),
+              keyframes_only_ ? "keyframe" : "live frame");
+        dropping_ = true;
+        dropped_ = 1;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace framepump
@@ -0,0 +1,54 @@
+// Keeps the receive latency bounded by dropping frames at safe points.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace framepump {
+
+// The SDK queues frames while the pump or its consumer falls behind, e.g.
+// after a stall of the P2P link or while ffmpeg is slow to read the FIFO.
+// The lag of a frame is how much later than its camera timestamp promised
+// it was received, relative to the lowest lag seen so far. The SDK does not
+// report how many video frames it holds, but a backlog shows up in the lag
+// of every frame that comes out of it.
+//
+// Once the lag passes the limit, a video stream is dropped up to the next
+// keyframe that is back within the limit, so the decoder never sees a GOP
+// with frames missing. Audio frames decode on their own, so audio is only
+// dropped until the lag is back below half the limit.
+//
+// Not thread safe, use one per stream.
+class Backlog {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // max_lag_ms of 0 disables dropping
+    Backlog(int max_lag_ms, bool keyframes_only);
+
+    // Returns true if the frame should be passed on, false if it should be
+    // dropped. keyframe is ignored for streams without keyframes.
+    bool accept(uint32_t camera_timestamp_ms, bool keyframe);
+
+    // Lag of the last frame with a camera timestamp, also measured when
+    // dropping is disabled
+    int64_t last_lag_ms() const { return last_lag_ms_; }
+    bool dropping() const { return dropping_; }
+
+private:
+    // Lag of a frame received now, in milliseconds
+    int64_t lag_ms(uint32_t camera_timestamp_ms, clock::time_point now);
+
+    const int64_t max_lag_ms_;
+    const bool keyframes_only_;
+
+    bool started_ = false;
+    bool dropping_ = false;
+    uint64_t dropped_ = 0;
+    int64_t last_lag_ms_ = 0;
+    int64_t min_offset_ms_ = 0;
+    uint32_t last_timestamp_ms_ = 0;
+    clock::time_point baseline_time_{};
+};
+
+}  // namespace framepump
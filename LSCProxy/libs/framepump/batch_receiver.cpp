@@ -0,0 +1,69 @@
+#include "batch_receiver.h"
+
+#include <algorithm>
+
+namespace framepump {
+
+static_assert(sizeof(FrameInfo) == FP_FRAME_INFO_SIZE, "FP_FRAME_INFO_SIZE must match FrameInfo");
+
+BatchReceiver::BatchReceiver(const TutkApi &api) : api_(api)
+{
+}
+
+int BatchReceiver::recv_video(int av_index, fp_batch_frame *frames, int max_frames) const
+{
+    int count = 0;
+    while (count < max_frames) {
+        fp_batch_frame &frame = frames[count];
+        int actual_frame_size = 0;
+        int expected_frame_size = 0;
+        int actual_frame_info_size = 0;
+        unsigned int frame_index = 0;
+        frame.status = api_.recv_frame_data2(av_index, frame.data, frame.capacity,
+                                             &actual_frame_size, &expected_frame_size,
+                                             reinterpret_cast<char *>(frame.info),
+                                             sizeof(frame.info), &actual_frame_info_size,
+                                             &frame_index);
+        frame.expected_size = expected_frame_size;
+        if (frame.status == AV_ER_DATA_NOREADY) {
+            break;
+        }
+        ++count;
+        if (frame.status < 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+int BatchReceiver::recv_audio(int av_index, fp_batch_frame *frames, int max_frames,
+                              int min_buffered) const
+{
+    int buffered = api_.check_audio_buf(av_index);
+    if (buffered < 0) {
+        frames[0].status = buffered;
+        return max_frames > 0 ? 1 : 0;
+    }
+
+    // The Python loop checked the buffer before every frame, this receives
+    // as many frames as those checks would have let through
+    int count = 0;
+    int ready = std::min(max_frames, buffered - min_buffered + 1);
+    while (count < ready) {
+        fp_batch_frame &frame = frames[count];
+        unsigned int frame_index = 0;
+        frame.status = api_.recv_audio_data(av_index, frame.data, frame.capacity,
+                                            reinterpret_cast<char *>(frame.info),
+                                            sizeof(frame.info), &frame_index);
+        if (frame.status == AV_ER_DATA_NOREADY) {
+            break;
+        }
+        ++count;
+        if (frame.status < 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+}  // namespace framepump
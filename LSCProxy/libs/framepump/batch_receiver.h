@@ -0,0 +1,23 @@
+// Batched receive calls for the Python receive loops.
+#pragma once
+
+#include "framepump.h"
+#include "tutk_api.h"
+
+namespace framepump {
+
+// Calls the SDK receive functions several times per call from Python, see
+// fp_recv_video_batch and fp_recv_audio_batch. Unlike the Pump it owns no
+// threads and no buffers, the frames go into the ring of the caller.
+class BatchReceiver {
+public:
+    explicit BatchReceiver(const TutkApi &api);
+
+    int recv_video(int av_index, fp_batch_frame *frames, int max_frames) const;
+    int recv_audio(int av_index, fp_batch_frame *frames, int max_frames, int min_buffered) const;
+
+private:
+    const TutkApi &api_;
+};
+
+}  // namespace framepump
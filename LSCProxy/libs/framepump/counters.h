@@ -0,0 +1,116 @@
+// Counters shared between the receive threads and the sinks.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "framepump.h"
+
+namespace framepump {
+
+// Upper bounds of all but the last bucket, see FP_LATENCY_BUCKETS
+constexpr int64_t latency_bounds_us[FP_LATENCY_BUCKETS - 1] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 500000};
+
+struct LatencyHistogram {
+    std::atomic<uint64_t> buckets[FP_LATENCY_BUCKETS]{};
+    std::atomic<uint64_t> sum_us{0};
+
+    void record(std::chrono::microseconds elapsed)
+    {
+        int bucket = 0;
+        while (bucket < FP_LATENCY_BUCKETS - 1 && elapsed.count() > latency_bounds_us[bucket]) {
+            ++bucket;
+        }
+        ++buckets[bucket];
+        sum_us += elapsed.count();
+    }
+
+    void copy_to(uint64_t *out_buckets, uint64_t *out_sum_us) const
+    {
+        for (int bucket = 0; bucket < FP_LATENCY_BUCKETS; ++bucket) {
+            out_buckets[bucket] = buckets[bucket];
+        }
+        *out_sum_us = sum_us;
+    }
+};
+
+struct Counters {
+    std::atomic<uint64_t> video_frames{0};
+    std::atomic<uint64_t> video_bytes{0};
+    std::atomic<uint64_t> video_lost{0};
+    std::atomic<uint64_t> audio_frames{0};
+    std::atomic<uint64_t> audio_bytes{0};
+    std::atomic<uint64_t> audio_lost{0};
+    std::atomic<uint64_t> write_errors{0};
+    std::atomic<uint64_t> fifo_reopens{0};
+    std::atomic<uint64_t> rtp_packets{0};
+    std::atomic<uint64_t> rtp_bytes{0};
+    std::atomic<uint64_t> publisher_connects{0};
+    std::atomic<uint64_t> video_dropped{0};
+    std::atomic<uint64_t> audio_dropped{0};
+    std::atomic<uint64_t> video_overflows{0};
+    std::atomic<uint64_t> audio_overflows{0};
+    std::atomic<uint64_t> video_written{0};
+    std::atomic<uint64_t> video_written_bytes{0};
+    std::atomic<uint64_t> audio_written{0};
+    std::atomic<uint64_t> audio_written_bytes{0};
+    std::atomic<uint64_t> video_flushes{0};
+    std::atomic<uint64_t> audio_flushes{0};
+    std::atomic<int64_t> video_lag_ms{0};
+    std::atomic<int64_t> audio_lag_ms{0};
+    std::atomic<uint64_t> video_codec{0};
+    std::atomic<uint64_t> audio_codec{0};
+    std::atomic<uint64_t> record_segments{0};
+    std::atomic<uint64_t> record_bytes{0};
+    std::atomic<uint64_t> record_dropped{0};
+    std::atomic<uint64_t> bus_frames{0};
+    std::atomic<uint64_t> bus_bytes{0};
+    std::atomic<uint64_t> memory_bytes{0};
+    std::atomic<uint64_t> memory_refused{0};
+    std::atomic<uint64_t> video_oversized{0};
+    LatencyHistogram video_write;
+    LatencyHistogram audio_write;
+
+    void copy_to(fp_stats *out) const
+    {
+        out->video_frames = video_frames;
+        out->video_bytes = video_bytes;
+        out->video_lost = video_lost;
+        out->audio_frames = audio_frames;
+        out->audio_bytes = audio_bytes;
+        out->audio_lost = audio_lost;
+        out->write_errors = write_errors;
+        out->fifo_reopens = fifo_reopens;
+        out->rtp_packets = rtp_packets;
+        out->rtp_bytes = rtp_bytes;
+        out->publisher_connects = publisher_connects;
+        out->video_dropped = video_dropped;
+        out->audio_dropped = audio_dropped;
+        out->video_overflows = video_overflows;
+        out->audio_overflows = audio_overflows;
+        out->video_written = video_written;
+        out->video_written_bytes = video_written_bytes;
+        out->audio_written = audio_written;
+        out->audio_written_bytes = audio_written_bytes;
+        out->video_flushes = video_flushes;
+        out->audio_flushes = audio_flushes;
+        out->video_lag_ms = video_lag_ms;
+        out->audio_lag_ms = audio_lag_ms;
+        out->video_codec = video_codec;
+        out->audio_codec = audio_codec;
+        out->record_segments = record_segments;
+        out->record_bytes = record_bytes;
+        out->record_dropped = record_dropped;
+        out->bus_frames = bus_frames;
+        out->bus_bytes = bus_bytes;
+        out->memory_bytes = memory_bytes;
+        out->memory_refused = memory_refused;
+        out->video_oversized = video_oversized;
+        video_write.copy_to(out->video_write_us, &out->video_write_us_sum);
+        audio_write.copy_to(out->audio_write_us, &out->audio_write_us_sum);
+    }
+};
+
+}  // namespace framepump
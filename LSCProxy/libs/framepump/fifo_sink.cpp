@@ -0,0 +1,56 @@
+#include "fifo_sink.h"
+
+namespace framepump {
+
+FifoSink::FifoSink(const char *video_fifo_path, const char *audio_fifo_path,
+                   const std::atomic<bool> &running, Counters &counters)
+    : counters_(counters),
+      video_fifo_(video_fifo_path, running),
+      audio_fifo_(audio_fifo_path, running)
+{
+}
+
+FifoSink::~FifoSink() = default;
+
+void FifoSink::video_frame(const Frame &frame)
+{
+    // The FIFOs are opened by the first frame, which blocks the receive
+    // thread until ffmpeg opens the read end
+    if (!video_open_) {
+        video_open_ = video_fifo_.open();
+        if (!video_open_) {
+            return;
+        }
+    }
+
+    if (video_fifo_.write(frame.data, frame.size) == FifoWriter::Result::broken) {
+        // ffmpeg went away, wait for the restarted one
+        ++counters_.write_errors;
+        ++counters_.fifo_reopens;
+        video_open_ = video_fifo_.open();
+    }
+}
+
+void FifoSink::audio_frame(const Frame &frame)
+{
+    if (!audio_open_) {
+        audio_open_ = audio_fifo_.open();
+        if (!audio_open_) {
+            return;
+        }
+    }
+
+    if (audio_fifo_.write(frame.data, frame.size) == FifoWriter::Result::broken) {
+        ++counters_.write_errors;
+        ++counters_.fifo_reopens;
+        audio_open_ = audio_fifo_.open();
+    }
+}
+
+void FifoSink::interrupt()
+{
+    video_fifo_.interrupt_open();
+    audio_fifo_.interrupt_open();
+}
+
+}  // namespace framepump
@@ -0,0 +1,30 @@
+// Sink that writes the frames to the named FIFOs ffmpeg reads from.
+#pragma once
+
+#include <atomic>
+
+#include "counters.h"
+#include "fifo_writer.h"
+#include "sink.h"
+
+namespace framepump {
+
+class FifoSink : public Sink {
+public:
+    FifoSink(const char *video_fifo_path, const char *audio_fifo_path,
+             const std::atomic<bool> &running, Counters &counters);
+    ~FifoSink() override;
+
+    void video_frame(const Frame &frame) override;
+    void audio_frame(const Frame &frame) override;
+    void interrupt() override;
+
+private:
+    Counters &counters_;
+    FifoWriter video_fifo_;
+    FifoWriter audio_fifo_;
+    bool video_open_ = false;
+    bool audio_open_ = false;
+};
+
+}  // namespace framepump
@@ -0,0 +1,103 @@
+#include "fifo_writer.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+constexpr int poll_interval_ms = 100;
+
+}  // namespace
+
+FifoWriter::FifoWriter(std::string path, const std::atomic<bool> &running)
+    : path_(std::move(path)), running_(running)
+{
+}
+
+FifoWriter::~FifoWriter()
+{
+    close();
+}
+
+bool FifoWriter::open()
+{
+    close();
+    while (running_) {
+        fd_ = ::open(path_.c_str(), O_WRONLY);
+        if (fd_ >= 0) {
+            break;
+        }
+        if (errno != EINTR) {
+            print("Cannot open %s: %s\n", path_.c_str(), std::strerror(errno));
+            return false;
+        }
+    }
+    if (fd_ < 0) {
+        return false;
+    }
+    if (!running_) {
+        // Woken up by interrupt_open()
+        close();
+        return false;
+    }
+
+    // Writes are polled so that a stalled reader cannot keep stop() waiting.
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    print("OK open %s\n", path_.c_str());
+    return true;
+}
+
+void FifoWriter::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+FifoWriter::Result FifoWriter::write(const void *data, size_t len)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    while (len > 0) {
+        if (!running_) {
+            return Result::stopped;
+        }
+        ssize_t written = ::write(fd_, bytes, len);
+        if (written > 0) {
+            bytes += written;
+            len -= static_cast<size_t>(written);
+            continue;
+        }
+        if (written < 0 && errno == EPIPE) {
+            return Result::broken;
+        }
+        if (written < 0 && errno != EAGAIN && errno != EINTR) {
+            print("%s::write, error=[%s]\n", path_.c_str(), std::strerror(errno));
+            return Result::broken;
+        }
+        pollfd pfd{fd_, POLLOUT, 0};
+        poll(&pfd, 1, poll_interval_ms);
+    }
+    return Result::ok;
+}
+
+void FifoWriter::interrupt_open()
+{
+    // Opening the read end completes a writer blocked in open(). The
+    // descriptor is closed right away, the writer then sees running_ false.
+    int fd = ::open(path_.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+}  // namespace framepump
@@ -0,0 +1,38 @@
+// Non-blocking writer for one of the named FIFOs ffmpeg reads from.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+namespace framepump {
+
+class FifoWriter {
+public:
+    enum class Result { ok, broken, stopped };
+
+    FifoWriter(std::string path, const std::atomic<bool> &running);
+    ~FifoWriter();
+    FifoWriter(const FifoWriter &) = delete;
+    FifoWriter &operator=(const FifoWriter &) = delete;
+
+    // Blocks until a reader has opened the FIFO or the pump is stopped.
+    bool open();
+    void close();
+
+    // Writes exactly len bytes. Returns broken when the reader went away
+    // (EPIPE) and stopped when the pump was stopped halfway through.
+    Result write(const void *data, size_t len);
+
+    // Unblocks a thread that is stuck in open() waiting for a reader.
+    void interrupt_open();
+
+    const std::string &path() const { return path_; }
+
+private:
+    std::string path_;
+    const std::atomic<bool> &running_;
+    int fd_ = -1;
+};
+
+}  // namespace framepump
@@ -0,0 +1,302 @@
+// Layout of the shared memory frame bus and a client to read it.
+//
+// This header stands on its own, so a local consumer only copies it and
+// links nothing but -lrt on older glibc.
+#pragma once
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+namespace framepump {
+
+// The pump of every camera with a bus publishes the frames it received into
+// the POSIX shared memory object /lscproxy-<camera name>, i.e. the file
+// /dev/shm/lscproxy-<camera name>. Readers map the frames read only and take
+// them straight out of it, the H.264 and audio exactly as the camera sent
+// them, so there is no socket, no RTP and no copy in between. The writer
+// never waits for a reader, one that falls behind by more than the bus
+// holds loses frames and is told so.
+//
+// The object consists of
+//
+//     BusHeader                 at 0
+//     BusSlot[slot_count]       at slots_offset
+//     frame data                at data_offset, data_size bytes
+//
+// Frame number n, counting from 0, is described by slot n % slot_count. Its
+// data starts at the byte position BusSlot::position of the data, which
+// only grows, at data_offset + position % data_size and is never split at
+// the end of the data. The writer
+//
+//  1. sets data_end to position + size and copies the frame,
+//  2. sets BusSlot::sequence to ~0, fills in the slot and sets sequence to n,
+//  3. sets frame_count to n + 1 and increments wake, waking the readers that
+//     wait on it with FUTEX_WAIT.
+//
+// A reader of frame n checks that sequence is n before and after reading the
+// slot, and after using the data that data_end has not passed position +
+// data_size, i.e. that the writer did not reuse the data meanwhile.
+// FrameBusReader below does all of this.
+constexpr uint32_t bus_magic = 0x4243534c;  // "LSCB" on little endian
+constexpr uint32_t bus_version = 1;
+
+enum BusStream : uint8_t {
+    bus_video = 0,
+    bus_audio = 1,
+};
+
+// BusSlot::flags
+constexpr uint8_t bus_keyframe = 0x01;
+
+// FRAMEINFO_t of the SDK, 24 bytes
+struct BusFrameInfo {
+    uint16_t codec_id;
+    uint8_t flags;
+    uint8_t cam_index;
+    uint8_t online_num;
+    char reserve1[3];
+    uint32_t reserve2;
+    uint32_t timestamp;
+    uint32_t video_width;
+    uint32_t video_height;
+};
+
+struct BusHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;  // A power of two
+    uint32_t header_size;
+    uint64_t slots_offset;
+    uint64_t data_offset;
+    uint64_t data_size;
+    // Set once the writer has shut down, readers open the bus again
+    alignas(64) std::atomic<uint32_t> closed;
+    alignas(64) std::atomic<uint64_t> frame_count;
+    std::atomic<uint64_t> data_end;
+    // Futex word, incremented after every frame
+    alignas(64) std::atomic<uint32_t> wake;
+    // Readers waiting on wake, the writer only calls FUTEX_WAKE while there are
+    std::atomic<uint32_t> waiters;
+};
+
+struct BusSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t position;
+    uint32_t size;
+    uint8_t stream;
+    uint8_t flags;
+    uint16_t reserved;
+    BusFrameInfo info;
+};
+
+static_assert(sizeof(BusFrameInfo) == 24, "BusFrameInfo must match FRAMEINFO_t");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the bus needs lock free 64 bit atomics");
+
+// A frame on the bus. data points into the shared memory, so it is only
+// valid until the writer reuses the space, see FrameBusReader::intact().
+struct BusFrame {
+    uint64_t sequence;
+    uint64_t position;
+    const uint8_t *data;
+    uint32_t size;
+    BusStream stream;
+    bool keyframe;
+    BusFrameInfo info;
+};
+
+inline long bus_futex(std::atomic<uint32_t> *word, int op, uint32_t value,
+                      const struct timespec *timeout)
+{
+    // The word is shared with other processes, so no FUTEX_PRIVATE_FLAG
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, value, timeout,
+                   nullptr, 0);
+}
+
+// Reads the frame bus of one camera.
+//
+//     FrameBusReader reader;
+//     reader.open("/lscproxy-cam1");
+//     BusFrame frame;
+//     while (...) {
+//         auto status = reader.next(frame, std::chrono::milliseconds(1000));
+//         if (status == FrameBusReader::frame) {
+//             consume(frame.data, frame.size);
+//             if (!reader.intact(frame)) { /* overwritten meanwhile */ }
+//         }
+//     }
+//
+// A reader starts at the next frame the writer publishes. After an overrun
+// it continues with the newest frame, a video consumer then waits for the
+// next keyframe.
+class FrameBusReader {
+public:
+    enum Status {
+        frame,
+        timeout,
+        // Frames were lost, the reader skipped to the newest one
+        overrun,
+        // The writer shut down, open the bus again when it is back
+        closed,
+    };
+
+    FrameBusReader() = default;
+    ~FrameBusReader() { close(); }
+    FrameBusReader(const FrameBusReader &) = delete;
+    FrameBusReader &operator=(const FrameBusReader &) = delete;
+
+    // Maps the bus name, e.g. "/lscproxy-cam1". Returns false if it does not
+    // exist or is not a bus of this version.
+    bool open(const char *name)
+    {
+        close();
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BusHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        map_ = static_cast<uint8_t *>(map);
+        map_size_ = st.st_size;
+
+        // The futex and the waiter count are the only words a reader writes,
+        // they get a writable mapping of their own page
+        const BusHeader *header = reinterpret_cast<const BusHeader *>(map_);
+        if (header->magic != bus_magic || header->version != bus_version ||
+            header->header_size < sizeof(BusHeader) || header->header_size > map_size_ ||
+            header->data_offset + header->data_size > map_size_) {
+            close();
+            return false;
+        }
+        fd = shm_open(name, O_RDWR, 0);
+        void *page = fd < 0 ? MAP_FAILED
+                            : mmap(nullptr, header->header_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, fd, 0);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (page == MAP_FAILED) {
+            close();
+            return false;
+        }
+        header_ = static_cast<BusHeader *>(page);
+        slots_ = reinterpret_cast<const BusSlot *>(map_ + header_->slots_offset);
+        data_ = map_ + header_->data_offset;
+        next_ = header_->frame_count.load(std::memory_order_acquire);
+        return true;
+    }
+
+    void close()
+    {
+        if (header_ != nullptr) {
+            munmap(header_, header_->header_size);
+            header_ = nullptr;
+        }
+        if (map_ != nullptr) {
+            munmap(map_, map_size_);
+            map_ = nullptr;
+        }
+    }
+
+    bool is_open() const { return map_ != nullptr; }
+
+    // Waits up to max_wait for the next frame and fills in out
+    Status next(BusFrame &out, std::chrono::milliseconds max_wait)
+    {
+        auto deadline = std::chrono::steady_clock::now() + max_wait;
+        for (;;) {
+            if (header_->closed.load(std::memory_order_acquire) != 0) {
+                return closed;
+            }
+            uint32_t wake = header_->wake.load(std::memory_order_acquire);
+            uint64_t count = header_->frame_count.load(std::memory_order_acquire);
+            if (count > next_) {
+                return read(out, count);
+            }
+
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::steady_clock::duration::zero()) {
+                return timeout;
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            struct timespec wait_for {
+                static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)
+            };
+            header_->waiters.fetch_add(1, std::memory_order_seq_cst);
+            // Returns at once if a frame came since wake was read
+            if (header_->frame_count.load(std::memory_order_seq_cst) == count) {
+                bus_futex(&header_->wake, FUTEX_WAIT, wake, &wait_for);
+            }
+            header_->waiters.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    // True if the data of frame has not been overwritten yet. Call it after
+    // using the data, a frame that was not intact must be discarded.
+    bool intact(const BusFrame &frame) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return header_->data_end.load(std::memory_order_acquire) <=
+               frame.position + header_->data_size;
+    }
+
+private:
+    Status read(BusFrame &out, uint64_t count)
+    {
+        uint32_t slot_count = header_->slot_count;
+        if (count - next_ > slot_count) {
+            next_ = count - 1;
+            return overrun;
+        }
+
+        const BusSlot &slot = slots_[next_ & (slot_count - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != next_) {
+            next_ = count - 1;
+            return overrun;
+        }
+        out.sequence = next_;
+        out.position = slot.position;
+        out.size = slot.size;
+        out.stream = static_cast<BusStream>(slot.stream);
+        out.keyframe = (slot.flags & bus_keyframe) != 0;
+        out.info = slot.info;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != next_ ||
+            out.size > header_->data_size) {
+            next_ = count - 1;
+            return overrun;
+        }
+        out.data = data_ + out.position % header_->data_size;
+        ++next_;
+        return intact(out) ? frame : overrun;
+    }
+
+    uint8_t *map_ = nullptr;
+    size_t map_size_ = 0;
+    BusHeader *header_ = nullptr;
+    const BusSlot *slots_ = nullptr;
+    const uint8_t *data_ = nullptr;
+    uint64_t next_ = 0;
+};
+
+}  // namespace framepump
@@ -0,0 +1,122 @@
+#include "frame_bus_writer.h"
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+// About a minute of video and audio at 25 and 50 frames per second
+constexpr uint32_t slot_count = 4096;
+constexpr size_t page_size = 4096;
+
+static_assert(sizeof(BusFrameInfo) == sizeof(FrameInfo), "BusFrameInfo must match FrameInfo");
+
+size_t round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+FrameBusWriter::FrameBusWriter(std::string name, size_t data_size, Counters &counters)
+    : name_(std::move(name)), counters_(counters)
+{
+    size_t header_size = round_up(sizeof(BusHeader), page_size);
+    size_t slots_size = round_up(sizeof(BusSlot) * slot_count, page_size);
+    data_size = round_up(data_size, page_size);
+    map_size_ = header_size + slots_size + data_size;
+
+    // A bus left behind by a killed proxy may still be mapped by readers,
+    // they keep the old object and see no frames until they open it again
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0) {
+        print("[frame_bus] Cannot create %s: %s\n", name_.c_str(), std::strerror(errno));
+        return;
+    }
+    // Readers write the futex words, whatever the umask
+    fchmod(fd, 0660);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(map_size_)) == 0) {
+        map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        print("[frame_bus] Cannot map %s: %s\n", name_.c_str(), std::strerror(errno));
+        shm_unlink(name_.c_str());
+        return;
+    }
+
+    // The memory of a new object is zeroed, which is a valid state for the atomics
+    map_ = static_cast<uint8_t *>(map);
+    header_ = new (map_) BusHeader();
+    header_->slot_count = slot_count;
+    header_->header_size = static_cast<uint32_t>(header_size);
+    header_->slots_offset = header_size;
+    header_->data_offset = header_size + slots_size;
+    header_->data_size = data_size;
+    header_->version = bus_version;
+    slots_ = reinterpret_cast<BusSlot *>(map_ + header_->slots_offset);
+    data_ = map_ + header_->data_offset;
+    // Readers check the magic first
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = bus_magic;
+    print("[frame_bus] Publishing to %s\n", name_.c_str());
+}
+
+FrameBusWriter::~FrameBusWriter()
+{
+    if (header_ == nullptr) {
+        return;
+    }
+    header_->closed.store(1, std::memory_order_release);
+    header_->wake.fetch_add(1, std::memory_order_seq_cst);
+    bus_futex(&header_->wake, FUTEX_WAKE, INT_MAX, nullptr);
+    munmap(map_, map_size_);
+    shm_unlink(name_.c_str());
+}
+
+void FrameBusWriter::publish(const Frame &frame, BusStream stream, bool keyframe)
+{
+    if (header_ == nullptr || frame.size > header_->data_size) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t data_size = header_->data_size;
+    uint64_t position = header_->data_end.load(std::memory_order_relaxed);
+    // A frame is never split, one that does not fit before the end starts over
+    if (position % data_size + frame.size > data_size) {
+        position += data_size - position % data_size;
+    }
+    // Readers of the data about to be overwritten notice by data_end
+    header_->data_end.store(position + frame.size, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::memcpy(data_ + position % data_size, frame.data, frame.size);
+
+    uint64_t sequence = header_->frame_count.load(std::memory_order_relaxed);
+    BusSlot &slot = slots_[sequence & (slot_count - 1)];
+    slot.sequence.store(~uint64_t{0}, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.position = position;
+    slot.size = static_cast<uint32_t>(frame.size);
+    slot.stream = stream;
+    slot.flags = keyframe ? bus_keyframe : 0;
+    std::memcpy(&slot.info, &frame.info, sizeof(slot.info));
+    slot.sequence.store(sequence, std::memory_order_release);
+    header_->frame_count.store(sequence + 1, std::memory_order_release);
+
+    header_->wake.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->waiters.load(std::memory_order_seq_cst) != 0) {
+        bus_futex(&header_->wake, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+    ++counters_.bus_frames;
+    counters_.bus_bytes += frame.size;
+}
+
+}  // namespace framepump
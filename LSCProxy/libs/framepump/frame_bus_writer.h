@@ -0,0 +1,45 @@
+// Publishes the frames of the pump into the shared memory frame bus.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "counters.h"
+#include "frame_bus.h"
+#include "sink.h"
+
+namespace framepump {
+
+// Writer side of the bus described in frame_bus.h. The object is created
+// when the pump starts and removed again when it stops, readers still
+// attached see it closed.
+//
+// The pump calls it from both writer threads, so a frame is published under
+// a lock, which is only held for the copy into the shared memory.
+class FrameBusWriter {
+public:
+    // Creates the object name, replacing a stale one of a previous run,
+    // with data_size bytes for the frames. Check ok() afterwards.
+    FrameBusWriter(std::string name, size_t data_size, Counters &counters);
+    ~FrameBusWriter();
+    FrameBusWriter(const FrameBusWriter &) = delete;
+    FrameBusWriter &operator=(const FrameBusWriter &) = delete;
+
+    bool ok() const { return header_ != nullptr; }
+
+    void publish(const Frame &frame, BusStream stream, bool keyframe);
+
+private:
+    const std::string name_;
+    Counters &counters_;
+    std::mutex mutex_;
+    uint8_t *map_ = nullptr;
+    size_t map_size_ = 0;
+    BusHeader *header_ = nullptr;
+    BusSlot *slots_ = nullptr;
+    uint8_t *data_ = nullptr;
+};
+
+}  // namespace framepump
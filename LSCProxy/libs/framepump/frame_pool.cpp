@@ -0,0 +1,209 @@
+#include "frame_pool.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+std::atomic<uint32_t> &references(uint8_t *block)
+{
+    return *reinterpret_cast<std::atomic<uint32_t> *>(block);
+}
+
+}  // namespace
+
+FramePool::FramePool(size_t budget, Counters &counters) : budget_(budget), counters_(counters) {}
+
+FramePool::~FramePool()
+{
+    for (std::vector<uint8_t *> &blocks : free_) {
+        for (uint8_t *block : blocks) {
+            delete[] block;
+        }
+    }
+}
+
+size_t FramePool::block_size(size_t size)
+{
+    size_t block = min_block_size;
+    while (block < size && block < max_block_size) {
+        block *= 4;
+    }
+    return block >= size ? block : 0;
+}
+
+int FramePool::size_class(size_t block_size)
+{
+    int index = 0;
+    for (size_t block = min_block_size; block < block_size; block *= 4) {
+        ++index;
+    }
+    return index;
+}
+
+uint8_t *FramePool::get(size_t block_size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint8_t *> &blocks = free_[size_class(block_size)];
+    if (!blocks.empty()) {
+        uint8_t *block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+
+    uint8_t *block = make_room(block_size)
+                         ? new (std::nothrow) uint8_t[FrameBuffer::block_header_size + block_size]
+                         : nullptr;
+    if (block == nullptr) {
+        return nullptr;
+    }
+    used_ += block_size;
+    counters_.memory_bytes = used_;
+    return block;
+}
+
+void FramePool::put(uint8_t *block, size_t block_size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_[size_class(block_size)].push_back(block);
+}
+
+void FramePool::refused()
+{
+    ++counters_.memory_refused;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!warned_) {
+        print("[frame_pool] Memory budget of %zu bytes used up, dropping frames\n", budget_);
+        warned_ = true;
+    }
+}
+
+bool FramePool::make_room(size_t size)
+{
+    if (budget_ == 0) {
+        return true;
+    }
+    // The largest free blocks go first, they are the ones needed least often
+    for (int index = class_count - 1; index >= 0 && used_ + size > budget_; --index) {
+        size_t block_size = min_block_size << (2 * index);
+        while (!free_[index].empty() && used_ + size > budget_) {
+            delete[] free_[index].back();
+            free_[index].pop_back();
+            used_ -= block_size;
+        }
+    }
+    counters_.memory_bytes = used_;
+    return used_ + size <= budget_;
+}
+
+FrameBuffer::FrameBuffer(const FrameBuffer &other)
+    : pool_(other.pool_), owner_(other.owner_), block_(other.block_), capacity_(other.capacity_)
+{
+    if (block_ != nullptr) {
+        references(block_).fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameBuffer &FrameBuffer::operator=(const FrameBuffer &other)
+{
+    if (this != &other && block_ != other.block_) {
+        if (other.block_ != nullptr) {
+            references(other.block_).fetch_add(1, std::memory_order_relaxed);
+        }
+        reset();
+        owner_ = other.owner_;
+        block_ = other.block_;
+        capacity_ = other.capacity_;
+    }
+    return *this;
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer &&other) noexcept
+    : pool_(other.pool_),
+      owner_(other.owner_),
+      block_(std::exchange(other.block_, nullptr)),
+      capacity_(std::exchange(other.capacity_, 0))
+{
+}
+
+FrameBuffer &FrameBuffer::operator=(FrameBuffer &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        pool_ = other.pool_;
+        owner_ = other.owner_;
+        block_ = std::exchange(other.block_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+    }
+    return *this;
+}
+
+bool FrameBuffer::shared() const
+{
+    return block_ != nullptr && references(block_).load(std::memory_order_acquire) > 1;
+}
+
+bool FrameBuffer::reserve(size_t size, bool shrink)
+{
+    size_t block_size = FramePool::block_size(size);
+    if (block_ != nullptr && capacity_ >= size && (!shrink || capacity_ == block_size) &&
+        !shared()) {
+        return true;
+    }
+    reset();
+    if (block_size == 0) {
+        return false;
+    }
+    block_ = pool_ != nullptr ? pool_->get(block_size)
+                              : new uint8_t[block_header_size + block_size];
+    if (block_ == nullptr) {
+        return false;
+    }
+    new (block_) std::atomic<uint32_t>(1);
+    owner_ = pool_;
+    capacity_ = block_size;
+    return true;
+}
+
+bool FrameBuffer::assign(const uint8_t *data, size_t size)
+{
+    if (!reserve(size, true)) {
+        return false;
+    }
+    std::memcpy(this->data(), data, size);
+    return true;
+}
+
+bool FrameBuffer::share(const FrameBuffer &other, size_t size)
+{
+    if (other.block_ != nullptr && other.capacity_ == FramePool::block_size(size)) {
+        *this = other;
+        return true;
+    }
+    return assign(other.data(), size);
+}
+
+void FrameBuffer::reset()
+{
+    if (block_ == nullptr) {
+        return;
+    }
+    // The last reference hands the block back, after the others are done with it
+    if (references(block_).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (owner_ != nullptr) {
+            owner_->put(block_, capacity_);
+        } else {
+            delete[] block_;
+        }
+    }
+    block_ = nullptr;
+    capacity_ = 0;
+}
+
+}  // namespace framepump
@@ -0,0 +1,111 @@
+// Frame buffers in size classes, under one memory budget per camera.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "counters.h"
+
+namespace framepump {
+
+// Hands out the blocks the frames of one pump are kept in, to its rings,
+// its keyframe cache and its recorder. A block has one of a few sizes,
+// from 1 KiB in steps of four to 4 MiB, so an audio frame takes 1 KiB, a
+// P-frame 16 or 64 KiB and only a large IDR frame a large block. Blocks
+// that are handed back are kept on a free list of their size and reused,
+// so once the streams run the pool no longer allocates.
+//
+// All blocks, in use or free, count against the budget. When a new block
+// would exceed it, free blocks of the other sizes are released first, and
+// if that is not enough the block is refused and the caller drops the
+// frame. The memory of a camera never grows past the budget.
+//
+// The receive rings hold blocks for the largest frame received so far,
+// the copies of the keyframe cache and the recorder take blocks of the
+// size of each frame.
+class FramePool {
+public:
+    static constexpr size_t min_block_size = 1024;
+    static constexpr size_t max_block_size = 4 * 1024 * 1024;
+
+    // budget is in bytes, 0 for no limit
+    FramePool(size_t budget, Counters &counters);
+    ~FramePool();
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // The size of the smallest block that holds size bytes, 0 if none does
+    static size_t block_size(size_t size);
+
+    // A block with room for block_size bytes, which must be one of the
+    // sizes, or nullptr if the budget has no room for it. Used by FrameBuffer.
+    uint8_t *get(size_t block_size);
+    void put(uint8_t *block, size_t block_size);
+    // Counts a frame that was dropped or not cached for want of a block
+    void refused();
+
+private:
+    static constexpr int class_count = 7;
+    static int size_class(size_t block_size);
+
+    // Releases free blocks until size bytes more fit into the budget
+    bool make_room(size_t size);
+
+    const size_t budget_;
+    Counters &counters_;
+    std::mutex mutex_;
+    std::vector<uint8_t *> free_[class_count];
+    size_t used_ = 0;
+    bool warned_ = false;
+};
+
+// A buffer of a frame. Taken from a pool it holds one of its blocks, which
+// it keeps until it needs another size and hands back when destroyed.
+// Without a pool it allocates the same sizes from the heap, for the copies
+// consumers take outside of the budget.
+//
+// Copies of a buffer share its block, which is reference counted, so the
+// writer threads hand a frame to the keyframe cache, the recorder and the
+// publisher without copying it. The content of a shared block must not
+// change, reserve() gives the buffer a block of its own again.
+class FrameBuffer {
+public:
+    FrameBuffer() = default;
+    explicit FrameBuffer(FramePool *pool) : pool_(pool) {}
+    ~FrameBuffer() { reset(); }
+    FrameBuffer(const FrameBuffer &other);
+    FrameBuffer &operator=(const FrameBuffer &other);
+    FrameBuffer(FrameBuffer &&other) noexcept;
+    FrameBuffer &operator=(FrameBuffer &&other) noexcept;
+
+    uint8_t *data() const { return block_ != nullptr ? block_ + block_header_size : nullptr; }
+    size_t capacity() const { return capacity_; }
+    bool shared() const;
+
+    // Makes room for size bytes in a block of its own. A larger block is
+    // kept unless shrink is set, then the block is swapped for the smallest
+    // that fits. Returns false, keeping no block, if the budget has no room.
+    bool reserve(size_t size, bool shrink = false);
+    // Copies size bytes in, into the smallest block that fits
+    bool assign(const uint8_t *data, size_t size);
+    // Holds the first size bytes of other. Shares its block if it is the
+    // size they take anyway, otherwise copies them into the smallest block
+    // that fits, so a small frame does not keep a large block.
+    bool share(const FrameBuffer &other, size_t size);
+    void reset();
+
+private:
+    // The reference count in front of the data, which stays aligned
+    static constexpr size_t block_header_size = 16;
+    friend class FramePool;
+
+    // Where new blocks come from, and the owner of the current block
+    FramePool *pool_ = nullptr;
+    FramePool *owner_ = nullptr;
+    uint8_t *block_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+}  // namespace framepump
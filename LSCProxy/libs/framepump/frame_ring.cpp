@@ -0,0 +1,126 @@
+#include "frame_ring.h"
+
+namespace framepump {
+
+namespace {
+
+size_t round_up_to_power_of_two(size_t n)
+{
+    size_t power = 1;
+    while (power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+
+}  // namespace
+
+FrameRing::FrameRing(size_t capacity, FramePool &pool, size_t frame_size)
+    : pool_(pool), slots_(round_up_to_power_of_two(capacity)), mask_(slots_.size() - 1)
+{
+    for (FrameSlot &slot : slots_) {
+        slot.data = FrameBuffer(&pool);
+        if (frame_size > 0) {
+            // A slot the budget has no room for tries again when it is acquired
+            slot.data.reserve(frame_size);
+        }
+    }
+}
+
+FrameSlot *FrameRing::acquire()
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == slots_.size()) {
+        return nullptr;
+    }
+    return &slots_[head & mask_];
+}
+
+void FrameRing::commit()
+{
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // Pairs with the fence in wait(), so either the consumer sees the frame
+    // or the producer sees the consumer waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_waiting_.load(std::memory_order_relaxed)) {
+        wake();
+    }
+}
+
+bool FrameRing::reserve(FrameSlot &slot, size_t size, bool shrink)
+{
+    if (slot.data.reserve(size, shrink)) {
+        return true;
+    }
+    trim();
+    if (slot.data.reserve(size, shrink)) {
+        return true;
+    }
+    pool_.refused();
+    return false;
+}
+
+bool FrameRing::share(FrameSlot &slot, const FrameSlot &frame)
+{
+    if (!slot.data.share(frame.data, frame.size)) {
+        trim();
+        if (!slot.data.share(frame.data, frame.size)) {
+            pool_.refused();
+            return false;
+        }
+    }
+    slot.size = frame.size;
+    slot.info = frame.info;
+    return true;
+}
+
+void FrameRing::trim()
+{
+    // The slots from head_ + 1 up to tail_ + capacity are free, and only
+    // the producer touches them
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t end = tail_.load(std::memory_order_acquire) + slots_.size();
+    for (size_t index = head + 1; index < end; ++index) {
+        slots_[index & mask_].data.reset();
+    }
+}
+
+FrameSlot *FrameRing::front()
+{
+    if (empty()) {
+        return nullptr;
+    }
+    return &slots_[tail_.load(std::memory_order_relaxed) & mask_];
+}
+
+void FrameRing::release()
+{
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool FrameRing::empty() const
+{
+    return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+}
+
+void FrameRing::wait(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    consumer_waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (empty()) {
+        wait_cv_.wait_for(lock, timeout);
+    }
+    consumer_waiting_.store(false, std::memory_order_relaxed);
+}
+
+void FrameRing::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+    }
+    wait_cv_.notify_one();
+}
+
+}  // namespace framepump
@@ -0,0 +1,81 @@
+// Frame queue between a receive thread and its writer thread.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.h"
+#include "tutk_api.h"
+
+namespace framepump {
+
+struct FrameSlot {
+    FrameBuffer data;
+    size_t size = 0;
+    FrameInfo info{};
+};
+
+// Single producer, single consumer ring of frames. Every slot keeps a block
+// of the pool from frame to frame, and the SDK receives straight into the
+// slot, so queueing a frame neither allocates nor copies. A slot only trades
+// its block for another size when a frame does not fit.
+//
+// The indices are lock free. The mutex is only taken to put an idle
+// consumer to sleep and to wake it up again.
+class FrameRing {
+public:
+    // capacity is rounded up to a power of two. Every slot takes a block
+    // for frame_size bytes up front, none if it is 0.
+    FrameRing(size_t capacity, FramePool &pool, size_t frame_size = 0);
+    FrameRing(const FrameRing &) = delete;
+    FrameRing &operator=(const FrameRing &) = delete;
+
+    // Producer side. acquire() returns the slot to fill next, or nullptr if
+    // the ring is full, and commit() queues it.
+    FrameSlot *acquire();
+    void commit();
+    // Makes room for size bytes in the acquired slot, see FrameBuffer. If
+    // the budget has no room, the blocks of the other free slots go back to
+    // the pool first, or a ring whose slots hold the budget would never
+    // get past a slot without a block. A slot that still gets none is
+    // counted by the pool as refused.
+    bool reserve(FrameSlot &slot, size_t size, bool shrink = false);
+    // Fills the acquired slot with frame, see FrameBuffer::share()
+    bool share(FrameSlot &slot, const FrameSlot &frame);
+
+    // Consumer side. front() returns the oldest queued frame, or nullptr if
+    // the ring is empty, and release() hands its slot back.
+    FrameSlot *front();
+    void release();
+
+    // Waits until a frame is queued, wake() is called or timeout passes
+    void wait(std::chrono::milliseconds timeout);
+    void wake();
+
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    bool empty() const;
+    // Hands the blocks of the free slots but the next one back to the pool
+    void trim();
+
+    FramePool &pool_;
+    std::vector<FrameSlot> slots_;
+    size_t mask_;
+
+    // Separate cache lines, head_ is written by the producer only and tail_
+    // by the consumer only
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+
+    std::atomic<bool> consumer_waiting_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+};
+
+}  // namespace framepump
@@ -0,0 +1,240 @@
+#include "framepump.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch_receiver.h"
+#include "fifo_sink.h"
+#include "frame_bus_writer.h"
+#include "pump.h"
+#include "recorder.h"
+#include "rtsp_publisher.h"
+#include "tutk_api.h"
+
+struct fp_pump {
+    framepump::TutkApi api;
+    int av_index = -1;
+    fp_config config{};
+    std::string record_directory;
+    fp_recorder_config record_config{};
+    std::string bus_name;
+    uint64_t bus_data_size = 0;
+    std::unique_ptr<framepump::Pump> pump;
+};
+
+struct fp_receiver {
+    framepump::TutkApi api;
+    std::unique_ptr<framepump::BatchReceiver> receiver;
+};
+
+namespace {
+
+// The recorder asked for with fp_record(), or null
+std::unique_ptr<framepump::Recorder> make_recorder(fp_pump *pump)
+{
+    if (pump->record_directory.empty()) {
+        return nullptr;
+    }
+    return std::make_unique<framepump::Recorder>(
+        pump->record_directory, pump->record_config, pump->pump->frame_pool(),
+        pump->pump->counters());
+}
+
+// The frame bus asked for with fp_frame_bus(), or null
+std::unique_ptr<framepump::FrameBusWriter> make_frame_bus(fp_pump *pump)
+{
+    if (pump->bus_name.empty()) {
+        return nullptr;
+    }
+    auto bus = std::make_unique<framepump::FrameBusWriter>(
+        pump->bus_name, pump->bus_data_size, pump->pump->counters());
+    if (!bus->ok()) {
+        return nullptr;
+    }
+    return bus;
+}
+
+}  // namespace
+
+extern "C" {
+
+fp_pump *fp_create(const char *iotc_lib_path, int av_index, const fp_config *config)
+{
+    if (iotc_lib_path == nullptr || config == nullptr || av_index < 0 ||
+        config->video_buf_size <= 0 || config->audio_buf_size <= 0 ||
+        config->video_ring_frames <= 0 || config->audio_ring_frames <= 0 ||
+        static_cast<size_t>(config->video_buf_size) > framepump::FramePool::max_block_size) {
+        return nullptr;
+    }
+
+    auto handle = std::make_unique<fp_pump>();
+    if (!handle->api.load(iotc_lib_path)) {
+        return nullptr;
+    }
+    handle->av_index = av_index;
+    handle->config = *config;
+    return handle.release();
+}
+
+int fp_record(fp_pump *pump, const char *directory, const fp_recorder_config *config)
+{
+    if (pump == nullptr || pump->pump != nullptr || directory == nullptr || config == nullptr ||
+        config->segment_seconds <= 0 || config->sync_seconds < 0) {
+        return -1;
+    }
+
+    pump->record_directory = directory;
+    pump->record_config = *config;
+    return 0;
+}
+
+int fp_frame_bus(fp_pump *pump, const char *name, uint64_t data_size)
+{
+    // The frames must fit, 1 MB is far more than the largest keyframe
+    if (pump == nullptr || pump->pump != nullptr || name == nullptr || name[0] != '/' ||
+        data_size < 1024 * 1024) {
+        return -1;
+    }
+
+    pump->bus_name = name;
+    pump->bus_data_size = data_size;
+    return 0;
+}
+
+int fp_start(fp_pump *pump, const char *video_fifo_path, const char *audio_fifo_path)
+{
+    if (pump == nullptr || pump->pump != nullptr ||
+        video_fifo_path == nullptr || audio_fifo_path == nullptr) {
+        return -1;
+    }
+
+    pump->pump = std::make_unique<framepump::Pump>(pump->api, pump->av_index, pump->config);
+    pump->pump->start(std::make_unique<framepump::FifoSink>(
+        video_fifo_path, audio_fifo_path, pump->pump->running(), pump->pump->counters()),
+        make_recorder(pump), make_frame_bus(pump));
+    return 0;
+}
+
+int fp_start_publisher(fp_pump *pump, const char *url)
+{
+    if (pump == nullptr || pump->pump != nullptr || url == nullptr) {
+        return -1;
+    }
+
+    pump->pump = std::make_unique<framepump::Pump>(pump->api, pump->av_index, pump->config);
+    pump->pump->start(std::make_unique<framepump::RtspPublisher>(
+        url, pump->pump->counters(), pump->pump->keyframe_cache()), make_recorder(pump),
+        make_frame_bus(pump));
+    return 0;
+}
+
+int fp_resume(fp_pump *pump, int av_index)
+{
+    if (pump == nullptr || pump->pump == nullptr || av_index < 0) {
+        return -1;
+    }
+    if (!pump->pump->resume(av_index)) {
+        return -1;
+    }
+    pump->av_index = av_index;
+    return 0;
+}
+
+int fp_wait(fp_pump *pump, int timeout_ms)
+{
+    if (pump == nullptr || pump->pump == nullptr) {
+        return 1;
+    }
+    return pump->pump->wait(timeout_ms) ? 1 : 0;
+}
+
+void fp_stop(fp_pump *pump)
+{
+    if (pump != nullptr && pump->pump != nullptr) {
+        pump->pump->stop();
+    }
+}
+
+int fp_set_standby(fp_pump *pump, int standby)
+{
+    if (pump == nullptr || pump->pump == nullptr) {
+        return -1;
+    }
+    return pump->pump->set_standby(standby != 0) ? 0 : -1;
+}
+
+void fp_get_stats(const fp_pump *pump, fp_stats *out)
+{
+    if (out == nullptr) {
+        return;
+    }
+    *out = fp_stats{};
+    if (pump != nullptr && pump->pump != nullptr) {
+        pump->pump->counters().copy_to(out);
+    }
+}
+
+int fp_get_keyframe(const fp_pump *pump, char *buf, int buf_size, uint64_t *sequence)
+{
+    if (sequence != nullptr) {
+        *sequence = 0;
+    }
+    if (pump == nullptr || pump->pump == nullptr || buf == nullptr || sequence == nullptr) {
+        return 0;
+    }
+
+    std::vector<uint8_t> keyframe;
+    *sequence = pump->pump->keyframe_cache().keyframe(keyframe);
+    int size = static_cast<int>(keyframe.size());
+    if (size <= buf_size) {
+        std::memcpy(buf, keyframe.data(), keyframe.size());
+    }
+    return size;
+}
+
+void fp_destroy(fp_pump *pump)
+{
+    // ~Pump() stops the threads before the SDK handle is released
+    delete pump;
+}
+
+fp_receiver *fp_receiver_create(const char *iotc_lib_path)
+{
+    if (iotc_lib_path == nullptr) {
+        return nullptr;
+    }
+
+    auto handle = std::make_unique<fp_receiver>();
+    if (!handle->api.load(iotc_lib_path)) {
+        return nullptr;
+    }
+    handle->receiver = std::make_unique<framepump::BatchReceiver>(handle->api);
+    return handle.release();
+}
+
+int fp_recv_video_batch(fp_receiver *receiver, int av_index, fp_batch_frame *frames,
+                        int max_frames)
+{
+    if (receiver == nullptr || frames == nullptr) {
+        return 0;
+    }
+    return receiver->receiver->recv_video(av_index, frames, max_frames);
+}
+
+int fp_recv_audio_batch(fp_receiver *receiver, int av_index, fp_batch_frame *frames,
+                        int max_frames, int min_buffered)
+{
+    if (receiver == nullptr || frames == nullptr) {
+        return 0;
+    }
+    return receiver->receiver->recv_audio(av_index, frames, max_frames, min_buffered);
+}
+
+void fp_receiver_destroy(fp_receiver *receiver)
+{
+    delete receiver;
+}
+
+}  // extern "C"
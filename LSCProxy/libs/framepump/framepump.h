@@ -0,0 +1,241 @@
+/*
+ * Frame pump C API.
+ *
+ * Owns the avRecvFrameData2 / avRecvAudioData loops of one AV session on
+ * native threads and either writes the frames to the video and audio FIFOs
+ * or publishes them to the RTSP server itself, and can also record them to
+ * disk and share them with local readers through shared memory, so the
+ * Python side only starts and stops the pump and reads its statistics.
+ * Every stream has a receive thread that keeps the SDK drained and a writer
+ * thread that feeds the output, with a preallocated ring of frames in
+ * between.
+ *
+ * The Python receive loops, which run when the pump is not used, can receive
+ * through an fp_receiver instead of calling the SDK themselves. It fills a
+ * batch of frames per call, so the ctypes cost is paid once per batch.
+ *
+ * Loaded through ctypes by framepump.py. Every struct below is mirrored
+ * there and must be kept in sync.
+ */
+#ifndef FRAMEPUMP_H
+#define FRAMEPUMP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fp_pump fp_pump;
+typedef struct fp_receiver fp_receiver;
+
+/*
+ * Buckets of the write latency histograms, with upper bounds of 100 us,
+ * 500 us, 1, 5, 10, 50, 100 and 500 ms. The last bucket is unbounded.
+ */
+#define FP_LATENCY_BUCKETS 9
+
+/* What a receive thread does with a frame when its ring is full */
+enum fp_ring_policy {
+    FP_RING_DROP = 0,  /* Drop it, video resumes at the next keyframe */
+    FP_RING_BLOCK = 1, /* Wait for the writer, the SDK buffers meanwhile */
+};
+
+typedef struct fp_config {
+    int video_buf_size;
+    int audio_buf_size;
+    /* Receive lag after which frames are dropped, 0 never drops */
+    int max_latency_ms;
+    /* Frames queued between the receive and the writer threads */
+    int video_ring_frames;
+    int audio_ring_frames;
+    int ring_policy;
+    /*
+     * Bytes the frames of the rings, the keyframe cache and the recorder
+     * may take together, 0 for no limit. Frames beyond it are dropped.
+     */
+    uint64_t memory_budget;
+} fp_config;
+
+typedef struct fp_stats {
+    uint64_t video_frames;
+    uint64_t video_bytes;
+    uint64_t video_lost;
+    uint64_t audio_frames;
+    uint64_t audio_bytes;
+    uint64_t audio_lost;
+    uint64_t write_errors;
+    uint64_t fifo_reopens;
+    uint64_t rtp_packets;
+    uint64_t rtp_bytes;
+    uint64_t publisher_connects;
+    uint64_t video_dropped;
+    uint64_t audio_dropped;
+    uint64_t video_overflows;
+    uint64_t audio_overflows;
+    /* Frames and bytes handed to the FIFO or the publisher */
+    uint64_t video_written;
+    uint64_t video_written_bytes;
+    uint64_t audio_written;
+    uint64_t audio_written_bytes;
+    /* Times the backlog control started dropping */
+    uint64_t video_flushes;
+    uint64_t audio_flushes;
+    /* Receive lag of the last frame */
+    int64_t video_lag_ms;
+    int64_t audio_lag_ms;
+    /* Time the FIFO write or the RTP send of a frame took, not cumulative */
+    uint64_t video_write_us[FP_LATENCY_BUCKETS];
+    uint64_t video_write_us_sum;
+    uint64_t audio_write_us[FP_LATENCY_BUCKETS];
+    uint64_t audio_write_us_sum;
+    /* FRAMEINFO_t codec_id of the last frame, 0 before the first */
+    uint64_t video_codec;
+    uint64_t audio_codec;
+    /* Segments the recorder started, bytes it wrote and frames it dropped */
+    uint64_t record_segments;
+    uint64_t record_bytes;
+    uint64_t record_dropped;
+    /* Frames and bytes published to the shared memory frame bus */
+    uint64_t bus_frames;
+    uint64_t bus_bytes;
+    /* Bytes of frame memory held and blocks the memory budget refused */
+    uint64_t memory_bytes;
+    uint64_t memory_refused;
+    /* Video frames the SDK dropped for not fitting into the receive buffer */
+    uint64_t video_oversized;
+} fp_stats;
+
+typedef struct fp_recorder_config {
+    /* Length of a segment, it ends at the first keyframe after it */
+    int segment_seconds;
+    /* Segments older than this are removed, 0 keeps them */
+    int max_age_seconds;
+    /* The oldest segments are removed while the directory holds more, 0 for no limit */
+    uint64_t max_bytes;
+    /* Interval in which the written data is synced to the disk */
+    int sync_seconds;
+} fp_recorder_config;
+
+/* Size of FRAMEINFO_t */
+#define FP_FRAME_INFO_SIZE 24
+
+/* One frame of a batched receive */
+typedef struct fp_batch_frame {
+    /* Buffer to receive the frame into and its size, set by the caller */
+    char *data;
+    int capacity;
+    /* Size of the frame, or the error the receive call returned */
+    int status;
+    /* Size of the frame that did not fit, for AV_ER_BUFPARA_MAXSIZE_INSUFF */
+    int expected_size;
+    /* FRAMEINFO_t of the frame */
+    uint8_t info[FP_FRAME_INFO_SIZE];
+} fp_batch_frame;
+
+/*
+ * Creates a pump for an already started AV client. iotc_lib_path is the
+ * libIOTCAPIs_ALL.so the session was created with. Returns NULL on failure.
+ */
+fp_pump *fp_create(const char *iotc_lib_path, int av_index, const fp_config *config);
+
+/*
+ * Also records the frames into fragmented MP4 segments in directory, which
+ * must exist, next to the FIFOs or the publisher. Call before fp_start or
+ * fp_start_publisher. Returns 0 on success.
+ */
+int fp_record(fp_pump *pump, const char *directory, const fp_recorder_config *config);
+
+/*
+ * Also publishes the frames to the shared memory frame bus name, e.g.
+ * /lscproxy-cam1, with data_size bytes for the frames. The layout and a
+ * client are in frame_bus.h. Call before fp_start or fp_start_publisher.
+ * Returns 0 on success.
+ */
+int fp_frame_bus(fp_pump *pump, const char *name, uint64_t data_size);
+
+/*
+ * Starts the receive threads. The FIFOs are opened by the threads
+ * themselves, so this does not block until the reader shows up.
+ * Returns 0 on success.
+ */
+int fp_start(fp_pump *pump, const char *video_fifo_path, const char *audio_fifo_path);
+
+/*
+ * Starts the receive threads and publishes the frames to the RTSP server at
+ * url, e.g. rtsp://localhost:8554/stream, instead of writing them to the
+ * FIFOs. Returns 0 on success.
+ */
+int fp_start_publisher(fp_pump *pump, const char *url);
+
+/*
+ * Restarts the receive threads on the new AV session av_index after the
+ * previous session was closed, i.e. after fp_wait returned 1. The FIFOs or
+ * the RTSP connection stay open in the meantime, so their readers stay
+ * attached, and the video resumes at the next keyframe. Returns 0 on
+ * success, -1 if the pump was not started or the threads still run.
+ */
+int fp_resume(fp_pump *pump, int av_index);
+
+/*
+ * Waits up to timeout_ms for both receive threads to exit, which happens
+ * when the session is closed. Returns 1 once they have exited, 0 on timeout.
+ */
+int fp_wait(fp_pump *pump, int timeout_ms);
+
+/* Asks the receive threads to exit and joins them. */
+void fp_stop(fp_pump *pump);
+
+/*
+ * Puts the output of a started pump into standby while no one reads the
+ * stream, or takes it out again with standby 0. In standby the publisher
+ * closes its RTSP connection, so the server sees no publisher, and ignores
+ * the frames. It publishes again from the next keyframe. The FIFOs are not
+ * affected. Returns 0 on success, -1 if the pump was not started.
+ */
+int fp_set_standby(fp_pump *pump, int standby);
+
+void fp_get_stats(const fp_pump *pump, fp_stats *out);
+
+/*
+ * Copies the last keyframe the pump handed to its output into buf, with
+ * the SPS and PPS in front, so it decodes on its own. Returns its size, or
+ * 0 if no keyframe has been cached. The keyframe is only copied if it fits
+ * into buf_size, a larger size asks for a larger buffer. *sequence is set
+ * to the number of the keyframe, which changes with every keyframe.
+ */
+int fp_get_keyframe(const fp_pump *pump, char *buf, int buf_size, uint64_t *sequence);
+
+/* Stops the pump if needed and frees it. */
+void fp_destroy(fp_pump *pump);
+
+/*
+ * Creates a receiver for the Python receive loops. iotc_lib_path is the
+ * libIOTCAPIs_ALL.so the sessions are created with. Returns NULL on failure.
+ */
+fp_receiver *fp_receiver_create(const char *iotc_lib_path);
+
+/*
+ * Receives up to max_frames video frames of the session av_index into
+ * frames, one per entry, and returns how many entries were filled. Stops
+ * early once no frame is ready, which is not reported, or after the first
+ * entry with a negative status, e.g. a closed session.
+ */
+int fp_recv_video_batch(fp_receiver *receiver, int av_index, fp_batch_frame *frames,
+                        int max_frames);
+
+/*
+ * Like fp_recv_video_batch for audio, but only receives while more than
+ * min_buffered - 1 frames are buffered, as reported by avCheckAudioBuf. An
+ * error of avCheckAudioBuf is returned as the status of a single entry.
+ */
+int fp_recv_audio_batch(fp_receiver *receiver, int av_index, fp_batch_frame *frames,
+                        int max_frames, int min_buffered);
+
+void fp_receiver_destroy(fp_receiver *receiver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAMEPUMP_H */
@@ -0,0 +1,102 @@
+#include "h264.h"
+
+#include <cstdio>
+
+namespace framepump {
+namespace h264 {
+
+namespace {
+
+// Returns the offset of the next 00 00 01 start code at or after pos, or size.
+size_t find_start_code(const uint8_t *data, size_t size, size_t pos)
+{
+    for (; pos + 3 <= size; ++pos) {
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+std::string base64(const std::vector<uint8_t> &data)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += alphabet[(v >> 18) & 0x3f];
+        out += alphabet[(v >> 12) & 0x3f];
+        out += alphabet[(v >> 6) & 0x3f];
+        out += alphabet[v & 0x3f];
+    }
+    if (i + 1 == data.size()) {
+        uint32_t v = data[i] << 16;
+        out += alphabet[(v >> 18) & 0x3f];
+        out += alphabet[(v >> 12) & 0x3f];
+        out += "==";
+    } else if (i + 2 == data.size()) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8);
+        out += alphabet[(v >> 18) & 0x3f];
+        out += alphabet[(v >> 12) & 0x3f];
+        out += alphabet[(v >> 6) & 0x3f];
+        out += '=';
+    }
+    return out;
+}
+
+}  // namespace
+
+bool has_idr(const uint8_t *data, size_t size)
+{
+    for (size_t pos = find_start_code(data, size, 0); pos + 3 < size;
+         pos = find_start_code(data, size, pos + 3)) {
+        if ((data[pos + 3] & 0x1f) == nal_idr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<NalUnit> split(const uint8_t *data, size_t size)
+{
+    std::vector<NalUnit> units;
+
+    size_t start = find_start_code(data, size, 0);
+    while (start < size) {
+        size_t begin = start + 3;
+        size_t next = find_start_code(data, size, begin);
+
+        // A four byte start code leaves a zero byte at the end of the unit
+        size_t end = next;
+        while (end > begin && next < size && data[end - 1] == 0) {
+            --end;
+        }
+        if (end > begin) {
+            units.push_back({data + begin, end - begin});
+        }
+        start = next;
+    }
+    return units;
+}
+
+std::string profile_level_id(const std::vector<uint8_t> &sps)
+{
+    if (sps.size() < 4) {
+        return "42001f";
+    }
+    char hex[7];
+    std::snprintf(hex, sizeof(hex), "%02x%02x%02x", sps[1], sps[2], sps[3]);
+    return hex;
+}
+
+std::string sprop_parameter_sets(const std::vector<uint8_t> &sps, const std::vector<uint8_t> &pps)
+{
+    return base64(sps) + "," + base64(pps);
+}
+
+}  // namespace h264
+}  // namespace framepump
@@ -0,0 +1,41 @@
+// Helpers for the Annex B H.264 byte stream the camera delivers.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace framepump {
+namespace h264 {
+
+enum NalType : uint8_t {
+    nal_slice = 1,
+    nal_idr = 5,
+    nal_sei = 6,
+    nal_sps = 7,
+    nal_pps = 8,
+    nal_aud = 9,
+};
+
+struct NalUnit {
+    const uint8_t *data;  // First byte is the NAL header, start code stripped
+    size_t size;
+
+    NalType type() const { return static_cast<NalType>(data[0] & 0x1f); }
+};
+
+// Splits an access unit into its NAL units.
+std::vector<NalUnit> split(const uint8_t *data, size_t size);
+
+// Whether an access unit contains an IDR slice, without splitting it.
+bool has_idr(const uint8_t *data, size_t size);
+
+// The profile-level-id of an SDP fmtp line, taken from the SPS.
+std::string profile_level_id(const std::vector<uint8_t> &sps);
+
+// The sprop-parameter-sets of an SDP fmtp line.
+std::string sprop_parameter_sets(const std::vector<uint8_t> &sps, const std::vector<uint8_t> &pps);
+
+}  // namespace h264
+}  // namespace framepump
@@ -0,0 +1,112 @@
+#include "keyframe_cache.h"
+
+#include <iterator>
+#include <utility>
+
+#include "h264.h"
+
+namespace framepump {
+
+namespace {
+
+constexpr uint8_t start_code[] = {0, 0, 0, 1};
+
+}  // namespace
+
+KeyframeCache::KeyframeCache(size_t max_bytes, FramePool &pool)
+    : max_bytes_(max_bytes), pool_(pool)
+{
+}
+
+void KeyframeCache::add(const FrameSlot &frame, bool keyframe)
+{
+    std::vector<uint8_t> parameter_sets;
+    if (keyframe) {
+        for (const h264::NalUnit &unit : h264::split(frame.data.data(), frame.size)) {
+            if (unit.type() == h264::nal_sps || unit.type() == h264::nal_pps) {
+                parameter_sets.insert(parameter_sets.end(), std::begin(start_code),
+                                      std::end(start_code));
+                parameter_sets.insert(parameter_sets.end(), unit.data, unit.data + unit.size);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keyframe) {
+        count_ = 0;
+        bytes_ = 0;
+        full_ = false;
+        keyframe_time_ = std::chrono::steady_clock::now();
+        ++sequence_;
+        keyframe_has_parameter_sets_ = !parameter_sets.empty();
+        if (keyframe_has_parameter_sets_) {
+            parameter_sets_ = std::move(parameter_sets);
+        }
+    } else if (count_ == 0 || full_) {
+        // Without the frames before it the frame cannot be decoded
+        return;
+    }
+    if (bytes_ + frame.size > max_bytes_) {
+        full_ = true;
+        return;
+    }
+
+    if (count_ == slots_.size()) {
+        slots_.emplace_back();
+        slots_.back().data = FrameBuffer(&pool_);
+    }
+    FrameSlot &slot = slots_[count_];
+    if (!slot.data.share(frame.data, frame.size)) {
+        pool_.refused();
+        full_ = true;
+        return;
+    }
+    ++count_;
+    slot.size = frame.size;
+    slot.info = frame.info;
+    bytes_ += frame.size;
+}
+
+void KeyframeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The blocks go back to the pool while there is no session
+    for (FrameSlot &slot : slots_) {
+        slot.data.reset();
+    }
+    count_ = 0;
+    bytes_ = 0;
+    full_ = false;
+}
+
+size_t KeyframeCache::copy(std::vector<FrameSlot> &frames, std::chrono::milliseconds max_age) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0 || std::chrono::steady_clock::now() - keyframe_time_ > max_age) {
+        frames.clear();
+        return 0;
+    }
+    frames.resize(count_);
+    for (size_t i = 0; i < count_; ++i) {
+        frames[i].data = slots_[i].data;
+        frames[i].size = slots_[i].size;
+        frames[i].info = slots_[i].info;
+    }
+    return count_;
+}
+
+uint64_t KeyframeCache::keyframe(std::vector<uint8_t> &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.clear();
+    if (count_ == 0) {
+        return 0;
+    }
+    if (!keyframe_has_parameter_sets_) {
+        out = parameter_sets_;
+    }
+    out.insert(out.end(), slots_[0].data.data(), slots_[0].data.data() + slots_[0].size);
+    return sequence_;
+}
+
+}  // namespace framepump
@@ -0,0 +1,60 @@
+// The video from the last keyframe on, to start new consumers right away.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "sink.h"
+
+namespace framepump {
+
+// Keeps the last keyframe, with the SPS and PPS the camera sends along
+// with it, and the frames of its GOP received since. A consumer that starts
+// in the middle of a GOP sends these first instead of waiting up to a GOP
+// for the next keyframe. The slots and their blocks of the pool are reused
+// from GOP to GOP, so once the largest GOP has been seen adding a frame no
+// longer allocates.
+//
+// Filled by the video writer thread, other threads take copies.
+class KeyframeCache {
+public:
+    KeyframeCache(size_t max_bytes, FramePool &pool);
+
+    // Adds a frame that is handed to the sink, sharing the block of a large
+    // one. A keyframe starts over, a frame that does not fit into max_bytes
+    // or the budget of the pool ends the cached GOP early.
+    void add(const FrameSlot &frame, bool keyframe);
+    void clear();
+
+    // Shares the cached frames with frames, oldest first, and returns their
+    // number. Returns 0 if there is no keyframe or it was received longer
+    // than max_age ago, e.g. before the camera was stopped.
+    size_t copy(std::vector<FrameSlot> &frames, std::chrono::milliseconds max_age) const;
+
+    // Copies the last keyframe into out, preceded by the last SPS and PPS
+    // if it does not carry them itself, so out decodes on its own. Returns
+    // the number of the keyframe, which changes with every keyframe, or 0
+    // if none has been cached yet.
+    uint64_t keyframe(std::vector<uint8_t> &out) const;
+
+private:
+    const size_t max_bytes_;
+    FramePool &pool_;
+    mutable std::mutex mutex_;
+    std::vector<FrameSlot> slots_;
+    size_t count_ = 0;
+    size_t bytes_ = 0;
+    bool full_ = false;
+    std::chrono::steady_clock::time_point keyframe_time_{};
+    uint64_t sequence_ = 0;
+    // Annex B SPS and PPS of the last keyframe that carried them
+    std::vector<uint8_t> parameter_sets_;
+    bool keyframe_has_parameter_sets_ = false;
+};
+
+}  // namespace framepump
@@ -0,0 +1,20 @@
+// Console logging for the pump threads.
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace framepump {
+
+// printf() to stdout, flushed right away so the lines interleave with the
+// output of the Python side and of the ffmpeg/mediamtx children.
+__attribute__((format(printf, 1, 2))) inline void print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+    std::fflush(stdout);
+}
+
+}  // namespace framepump
@@ -0,0 +1,405 @@
+#include "mp4.h"
+
+#include <cstring>
+
+#include "tutk_api.h"
+
+namespace framepump {
+namespace mp4 {
+
+namespace {
+
+// Samples of the camera's G.711 and PCM audio per second
+constexpr uint32_t narrowband_rate = 8000;
+// trun flags: data-offset, sample-duration, sample-size and sample-flags present
+constexpr uint32_t trun_data_offset = 0x000001;
+constexpr uint32_t trun_duration = 0x000100;
+constexpr uint32_t trun_size = 0x000200;
+constexpr uint32_t trun_flags = 0x000400;
+// tfhd flag: data offsets are relative to the moof
+constexpr uint32_t tfhd_default_base_is_moof = 0x020000;
+// sample_depends_on 2 for sync samples, 1 and sample_is_non_sync_sample for the rest
+constexpr uint32_t sync_sample_flags = 0x02000000;
+constexpr uint32_t non_sync_sample_flags = 0x01010000;
+constexpr uint32_t video_track_id = 1;
+constexpr uint32_t audio_track_id = 2;
+
+constexpr uint32_t unity_matrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+
+// Appends big endian fields and boxes to a buffer. A box is begun, filled
+// and ended, which writes its size once its content is known.
+class BoxWriter {
+public:
+    explicit BoxWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+    void u8(uint8_t v) { out_.push_back(v); }
+    void u16(uint16_t v)
+    {
+        u8(v >> 8);
+        u8(v & 0xff);
+    }
+    void u24(uint32_t v)
+    {
+        u8((v >> 16) & 0xff);
+        u16(v & 0xffff);
+    }
+    void u32(uint32_t v)
+    {
+        u16(v >> 16);
+        u16(v & 0xffff);
+    }
+    void u64(uint64_t v)
+    {
+        u32(static_cast<uint32_t>(v >> 32));
+        u32(static_cast<uint32_t>(v));
+    }
+    void fourcc(const char *type) { bytes(reinterpret_cast<const uint8_t *>(type), 4); }
+    void bytes(const uint8_t *data, size_t size) { out_.insert(out_.end(), data, data + size); }
+    void zeros(size_t size) { out_.insert(out_.end(), size, 0); }
+    void matrix()
+    {
+        for (uint32_t v : unity_matrix) {
+            u32(v);
+        }
+    }
+
+    void begin(const char *type)
+    {
+        open_.push_back(out_.size());
+        u32(0);
+        fourcc(type);
+    }
+    void begin_full(const char *type, uint8_t version, uint32_t flags)
+    {
+        begin(type);
+        u8(version);
+        u24(flags);
+    }
+    void end()
+    {
+        size_t start = open_.back();
+        open_.pop_back();
+        patch_u32(start, static_cast<uint32_t>(out_.size() - start));
+    }
+
+    size_t position() const { return out_.size(); }
+    void patch_u32(size_t offset, uint32_t v)
+    {
+        out_[offset] = v >> 24;
+        out_[offset + 1] = (v >> 16) & 0xff;
+        out_[offset + 2] = (v >> 8) & 0xff;
+        out_[offset + 3] = v & 0xff;
+    }
+
+private:
+    std::vector<uint8_t> &out_;
+    std::vector<size_t> open_;
+};
+
+void write_tkhd(BoxWriter &w, uint32_t track_id, bool audio, uint32_t width, uint32_t height)
+{
+    // Enabled, in movie and in preview
+    w.begin_full("tkhd", 0, 0x000007);
+    w.u32(0);  // Creation and modification time
+    w.u32(0);
+    w.u32(track_id);
+    w.u32(0);
+    w.u32(0);  // Duration, unknown in a fragmented file
+    w.zeros(8);
+    w.u16(0);  // Layer and alternate group
+    w.u16(0);
+    w.u16(audio ? 0x0100 : 0);  // Volume
+    w.u16(0);
+    w.matrix();
+    w.u32(width << 16);
+    w.u32(height << 16);
+    w.end();
+}
+
+void write_mdhd(BoxWriter &w, uint32_t timescale)
+{
+    w.begin_full("mdhd", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.u32(timescale);
+    w.u32(0);
+    w.u16(0x55c4);  // Language "und"
+    w.u16(0);
+    w.end();
+}
+
+void write_hdlr(BoxWriter &w, const char *handler, const char *name)
+{
+    w.begin_full("hdlr", 0, 0);
+    w.u32(0);
+    w.fourcc(handler);
+    w.zeros(12);
+    w.bytes(reinterpret_cast<const uint8_t *>(name), std::strlen(name) + 1);
+    w.end();
+}
+
+void write_dinf(BoxWriter &w)
+{
+    w.begin("dinf");
+    w.begin_full("dref", 0, 0);
+    w.u32(1);
+    // The samples are in this file
+    w.begin_full("url ", 0, 0x000001);
+    w.end();
+    w.end();
+    w.end();
+}
+
+void write_avc1(BoxWriter &w, const VideoTrack &video)
+{
+    w.begin("avc1");
+    w.zeros(6);
+    w.u16(1);  // Data reference index
+    w.zeros(16);
+    w.u16(static_cast<uint16_t>(video.width));
+    w.u16(static_cast<uint16_t>(video.height));
+    w.u32(0x00480000);  // 72 dpi
+    w.u32(0x00480000);
+    w.u32(0);
+    w.u16(1);  // Frame count
+    w.zeros(32);  // Compressor name
+    w.u16(0x0018);  // Depth
+    w.u16(0xffff);
+
+    w.begin("avcC");
+    w.u8(1);
+    // Profile, compatibility and level from the SPS
+    w.u8(video.sps.size() > 1 ? video.sps[1] : 0);
+    w.u8(video.sps.size() > 2 ? video.sps[2] : 0);
+    w.u8(video.sps.size() > 3 ? video.sps[3] : 0);
+    w.u8(0xff);  // 4 byte NAL unit lengths
+    w.u8(0xe1);  // One SPS
+    w.u16(static_cast<uint16_t>(video.sps.size()));
+    w.bytes(video.sps.data(), video.sps.size());
+    w.u8(1);
+    w.u16(static_cast<uint16_t>(video.pps.size()));
+    w.bytes(video.pps.data(), video.pps.size());
+    w.end();
+    w.end();
+}
+
+void write_esds(BoxWriter &w, const aac::Config &config)
+{
+    // The descriptors are short enough for single byte lengths
+    w.begin_full("esds", 0, 0);
+    w.u8(0x03);  // ES_Descriptor
+    w.u8(25);
+    w.u16(0);
+    w.u8(0);
+    w.u8(0x04);  // DecoderConfigDescriptor
+    w.u8(17);
+    w.u8(0x40);  // MPEG-4 audio
+    w.u8(0x15);  // Audio stream
+    w.u24(0);
+    w.u32(0);
+    w.u32(0);
+    w.u8(0x05);  // DecoderSpecificInfo, the AudioSpecificConfig
+    w.u8(2);
+    w.u16(static_cast<uint16_t>((config.object_type << 11) | (config.sampling_index << 7) |
+                                (config.channels << 3)));
+    w.u8(0x06);  // SLConfigDescriptor
+    w.u8(1);
+    w.u8(0x02);
+    w.end();
+}
+
+void write_audio_entry(BoxWriter &w, const AudioTrack &audio)
+{
+    // G.711 and PCM use the QuickTime sample entries, which ffmpeg and VLC read
+    const char *type = "sowt";
+    if (audio.codec == MEDIA_CODEC_AUDIO_AAC) {
+        type = "mp4a";
+    } else if (audio.codec == MEDIA_CODEC_AUDIO_G711U) {
+        type = "ulaw";
+    } else if (audio.codec == MEDIA_CODEC_AUDIO_G711A) {
+        type = "alaw";
+    }
+
+    w.begin(type);
+    w.zeros(6);
+    w.u16(1);
+    w.zeros(8);
+    w.u16(audio.channels());
+    w.u16(16);  // Sample size
+    w.u32(0);
+    w.u32(audio.sample_rate() << 16);
+    if (audio.codec == MEDIA_CODEC_AUDIO_AAC) {
+        write_esds(w, audio.aac_config);
+    }
+    w.end();
+}
+
+void write_trak(BoxWriter &w, const VideoTrack &video, const AudioTrack *audio)
+{
+    w.begin("trak");
+    if (audio == nullptr) {
+        write_tkhd(w, video_track_id, false, video.width, video.height);
+    } else {
+        write_tkhd(w, audio_track_id, true, 0, 0);
+    }
+    w.begin("mdia");
+    write_mdhd(w, audio == nullptr ? video_timescale : audio->sample_rate());
+    if (audio == nullptr) {
+        write_hdlr(w, "vide", "VideoHandler");
+    } else {
+        write_hdlr(w, "soun", "SoundHandler");
+    }
+    w.begin("minf");
+    if (audio == nullptr) {
+        w.begin_full("vmhd", 0, 0x000001);
+        w.zeros(8);
+    } else {
+        w.begin_full("smhd", 0, 0);
+        w.zeros(4);
+    }
+    w.end();
+    write_dinf(w);
+
+    w.begin("stbl");
+    w.begin_full("stsd", 0, 0);
+    w.u32(1);
+    if (audio == nullptr) {
+        write_avc1(w, video);
+    } else {
+        write_audio_entry(w, *audio);
+    }
+    w.end();
+    for (const char *type : {"stts", "stsc", "stco"}) {
+        w.begin_full(type, 0, 0);
+        w.u32(0);
+        w.end();
+    }
+    w.begin_full("stsz", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.end();
+    w.end();  // stbl
+
+    w.end();  // minf
+    w.end();  // mdia
+    w.end();  // trak
+}
+
+void write_trex(BoxWriter &w, uint32_t track_id)
+{
+    w.begin_full("trex", 0, 0);
+    w.u32(track_id);
+    w.u32(1);  // Sample description index
+    w.u32(0);
+    w.u32(0);
+    w.u32(0);
+    w.end();
+}
+
+// Writes the traf of a run and returns the offset of its data_offset field.
+size_t write_traf(BoxWriter &w, uint32_t track_id, const Run &run, bool video)
+{
+    w.begin("traf");
+    w.begin_full("tfhd", 0, tfhd_default_base_is_moof);
+    w.u32(track_id);
+    w.end();
+    w.begin_full("tfdt", 1, 0);
+    w.u64(run.base_time);
+    w.end();
+
+    uint32_t flags = trun_data_offset | trun_duration | trun_size | (video ? trun_flags : 0);
+    w.begin_full("trun", 0, flags);
+    w.u32(static_cast<uint32_t>(run.samples->size()));
+    size_t data_offset = w.position();
+    w.u32(0);
+    for (const Sample &sample : *run.samples) {
+        w.u32(sample.duration);
+        w.u32(sample.size);
+        if (video) {
+            w.u32(sample.sync ? sync_sample_flags : non_sync_sample_flags);
+        }
+    }
+    w.end();
+    w.end();
+    return data_offset;
+}
+
+}  // namespace
+
+uint32_t AudioTrack::sample_rate() const
+{
+    return codec == MEDIA_CODEC_AUDIO_AAC ? aac_config.sample_rate() : narrowband_rate;
+}
+
+uint16_t AudioTrack::channels() const
+{
+    return codec == MEDIA_CODEC_AUDIO_AAC && aac_config.channels != 0 ? aac_config.channels : 1;
+}
+
+void init_segment(const VideoTrack &video, const AudioTrack &audio, std::vector<uint8_t> &out)
+{
+    BoxWriter w(out);
+    w.begin("ftyp");
+    w.fourcc("isom");
+    w.u32(0x200);
+    for (const char *brand : {"isom", "iso6", "avc1", "mp41"}) {
+        w.fourcc(brand);
+    }
+    w.end();
+
+    w.begin("moov");
+    w.begin_full("mvhd", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.u32(1000);  // Timescale
+    w.u32(0);
+    w.u32(0x00010000);  // Rate
+    w.u16(0x0100);  // Volume
+    w.zeros(10);
+    w.matrix();
+    w.zeros(24);
+    w.u32(audio.codec != 0 ? audio_track_id + 1 : video_track_id + 1);
+    w.end();
+
+    write_trak(w, video, nullptr);
+    if (audio.codec != 0) {
+        write_trak(w, video, &audio);
+    }
+
+    w.begin("mvex");
+    write_trex(w, video_track_id);
+    if (audio.codec != 0) {
+        write_trex(w, audio_track_id);
+    }
+    w.end();
+    w.end();  // moov
+}
+
+void fragment_header(uint32_t sequence, const Run &video, const Run *audio,
+                     std::vector<uint8_t> &out)
+{
+    bool has_audio = audio != nullptr && !audio->samples->empty();
+    size_t start = out.size();
+    BoxWriter w(out);
+    w.begin("moof");
+    w.begin_full("mfhd", 0, 0);
+    w.u32(sequence);
+    w.end();
+    size_t video_offset = write_traf(w, video_track_id, video, true);
+    size_t audio_offset = has_audio ? write_traf(w, audio_track_id, *audio, false) : 0;
+    w.end();
+
+    // The data offsets count from the start of the moof to the data behind
+    // the mdat header
+    size_t moof_size = out.size() - start;
+    size_t data_size = video.data_size + (has_audio ? audio->data_size : 0);
+    w.u32(static_cast<uint32_t>(8 + data_size));
+    w.fourcc("mdat");
+    w.patch_u32(video_offset, static_cast<uint32_t>(moof_size + 8));
+    if (has_audio) {
+        w.patch_u32(audio_offset, static_cast<uint32_t>(moof_size + 8 + video.data_size));
+    }
+}
+
+}  // namespace mp4
+}  // namespace framepump
@@ -0,0 +1,57 @@
+// Boxes of the fragmented MP4 files the recorder writes.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aac.h"
+
+namespace framepump {
+namespace mp4 {
+
+// Timescale of the video track, the same clock as RTP.
+constexpr uint32_t video_timescale = 90000;
+
+struct VideoTrack {
+    std::vector<uint8_t> sps;  // NAL units without start code
+    std::vector<uint8_t> pps;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// codec is the FrameInfo codec_id of the audio, 0 for a file without audio.
+struct AudioTrack {
+    uint16_t codec = 0;
+    aac::Config aac_config;
+
+    uint32_t sample_rate() const;
+    uint16_t channels() const;
+};
+
+struct Sample {
+    uint32_t size;
+    uint32_t duration;  // In the timescale of the track
+    bool sync;
+};
+
+// The samples of one track in a fragment, whose data follows in the mdat
+// in this order.
+struct Run {
+    uint64_t base_time;  // Decode time of the first sample
+    const std::vector<Sample> *samples;
+    size_t data_size;
+};
+
+// Appends the ftyp and moov boxes a file starts with to out. The moov holds
+// no samples, they all come in fragments.
+void init_segment(const VideoTrack &video, const AudioTrack &audio, std::vector<uint8_t> &out);
+
+// Appends the moof box of a fragment and the header of its mdat to out. The
+// caller writes the data of the video run and then of the audio run after
+// it. audio may be null or empty.
+void fragment_header(uint32_t sequence, const Run &video, const Run *audio,
+                     std::vector<uint8_t> &out);
+
+}  // namespace mp4
+}  // namespace framepump
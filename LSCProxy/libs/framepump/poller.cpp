@@ -0,0 +1,49 @@
+#include "poller.h"
+
+#include <algorithm>
+
+namespace framepump {
+
+namespace {
+
+using std::chrono::microseconds;
+
+constexpr microseconds poll_step{2000};
+constexpr microseconds early_wakeup{3000};
+constexpr microseconds min_interval{5000};
+constexpr microseconds max_interval{1000000};
+constexpr microseconds idle_after{1000000};
+constexpr microseconds idle_backoff_start{10000};
+constexpr microseconds idle_backoff_max{200000};
+
+}  // namespace
+
+void Poller::frame_received()
+{
+    clock::time_point now = clock::now();
+    if (last_frame_ != clock::time_point{}) {
+        auto sample = std::chrono::duration_cast<microseconds>(now - last_frame_);
+        sample = std::clamp(sample, min_interval, max_interval);
+        // Exponential moving average, robust against the bursts the P2P link produces
+        interval_ = interval_.count() == 0 ? sample : (interval_ * 7 + sample) / 8;
+    }
+    last_frame_ = now;
+    backoff_ = microseconds{0};
+}
+
+microseconds Poller::next_delay()
+{
+    clock::time_point now = clock::now();
+    auto since_frame = std::chrono::duration_cast<microseconds>(now - last_frame_);
+
+    if (last_frame_ == clock::time_point{} || since_frame > idle_after) {
+        backoff_ = backoff_.count() == 0 ? idle_backoff_start
+                                         : std::min(backoff_ * 2, idle_backoff_max);
+        return backoff_;
+    }
+
+    auto until_due = interval_ - early_wakeup - since_frame;
+    return std::max(until_due, poll_step);
+}
+
+}  // namespace framepump
@@ -0,0 +1,30 @@
+// Paces a receive loop that polls the SDK.
+#pragma once
+
+#include <chrono>
+
+namespace framepump {
+
+// avRecvFrameData2 and avCheckAudioBuf never block, so the receive loops
+// have to poll. Instead of a fixed sleep, the poller learns the frame
+// interval of the stream and sleeps until shortly before the next frame is
+// due, then polls in small steps. That keeps the added latency at about a
+// poll step while waking up only a few times per frame. When no frame has
+// arrived for a while (privacy mode, stalled link) it backs off
+// exponentially, so an idle stream costs almost no wakeups.
+class Poller {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void frame_received();
+
+    // How long to sleep after the SDK reported that no data is ready.
+    std::chrono::microseconds next_delay();
+
+private:
+    clock::time_point last_frame_{};
+    std::chrono::microseconds interval_{0};
+    std::chrono::microseconds backoff_{0};
+};
+
+}  // namespace framepump
@@ -0,0 +1,397 @@
+#include "pump.h"
+
+#include <pthread.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "backlog.h"
+#include "h264.h"
+#include "log.h"
+#include "poller.h"
+
+namespace framepump {
+
+namespace {
+
+constexpr int audio_min_buffered_frames = 50;
+constexpr auto keepalive_interval = std::chrono::seconds(1);
+constexpr auto ring_full_delay = std::chrono::milliseconds(2);
+constexpr auto writer_idle_wait = std::chrono::milliseconds(100);
+// Room for a few seconds of 1080p, a longer GOP is only cached in part
+constexpr size_t keyframe_cache_bytes = 4 * 1024 * 1024;
+
+// The keyframe cache may take a quarter of the memory budget, the rest is
+// left to the rings
+size_t keyframe_cache_size(const fp_config &config)
+{
+    size_t share = static_cast<size_t>(config.memory_budget) / 4;
+    return share > 0 && share < keyframe_cache_bytes ? share : keyframe_cache_bytes;
+}
+
+// Returns true for the statuses that end the session, logging which one.
+bool session_closed(int status, const char *thread_name)
+{
+    switch (status) {
+    case AV_ER_SESSION_CLOSE_BY_REMOTE:
+        print("[%s] AV_ER_SESSION_CLOSE_BY_REMOTE\n", thread_name);
+        return true;
+    case AV_ER_REMOTE_TIMEOUT_DISCONNECT:
+        print("[%s] AV_ER_REMOTE_TIMEOUT_DISCONNECT\n", thread_name);
+        return true;
+    case IOTC_ER_INVALID_SID:
+        print("[%s] Session can't be used anymore\n", thread_name);
+        return true;
+    default:
+        return false;
+    }
+}
+
+}  // namespace
+
+Pump::Pump(const TutkApi &api, int av_index, const fp_config &config)
+    : api_(api),
+      av_index_(av_index),
+      config_(config),
+      frame_pool_(static_cast<size_t>(config.memory_budget), counters_),
+      keyframe_cache_(keyframe_cache_size(config), frame_pool_),
+      video_ring_(config.video_ring_frames, frame_pool_, config.video_buf_size),
+      audio_ring_(config.audio_ring_frames, frame_pool_, config.audio_buf_size)
+{
+}
+
+Pump::~Pump()
+{
+    stop();
+}
+
+void Pump::start(std::unique_ptr<Sink> sink, std::unique_ptr<Recorder> recorder,
+                 std::unique_ptr<FrameBusWriter> bus)
+{
+    sink_ = std::move(sink);
+    recorder_ = std::move(recorder);
+    bus_ = std::move(bus);
+    running_ = true;
+    start_threads();
+    video_writer_ = std::thread(&Pump::write_frames, this, std::ref(video_ring_), true);
+    audio_writer_ = std::thread(&Pump::write_frames, this, std::ref(audio_ring_), false);
+    keepalive_thread_ = std::thread(&Pump::keep_sink_alive, this);
+}
+
+bool Pump::resume(int av_index)
+{
+    if (!running_ || !wait(0)) {
+        return false;
+    }
+    video_thread_.join();
+    audio_thread_.join();
+    // The new session starts at a keyframe of its own
+    keyframe_cache_.clear();
+    av_index_ = av_index;
+    start_threads();
+    return true;
+}
+
+void Pump::start_threads()
+{
+    {
+        std::lock_guard<std::mutex> lock(exit_mutex_);
+        exited_threads_ = 0;
+    }
+    video_thread_ = std::thread(&Pump::receive_video, this);
+    audio_thread_ = std::thread(&Pump::receive_audio, this);
+}
+
+bool Pump::wait(int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(exit_mutex_);
+    return exit_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [this] { return exited_threads_ == 2; });
+}
+
+void Pump::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        running_ = false;
+    }
+    wake_cv_.notify_all();
+    video_ring_.wake();
+    audio_ring_.wake();
+    if (sink_ != nullptr) {
+        sink_->interrupt();
+    }
+    if (video_thread_.joinable()) {
+        video_thread_.join();
+    }
+    if (audio_thread_.joinable()) {
+        audio_thread_.join();
+    }
+    if (video_writer_.joinable()) {
+        video_writer_.join();
+    }
+    if (audio_writer_.joinable()) {
+        audio_writer_.join();
+    }
+    if (keepalive_thread_.joinable()) {
+        keepalive_thread_.join();
+    }
+    sink_.reset();
+    // Closes the segment being written
+    recorder_.reset();
+    // Tells the readers of the bus
+    bus_.reset();
+}
+
+bool Pump::set_standby(bool standby)
+{
+    if (sink_ == nullptr) {
+        return false;
+    }
+    sink_->set_standby(standby);
+    return true;
+}
+
+void Pump::sleep(std::chrono::microseconds delay)
+{
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_cv_.wait_for(lock, delay, [this] { return !running_; });
+}
+
+void Pump::keep_sink_alive()
+{
+    pthread_setname_np(pthread_self(), "fp-keepalive");
+    while (running_) {
+        sleep(keepalive_interval);
+        // Both receive threads have exited, so the session is gone until resume()
+        if (running_ && wait(0)) {
+            sink_->keepalive();
+        }
+    }
+}
+
+FrameSlot *Pump::next_slot(FrameRing &ring, size_t frame_size)
+{
+    FrameSlot *slot = ring.acquire();
+    while (slot == nullptr && config_.ring_policy == FP_RING_BLOCK && running_) {
+        sleep(ring_full_delay);
+        slot = ring.acquire();
+    }
+    // Waiting does not free memory, so this drops whatever the policy
+    if (slot != nullptr && !ring.reserve(*slot, frame_size)) {
+        return nullptr;
+    }
+    return slot;
+}
+
+void Pump::write_frames(FrameRing &ring, bool video)
+{
+    // Named so that the CPU time of every stage shows up in top -H and bench.py
+    pthread_setname_np(pthread_self(), video ? "fp-video-tx" : "fp-audio-tx");
+    while (running_) {
+        FrameSlot *slot = ring.front();
+        if (slot == nullptr) {
+            ring.wait(writer_idle_wait);
+            continue;
+        }
+
+        Frame frame{slot->data.data(), slot->size, slot->info};
+        auto started = std::chrono::steady_clock::now();
+        bool keyframe = false;
+        if (video) {
+            keyframe = (frame.info.flags & IPC_FRAME_FLAG_IFRAME) != 0 ||
+                       h264::has_idr(frame.data, frame.size);
+            keyframe_cache_.add(*slot, keyframe);
+            sink_->video_frame(frame);
+        } else {
+            sink_->audio_frame(frame);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started);
+        if (video) {
+            ++counters_.video_written;
+            counters_.video_written_bytes += frame.size;
+            counters_.video_write.record(elapsed);
+        } else {
+            ++counters_.audio_written;
+            counters_.audio_written_bytes += frame.size;
+            counters_.audio_write.record(elapsed);
+        }
+        // Only hands the frame to the ring of the recorder and copies it into the
+        // bus, outside of the write time
+        if (recorder_ != nullptr && video) {
+            recorder_->video_frame(*slot, keyframe);
+        } else if (recorder_ != nullptr) {
+            recorder_->audio_frame(*slot);
+        }
+        if (bus_ != nullptr) {
+            bus_->publish(frame, video ? bus_video : bus_audio, keyframe);
+        }
+        ring.release();
+    }
+}
+
+void Pump::thread_exited()
+{
+    {
+        std::lock_guard<std::mutex> lock(exit_mutex_);
+        ++exited_threads_;
+    }
+    exit_cv_.notify_all();
+}
+
+void Pump::receive_video()
+{
+    print("Start IPCAM video stream...\n");
+    pthread_setname_np(pthread_self(), "fp-video-rx");
+
+    // Grows once a frame does not fit, the SDK drops such a frame
+    size_t frame_size = config_.video_buf_size;
+    // Frames that do not fit into the ring are received here and dropped
+    std::vector<uint8_t> overflow_buf(frame_size);
+    FrameInfo frame_info{};
+    int actual_frame_size = 0;
+    int expected_frame_size = 0;
+    int actual_frame_info_size = 0;
+    unsigned int frame_index = 0;
+    Poller poller;
+    Backlog backlog(config_.max_latency_ms, true);
+    // A new session may start in the middle of a GOP
+    bool wait_for_keyframe = true;
+
+    while (running_) {
+        FrameSlot *slot = next_slot(video_ring_, frame_size);
+        if (!running_) {
+            break;
+        }
+        uint8_t *buf = slot != nullptr ? slot->data.data() : overflow_buf.data();
+        size_t buf_size = slot != nullptr ? slot->data.capacity() : overflow_buf.size();
+        int status = api_.recv_frame_data2(av_index_, reinterpret_cast<char *>(buf),
+                                           static_cast<int>(buf_size),
+                                           &actual_frame_size, &expected_frame_size,
+                                           reinterpret_cast<char *>(&frame_info),
+                                           sizeof(frame_info), &actual_frame_info_size,
+                                           &frame_index);
+
+        if (status == AV_ER_DATA_NOREADY) {
+            sleep(poller.next_delay());
+            continue;
+        }
+        if (session_closed(status, "thread_ReceiveVideo")) {
+            break;
+        }
+        if (status == AV_ER_BUFPARA_MAXSIZE_INSUFF) {
+            // Usually an IDR frame of a detailed scene. It is lost and its GOP
+            // with it, the following frames get a block it would have fit in.
+            ++counters_.video_oversized;
+            ++counters_.video_lost;
+            wait_for_keyframe = true;
+            size_t needed = FramePool::block_size(static_cast<size_t>(expected_frame_size));
+            if (needed > frame_size) {
+                print("[receive_video] Frame of %d bytes did not fit, receiving up to %zu bytes\n",
+                      expected_frame_size, needed);
+                frame_size = needed;
+                overflow_buf.resize(frame_size);
+            }
+            continue;
+        }
+        if (status < 0) {
+            ++counters_.video_lost;
+            continue;
+        }
+
+        // status is the size of the frame that was actually received
+        poller.frame_received();
+        ++counters_.video_frames;
+        counters_.video_bytes += status;
+        counters_.video_codec = frame_info.codec_id;
+        if (slot == nullptr) {
+            // The writer fell behind. This GOP is broken now, so resume at
+            // the next keyframe once there is room again.
+            ++counters_.video_overflows;
+            wait_for_keyframe = true;
+            continue;
+        }
+        bool keyframe = (frame_info.flags & IPC_FRAME_FLAG_IFRAME) != 0;
+        wait_for_keyframe = wait_for_keyframe && !keyframe;
+        bool flushing = backlog.dropping();
+        if (wait_for_keyframe || !backlog.accept(frame_info.timestamp, keyframe)) {
+            ++counters_.video_dropped;
+            counters_.video_flushes += !flushing && backlog.dropping();
+            continue;
+        }
+        counters_.video_lag_ms = backlog.last_lag_ms();
+        slot->size = static_cast<size_t>(status);
+        slot->info = frame_info;
+        video_ring_.commit();
+    }
+
+    print("[receive_video] thread exit\n");
+    thread_exited();
+}
+
+void Pump::receive_audio()
+{
+    print("Start IPCAM audio stream...\n");
+    pthread_setname_np(pthread_self(), "fp-audio-rx");
+
+    std::vector<uint8_t> overflow_buf(config_.audio_buf_size);
+    FrameInfo frame_info{};
+    unsigned int frame_index = 0;
+    Poller poller;
+    Backlog backlog(config_.max_latency_ms, false);
+
+    while (running_) {
+        int status = api_.check_audio_buf(av_index_);
+        if (status < 0) {
+            break;
+        }
+        if (status < audio_min_buffered_frames) {
+            sleep(poller.next_delay());
+            continue;
+        }
+
+        FrameSlot *slot = next_slot(audio_ring_, config_.audio_buf_size);
+        if (!running_) {
+            break;
+        }
+        uint8_t *buf = slot != nullptr ? slot->data.data() : overflow_buf.data();
+        status = api_.recv_audio_data(av_index_, reinterpret_cast<char *>(buf),
+                                      config_.audio_buf_size,
+                                      reinterpret_cast<char *>(&frame_info),
+                                      sizeof(frame_info), &frame_index);
+
+        if (session_closed(status, "thread_ReceiveAudio")) {
+            break;
+        }
+        if (status < 0) {
+            ++counters_.audio_lost;
+            continue;
+        }
+
+        poller.frame_received();
+        ++counters_.audio_frames;
+        counters_.audio_bytes += status;
+        counters_.audio_codec = frame_info.codec_id;
+        if (slot == nullptr) {
+            ++counters_.audio_overflows;
+            continue;
+        }
+        bool flushing = backlog.dropping();
+        if (!backlog.accept(frame_info.timestamp, false)) {
+            ++counters_.audio_dropped;
+            counters_.audio_flushes += !flushing && backlog.dropping();
+            continue;
+        }
+        counters_.audio_lag_ms = backlog.last_lag_ms();
+        slot->size = static_cast<size_t>(status);
+        slot->info = frame_info;
+        audio_ring_.commit();
+    }
+
+    print("[receive_audio] thread exit\n");
+    thread_exited();
+}
+
+}  // namespace framepump
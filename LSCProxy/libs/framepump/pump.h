@@ -0,0 +1,91 @@
+// Receive threads for one AV session.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "counters.h"
+#include "frame_bus_writer.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "framepump.h"
+#include "keyframe_cache.h"
+#include "recorder.h"
+#include "sink.h"
+#include "tutk_api.h"
+
+namespace framepump {
+
+class Pump {
+public:
+    Pump(const TutkApi &api, int av_index, const fp_config &config);
+    ~Pump();
+    Pump(const Pump &) = delete;
+    Pump &operator=(const Pump &) = delete;
+
+    // Starts the receive threads, which hand every frame to sink, and to
+    // recorder and bus if they are not null
+    void start(std::unique_ptr<Sink> sink, std::unique_ptr<Recorder> recorder = nullptr,
+               std::unique_ptr<FrameBusWriter> bus = nullptr);
+    // Restarts the receive threads on a new AV session once the previous
+    // one was closed. The sink is kept, so its consumers stay attached.
+    bool resume(int av_index);
+    bool wait(int timeout_ms);
+    void stop();
+    bool set_standby(bool standby);
+
+    const std::atomic<bool> &running() const { return running_; }
+    Counters &counters() { return counters_; }
+    const Counters &counters() const { return counters_; }
+    // Also holds the frames of the recorder, which must be destroyed first
+    FramePool &frame_pool() { return frame_pool_; }
+    const KeyframeCache &keyframe_cache() const { return keyframe_cache_; }
+
+private:
+    void start_threads();
+    void receive_video();
+    void receive_audio();
+    void write_frames(FrameRing &ring, bool video);
+
+    // The slot to receive the next frame into, with room for frame_size
+    // bytes. nullptr if the ring is full and the policy is to drop, if the
+    // memory budget has no room, or if the pump is stopping.
+    FrameSlot *next_slot(FrameRing &ring, size_t frame_size);
+    void keep_sink_alive();
+    void thread_exited();
+
+    // Sleeps for delay unless stop() is called in the meantime
+    void sleep(std::chrono::microseconds delay);
+
+    const TutkApi &api_;
+    int av_index_;
+    const fp_config config_;
+
+    std::atomic<bool> running_{false};
+    Counters counters_;
+    FramePool frame_pool_;
+    KeyframeCache keyframe_cache_;
+    std::unique_ptr<Sink> sink_;
+    std::unique_ptr<Recorder> recorder_;
+    std::unique_ptr<FrameBusWriter> bus_;
+    FrameRing video_ring_;
+    FrameRing audio_ring_;
+    std::thread video_thread_;
+    std::thread audio_thread_;
+    std::thread video_writer_;
+    std::thread audio_writer_;
+    std::thread keepalive_thread_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+
+    std::mutex exit_mutex_;
+    std::condition_variable exit_cv_;
+    int exited_threads_ = 0;
+};
+
+}  // namespace framepump
@@ -0,0 +1,441 @@
+#include "recorder.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <utility>
+
+#include "h264.h"
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+constexpr size_t video_ring_frames = 64;
+constexpr size_t audio_ring_frames = 128;
+constexpr auto idle_wait = std::chrono::milliseconds(100);
+// A longer pause between two video frames, e.g. a reconnect, ends the segment
+constexpr int64_t max_gap_ms = 3000;
+// Duration of a video frame whose successor is not known, 25 fps
+constexpr uint32_t default_frame_duration = mp4::video_timescale / 25;
+// Space reserved for the first segment, later ones reserve a bit more than
+// the previous segment took
+constexpr uint64_t initial_reserve_bytes = 16 * 1024 * 1024;
+
+bool has_suffix(const std::string &name, const char *suffix)
+{
+    size_t length = std::strlen(suffix);
+    return name.size() > length && name.compare(name.size() - length, length, suffix) == 0;
+}
+
+}  // namespace
+
+Recorder::Recorder(std::string directory, const fp_recorder_config &config, FramePool &pool,
+                   Counters &counters)
+    : directory_(std::move(directory)),
+      config_(config),
+      counters_(counters),
+      // The slots take a block of the size of each frame as it comes
+      video_ring_(video_ring_frames, pool),
+      audio_ring_(audio_ring_frames, pool),
+      reserve_bytes_(initial_reserve_bytes)
+{
+    thread_ = std::thread(&Recorder::run, this);
+}
+
+Recorder::~Recorder()
+{
+    running_ = false;
+    video_ring_.wake();
+    thread_.join();
+}
+
+void Recorder::video_frame(const FrameSlot &frame, bool keyframe)
+{
+    // After a dropped frame the GOP cannot be decoded, so wait for the next
+    wait_for_keyframe_ = wait_for_keyframe_ && !keyframe;
+    FrameSlot *slot = wait_for_keyframe_ ? nullptr : video_ring_.acquire();
+    if (slot == nullptr || !video_ring_.share(*slot, frame)) {
+        ++counters_.record_dropped;
+        wait_for_keyframe_ = true;
+        return;
+    }
+    // The recorder thread tells keyframes apart by the flag alone
+    slot->info.flags = keyframe ? slot->info.flags | IPC_FRAME_FLAG_IFRAME
+                                : slot->info.flags & ~IPC_FRAME_FLAG_IFRAME;
+    video_ring_.commit();
+}
+
+void Recorder::audio_frame(const FrameSlot &frame)
+{
+    FrameSlot *slot = audio_ring_.acquire();
+    if (slot == nullptr || !audio_ring_.share(*slot, frame)) {
+        ++counters_.record_dropped;
+        return;
+    }
+    audio_ring_.commit();
+}
+
+void Recorder::run()
+{
+    pthread_setname_np(pthread_self(), "fp-recorder");
+    while (running_) {
+        // The audio is taken first, so a fragment that ends at a keyframe
+        // has the audio received until then
+        for (FrameSlot *slot = audio_ring_.front(); slot != nullptr; slot = audio_ring_.front()) {
+            take_audio(*slot);
+            audio_ring_.release();
+        }
+        FrameSlot *slot = video_ring_.front();
+        if (slot == nullptr) {
+            video_ring_.wait(idle_wait);
+            continue;
+        }
+        take_video(*slot);
+        video_ring_.release();
+    }
+    close_segment();
+}
+
+void Recorder::take_video(const FrameSlot &slot)
+{
+    int64_t elapsed_ms = source_clock_.elapsed_ms(slot.info.timestamp);
+    bool keyframe = (slot.info.flags & IPC_FRAME_FLAG_IFRAME) != 0;
+    std::vector<h264::NalUnit> units = h264::split(slot.data.data(), slot.size);
+    for (const h264::NalUnit &unit : units) {
+        if (unit.type() == h264::nal_sps) {
+            sps_.assign(unit.data, unit.data + unit.size);
+        } else if (unit.type() == h264::nal_pps) {
+            pps_.assign(unit.data, unit.data + unit.size);
+        }
+    }
+
+    if (fd_ >= 0) {
+        int64_t gap_ms = elapsed_ms - last_video_ms_;
+        if (gap_ms < 0 || gap_ms > max_gap_ms) {
+            close_segment();
+        } else {
+            if (gap_ms > 0) {
+                video_samples_.back().duration =
+                    static_cast<uint32_t>(gap_ms * mp4::video_timescale / 1000);
+            }
+            if (keyframe) {
+                flush_fragment();
+                if (elapsed_ms - segment_start_ms_ >= config_.segment_seconds * 1000LL) {
+                    close_segment();
+                }
+            }
+        }
+    }
+    if (fd_ < 0 && (!keyframe || !open_segment(slot, elapsed_ms))) {
+        return;
+    }
+
+    if (video_samples_.empty()) {
+        fragment_start_ms_ = elapsed_ms;
+        fragment_timestamp_ = slot.info.timestamp;
+    }
+    // Annex B to 4 byte length prefixes, the access unit delimiters are dropped
+    size_t start = video_data_.size();
+    for (const h264::NalUnit &unit : units) {
+        if (unit.type() == h264::nal_aud) {
+            continue;
+        }
+        uint32_t size = static_cast<uint32_t>(unit.size);
+        uint8_t prefix[4] = {static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16),
+                             static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+        video_data_.insert(video_data_.end(), prefix, prefix + 4);
+        video_data_.insert(video_data_.end(), unit.data, unit.data + unit.size);
+    }
+    video_samples_.push_back({static_cast<uint32_t>(video_data_.size() - start),
+                              default_frame_duration, keyframe});
+    last_video_ms_ = elapsed_ms;
+}
+
+void Recorder::take_audio(const FrameSlot &slot)
+{
+    int64_t elapsed_ms = source_clock_.elapsed_ms(slot.info.timestamp);
+    uint16_t codec = slot.info.codec_id;
+    std::vector<aac::Frame> aac_frames;
+    if (codec == MEDIA_CODEC_AUDIO_AAC) {
+        aac::Config config;
+        aac_frames = aac::split(slot.data.data(), slot.size, &config);
+        if (config.valid()) {
+            aac_config_ = config;
+        }
+    }
+    // The segments announce the last codec seen
+    audio_codec_ = codec;
+
+    if (fd_ < 0 || audio_track_.codec != codec || elapsed_ms < segment_start_ms_) {
+        return;
+    }
+    uint32_t rate = audio_track_.sample_rate();
+    if (audio_samples_.empty()) {
+        // The audio clock runs on the sample count, it is set from the
+        // timestamps again if it got off by more than half a second
+        uint64_t time = static_cast<uint64_t>(elapsed_ms - segment_start_ms_) * rate / 1000;
+        uint64_t drift = time > audio_time_ ? time - audio_time_ : audio_time_ - time;
+        if (!audio_started_ || drift > rate / 2) {
+            audio_time_ = time;
+        }
+        audio_base_time_ = audio_time_;
+        audio_started_ = true;
+    }
+
+    if (codec == MEDIA_CODEC_AUDIO_AAC) {
+        for (const aac::Frame &frame : aac_frames) {
+            audio_data_.insert(audio_data_.end(), frame.data, frame.data + frame.size);
+            audio_samples_.push_back({static_cast<uint32_t>(frame.size), aac::samples_per_frame,
+                                      true});
+            audio_time_ += aac::samples_per_frame;
+        }
+        return;
+    }
+    // One byte per sample for G.711, two for PCM
+    uint32_t samples = static_cast<uint32_t>(codec == MEDIA_CODEC_AUDIO_PCM ? slot.size / 2
+                                                                              : slot.size);
+    audio_data_.insert(audio_data_.end(), slot.data.data(), slot.data.data() + slot.size);
+    audio_samples_.push_back({static_cast<uint32_t>(slot.size), samples, true});
+    audio_time_ += samples;
+}
+
+bool Recorder::open_segment(const FrameSlot &keyframe, int64_t elapsed_ms)
+{
+    if (sps_.empty() || pps_.empty()) {
+        return false;
+    }
+    // Before the new file, so its space is free already
+    remove_old_segments();
+
+    mp4::VideoTrack video;
+    video.sps = sps_;
+    video.pps = pps_;
+    video.width = keyframe.info.video_width;
+    video.height = keyframe.info.video_height;
+    audio_track_ = mp4::AudioTrack{};
+    if (audio_codec_ != MEDIA_CODEC_AUDIO_AAC || aac_config_.valid()) {
+        audio_track_.codec = audio_codec_;
+        audio_track_.aac_config = aac_config_;
+    }
+
+    // Named by the wall clock at the keyframe, so the names sort by time
+    std::time_t now = std::chrono::system_clock::to_time_t(
+        source_clock_.origin_wall_time() + std::chrono::milliseconds(elapsed_ms));
+    std::tm local{};
+    localtime_r(&now, &local);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    std::string base = directory_ + "/" + stamp;
+    for (int attempt = 2; fd_ < 0 && attempt < 10; ++attempt) {
+        fd_ = ::open((base + ".mp4").c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd_ < 0 && errno == EEXIST) {
+            base = directory_ + "/" + stamp + "-" + std::to_string(attempt);
+        } else if (fd_ < 0) {
+            break;
+        }
+    }
+    if (fd_ < 0) {
+        print("[recorder] Cannot create %s.mp4: %s\n", base.c_str(), std::strerror(errno));
+        ++counters_.write_errors;
+        return false;
+    }
+    index_fd_ = ::open((base + ".idx").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    // The file size stays at what was written, the space is only allocated.
+    // Not every file system supports it, which is fine.
+    fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(reserve_bytes_));
+
+    written_ = 0;
+    sequence_ = 0;
+    segment_start_ms_ = elapsed_ms;
+    audio_started_ = false;
+    audio_samples_.clear();
+    audio_data_.clear();
+    last_sync_ = std::chrono::steady_clock::now();
+    header_.clear();
+    mp4::init_segment(video, audio_track_, header_);
+    if (!write_all(fd_, header_.data(), header_.size())) {
+        close_segment();
+        return false;
+    }
+    written_ = header_.size();
+    ++counters_.record_segments;
+    print("[recorder] Recording to %s.mp4\n", base.c_str());
+    return true;
+}
+
+void Recorder::flush_fragment()
+{
+    if (fd_ < 0 || video_samples_.empty()) {
+        return;
+    }
+
+    mp4::Run video{static_cast<uint64_t>(fragment_start_ms_ - segment_start_ms_) *
+                       mp4::video_timescale / 1000,
+                   &video_samples_, video_data_.size()};
+    mp4::Run audio{audio_base_time_, &audio_samples_, audio_data_.size()};
+    header_.clear();
+    mp4::fragment_header(++sequence_, video, &audio, header_);
+
+    uint64_t offset = written_;
+    bool ok = write_all(fd_, header_.data(), header_.size()) &&
+              write_all(fd_, video_data_.data(), video_data_.size()) &&
+              write_all(fd_, audio_data_.data(), audio_data_.size());
+    size_t size = header_.size() + video_data_.size() + audio_data_.size();
+    video_samples_.clear();
+    video_data_.clear();
+    audio_samples_.clear();
+    audio_data_.clear();
+    if (!ok) {
+        close_segment();
+        return;
+    }
+    written_ += size;
+    counters_.record_bytes += size;
+
+    if (index_fd_ >= 0) {
+        auto wall_time = source_clock_.origin_wall_time() +
+                         std::chrono::milliseconds(fragment_start_ms_);
+        long long wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                wall_time.time_since_epoch())
+                                .count();
+        char line[80];
+        int length = std::snprintf(line, sizeof(line), "%" PRIu32 " %lld %" PRIu64 "\n",
+                                   fragment_timestamp_, wall_ms, offset);
+        write_all(index_fd_, reinterpret_cast<const uint8_t *>(line), length);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_sync_ >= std::chrono::seconds(config_.sync_seconds)) {
+        fdatasync(fd_);
+        if (index_fd_ >= 0) {
+            fdatasync(index_fd_);
+        }
+        last_sync_ = now;
+    }
+}
+
+void Recorder::close_segment()
+{
+    if (fd_ < 0) {
+        return;
+    }
+    flush_fragment();
+    // A failed write has closed the segment already
+    if (fd_ < 0) {
+        return;
+    }
+
+    // Frees the reserved space that was not used
+    if (ftruncate(fd_, static_cast<off_t>(written_)) != 0) {
+        ++counters_.write_errors;
+    }
+    fdatasync(fd_);
+    ::close(fd_);
+    fd_ = -1;
+    if (index_fd_ >= 0) {
+        fdatasync(index_fd_);
+        ::close(index_fd_);
+        index_fd_ = -1;
+    }
+    reserve_bytes_ = std::max<uint64_t>(written_ + written_ / 8, 1024 * 1024);
+}
+
+bool Recorder::write_all(int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            print("[recorder] Write failed: %s\n", std::strerror(errno));
+            ++counters_.write_errors;
+            // Sync and close instead of failing every fragment of the segment
+            if (fd == fd_) {
+                fdatasync(fd_);
+                ::close(fd_);
+                fd_ = -1;
+                if (index_fd_ >= 0) {
+                    ::close(index_fd_);
+                    index_fd_ = -1;
+                }
+                video_samples_.clear();
+                video_data_.clear();
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void Recorder::remove_old_segments()
+{
+    if (config_.max_age_seconds <= 0 && config_.max_bytes == 0) {
+        return;
+    }
+    DIR *dir = opendir(directory_.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    struct Segment {
+        std::string name;
+        uint64_t bytes;
+        std::time_t modified;
+    };
+    std::vector<Segment> segments;
+    uint64_t total = 0;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        bool segment = has_suffix(name, ".mp4");
+        if (!segment && !has_suffix(name, ".idx")) {
+            continue;
+        }
+        struct stat st{};
+        if (stat((directory_ + "/" + name).c_str(), &st) != 0) {
+            continue;
+        }
+        total += static_cast<uint64_t>(st.st_size);
+        if (segment) {
+            segments.push_back({name.substr(0, name.size() - 4),
+                                static_cast<uint64_t>(st.st_size), st.st_mtime});
+        }
+    }
+    closedir(dir);
+
+    // The names sort by time, so the oldest segments come first
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment &a, const Segment &b) { return a.name < b.name; });
+    std::time_t oldest = std::time(nullptr) - config_.max_age_seconds;
+    for (const Segment &segment : segments) {
+        bool too_old = config_.max_age_seconds > 0 && segment.modified < oldest;
+        bool too_large = config_.max_bytes != 0 && total > config_.max_bytes;
+        if (!too_old && !too_large) {
+            break;
+        }
+        std::string base = directory_ + "/" + segment.name;
+        struct stat st{};
+        if (stat((base + ".idx").c_str(), &st) == 0) {
+            total -= std::min<uint64_t>(total, static_cast<uint64_t>(st.st_size));
+        }
+        unlink((base + ".mp4").c_str());
+        unlink((base + ".idx").c_str());
+        total -= std::min(total, segment.bytes);
+        print("[recorder] Removed %s.mp4\n", base.c_str());
+    }
+}
+
+}  // namespace framepump
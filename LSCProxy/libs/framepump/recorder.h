@@ -0,0 +1,106 @@
+// Records the frames into rotating fragmented MP4 files.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "counters.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "framepump.h"
+#include "mp4.h"
+#include "sink.h"
+#include "source_clock.h"
+
+namespace framepump {
+
+// Writes the H.264 and the audio of the camera into segments of fragmented
+// MP4, as they come and without decoding them, so recording costs about as
+// much as copying the frames. A segment starts at a keyframe, has one
+// fragment per GOP and is cut at the first keyframe after its length, or
+// when the stream pauses. Old segments are removed by age and by the
+// total size of the directory when a new one starts.
+//
+// Every segment has an index next to it, with a line per fragment:
+//
+//     <FrameInfo timestamp> <wall clock ms> <byte offset of the moof>
+//
+// so a player seeks to a camera timestamp without parsing the file.
+//
+// The pump hands the frames over from its writer threads, which only copy
+// them into a ring. The muxing and the file I/O run on a thread of the
+// recorder, so a slow disk does not hold up the FIFOs or the publisher.
+// The space of a file is reserved up front, a fragment is written with
+// one call and the data is synced every sync_seconds instead of per write.
+// The frames in the ring hold blocks of the pool of the pump, so they count
+// against the memory budget of the camera.
+class Recorder {
+public:
+    Recorder(std::string directory, const fp_recorder_config &config, FramePool &pool,
+             Counters &counters);
+    ~Recorder();
+    Recorder(const Recorder &) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+
+    // Called from the video and the audio writer thread of the pump. The
+    // ring shares the block of a large frame instead of copying it.
+    void video_frame(const FrameSlot &frame, bool keyframe);
+    void audio_frame(const FrameSlot &frame);
+
+private:
+    void run();
+    void take_video(const FrameSlot &slot);
+    void take_audio(const FrameSlot &slot);
+    bool open_segment(const FrameSlot &keyframe, int64_t elapsed_ms);
+    void flush_fragment();
+    void close_segment();
+    bool write_all(int fd, const uint8_t *data, size_t size);
+    void remove_old_segments();
+
+    const std::string directory_;
+    const fp_recorder_config config_;
+    Counters &counters_;
+    std::atomic<bool> running_{true};
+    FrameRing video_ring_;
+    FrameRing audio_ring_;
+    // Only touched by the video writer thread
+    bool wait_for_keyframe_ = true;
+
+    // The rest belongs to the recorder thread
+    SourceClock source_clock_;
+    std::vector<uint8_t> sps_;
+    std::vector<uint8_t> pps_;
+    uint16_t audio_codec_ = 0;
+    aac::Config aac_config_;
+
+    int fd_ = -1;
+    int index_fd_ = -1;
+    uint64_t written_ = 0;
+    uint64_t reserve_bytes_;
+    int64_t segment_start_ms_ = 0;
+    uint32_t sequence_ = 0;
+    mp4::AudioTrack audio_track_;
+    std::chrono::steady_clock::time_point last_sync_{};
+
+    // The fragment being collected, the buffers are reused
+    std::vector<mp4::Sample> video_samples_;
+    std::vector<uint8_t> video_data_;
+    int64_t fragment_start_ms_ = 0;
+    uint32_t fragment_timestamp_ = 0;
+    int64_t last_video_ms_ = 0;
+    std::vector<mp4::Sample> audio_samples_;
+    std::vector<uint8_t> audio_data_;
+    uint64_t audio_base_time_ = 0;
+    uint64_t audio_time_ = 0;
+    bool audio_started_ = false;
+    std::vector<uint8_t> header_;
+
+    std::thread thread_;
+};
+
+}  // namespace framepump
@@ -0,0 +1,181 @@
+#include "rtp.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace framepump {
+
+namespace {
+
+constexpr size_t interleaved_header_size = 4;
+constexpr size_t rtp_header_size = 12;
+constexpr uint8_t nal_type_fu_a = 28;
+// AU-headers-length and one 16 bit AU-header of the AAC-hbr mode
+constexpr size_t aac_au_headers_size = 4;
+constexpr uint8_t rtcp_sender_report = 200;
+constexpr size_t rtcp_sender_report_size = 28;
+
+// Seconds between the NTP epoch (1900) and the Unix epoch (1970)
+constexpr uint64_t ntp_unix_offset = 2208988800ULL;
+
+void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+}  // namespace
+
+RtpStream::RtpStream(uint8_t channel, uint8_t payload_type, uint32_t ssrc)
+    : channel_(channel), payload_type_(payload_type), ssrc_(ssrc)
+{
+}
+
+uint8_t *RtpStream::add_packet(std::vector<uint8_t> &out, size_t payload_size,
+                               uint32_t timestamp, bool marker)
+{
+    size_t offset = out.size();
+    out.resize(offset + interleaved_header_size + rtp_header_size + payload_size);
+
+    uint8_t *p = out.data() + offset;
+    p[0] = '$';
+    p[1] = channel_;
+    put_u16(p + 2, static_cast<uint16_t>(rtp_header_size + payload_size));
+
+    uint8_t *rtp = p + interleaved_header_size;
+    rtp[0] = 0x80;  // Version 2, no padding, extension or CSRCs
+    rtp[1] = (marker ? 0x80 : 0x00) | payload_type_;
+    put_u16(rtp + 2, sequence_++);
+    put_u32(rtp + 4, timestamp);
+    put_u32(rtp + 8, ssrc_);
+
+    ++packets_;
+    octets_ += static_cast<uint32_t>(payload_size);
+    return rtp + rtp_header_size;
+}
+
+void RtpStream::sender_report(uint32_t timestamp, std::chrono::system_clock::time_point wall_time,
+                              std::vector<uint8_t> &out) const
+{
+    size_t offset = out.size();
+    out.resize(offset + interleaved_header_size + rtcp_sender_report_size);
+
+    uint8_t *p = out.data() + offset;
+    p[0] = '$';
+    p[1] = channel_ + 1;  // RTCP goes on the odd channel of the pair
+    put_u16(p + 2, rtcp_sender_report_size);
+
+    auto since_epoch = std::chrono::duration_cast<std::chrono::microseconds>(
+        wall_time.time_since_epoch()).count();
+    uint64_t seconds = static_cast<uint64_t>(since_epoch) / 1000000 + ntp_unix_offset;
+    uint64_t fraction = (static_cast<uint64_t>(since_epoch) % 1000000 << 32) / 1000000;
+
+    uint8_t *rtcp = p + interleaved_header_size;
+    rtcp[0] = 0x80;  // Version 2, no reception report blocks
+    rtcp[1] = rtcp_sender_report;
+    put_u16(rtcp + 2, rtcp_sender_report_size / 4 - 1);
+    put_u32(rtcp + 4, ssrc_);
+    put_u32(rtcp + 8, static_cast<uint32_t>(seconds));
+    put_u32(rtcp + 12, static_cast<uint32_t>(fraction));
+    put_u32(rtcp + 16, timestamp);
+    put_u32(rtcp + 20, packets_);
+    put_u32(rtcp + 24, octets_);
+}
+
+void RtpStream::packetize_h264(const std::vector<h264::NalUnit> &units, uint32_t timestamp,
+                               std::vector<uint8_t> &out)
+{
+    for (size_t i = 0; i < units.size(); ++i) {
+        const h264::NalUnit &unit = units[i];
+        bool last_unit = i + 1 == units.size();
+
+        if (unit.size <= max_payload_size) {
+            uint8_t *payload = add_packet(out, unit.size, timestamp, last_unit);
+            std::memcpy(payload, unit.data, unit.size);
+            continue;
+        }
+
+        // FU-A: the NAL header is replaced by the FU indicator and header,
+        // the payload is split over as many packets as needed
+        const uint8_t nal_header = unit.data[0];
+        const uint8_t *data = unit.data + 1;
+        size_t remaining = unit.size - 1;
+        bool first = true;
+        while (remaining > 0) {
+            size_t chunk = std::min(remaining, max_payload_size - 2);
+            bool end = chunk == remaining;
+
+            uint8_t *payload = add_packet(out, chunk + 2, timestamp, last_unit && end);
+            payload[0] = (nal_header & 0xe0) | nal_type_fu_a;
+            payload[1] = (first ? 0x80 : 0x00) | (end ? 0x40 : 0x00) | (nal_header & 0x1f);
+            std::memcpy(payload + 2, data, chunk);
+
+            data += chunk;
+            remaining -= chunk;
+            first = false;
+        }
+    }
+}
+
+void RtpStream::packetize_l16(const uint8_t *pcm, size_t size, uint32_t timestamp,
+                              std::vector<uint8_t> &out)
+{
+    size &= ~static_cast<size_t>(1);
+    while (size > 0) {
+        size_t chunk = std::min(size, max_payload_size);
+        uint8_t *payload = add_packet(out, chunk, timestamp, false);
+        for (size_t i = 0; i < chunk; i += 2) {
+            payload[i] = pcm[i + 1];
+            payload[i + 1] = pcm[i];
+        }
+        pcm += chunk;
+        size -= chunk;
+        timestamp += chunk / 2;
+    }
+}
+
+void RtpStream::packetize_g711(const uint8_t *samples, size_t size, uint32_t timestamp,
+                               std::vector<uint8_t> &out)
+{
+    while (size > 0) {
+        size_t chunk = std::min(size, max_payload_size);
+        uint8_t *payload = add_packet(out, chunk, timestamp, false);
+        std::memcpy(payload, samples, chunk);
+        samples += chunk;
+        size -= chunk;
+        timestamp += chunk;
+    }
+}
+
+void RtpStream::packetize_aac(const std::vector<aac::Frame> &frames, uint32_t timestamp,
+                              std::vector<uint8_t> &out)
+{
+    for (const aac::Frame &frame : frames) {
+        // Every fragment repeats the AU-header with the size of the whole frame
+        const uint8_t *data = frame.data;
+        size_t remaining = frame.size;
+        while (remaining > 0) {
+            size_t chunk = std::min(remaining, max_payload_size - aac_au_headers_size);
+            bool end = chunk == remaining;
+
+            uint8_t *payload = add_packet(out, aac_au_headers_size + chunk, timestamp, end);
+            put_u16(payload, 16);  // Length of the AU-headers in bits
+            put_u16(payload + 2, static_cast<uint16_t>(frame.size << 3));  // 13 bits size, index 0
+            std::memcpy(payload + aac_au_headers_size, data, chunk);
+
+            data += chunk;
+            remaining -= chunk;
+        }
+        timestamp += aac::samples_per_frame;
+    }
+}
+
+}  // namespace framepump
@@ -0,0 +1,71 @@
+// RTP packetization for the RTSP publisher.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aac.h"
+#include "h264.h"
+
+namespace framepump {
+
+// One RTP stream of an RTSP session that is interleaved on the TCP
+// connection. Every packet is appended to the output buffer together with
+// its interleaved frame header ($, channel, length), so a whole frame goes
+// out with a single send().
+class RtpStream {
+public:
+    // Payloads are kept below the mediamtx udpMaxPayloadSize, so the server
+    // can forward the packets to UDP readers unchanged.
+    static constexpr size_t max_payload_size = 1400;
+
+    RtpStream(uint8_t channel, uint8_t payload_type, uint32_t ssrc);
+
+    // Packetizes one access unit as described in RFC 6184, with single NAL
+    // unit packets and FU-A fragments. The marker bit is set on the last one.
+    void packetize_h264(const std::vector<h264::NalUnit> &units, uint32_t timestamp,
+                        std::vector<uint8_t> &out);
+
+    // Packetizes little endian 16 bit PCM as L16 (RFC 3551), which is big
+    // endian on the wire.
+    void packetize_l16(const uint8_t *pcm, size_t size, uint32_t timestamp,
+                       std::vector<uint8_t> &out);
+
+    // Packetizes G.711 (RFC 3551), one byte per sample, as it is.
+    void packetize_g711(const uint8_t *samples, size_t size, uint32_t timestamp,
+                        std::vector<uint8_t> &out);
+
+    // Packetizes raw AAC frames as mpeg4-generic in the AAC-hbr mode of
+    // RFC 3640, one frame per packet and fragmented if it does not fit.
+    // Every frame advances the timestamp by aac::samples_per_frame.
+    void packetize_aac(const std::vector<aac::Frame> &frames, uint32_t timestamp,
+                       std::vector<uint8_t> &out);
+
+    // Appends an RTCP sender report, which tells readers which wall clock
+    // time the RTP timestamp corresponds to so they can sync the tracks.
+    void sender_report(uint32_t timestamp, std::chrono::system_clock::time_point wall_time,
+                       std::vector<uint8_t> &out) const;
+
+    // The payload type depends on the audio codec, set it before the
+    // first packet of a session.
+    void set_payload_type(uint8_t payload_type) { payload_type_ = payload_type; }
+
+    uint8_t channel() const { return channel_; }
+    uint32_t packets() const { return packets_; }
+
+private:
+    // Appends the headers of a packet and returns where its payload goes.
+    uint8_t *add_packet(std::vector<uint8_t> &out, size_t payload_size, uint32_t timestamp,
+                        bool marker);
+
+    const uint8_t channel_;
+    uint8_t payload_type_;
+    const uint32_t ssrc_;
+    uint16_t sequence_ = 0;
+    uint32_t packets_ = 0;
+    uint32_t octets_ = 0;
+};
+
+}  // namespace framepump
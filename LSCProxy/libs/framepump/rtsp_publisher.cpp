@@ -0,0 +1,521 @@
+#include "rtsp_publisher.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+constexpr uint8_t video_payload_type = 96;
+constexpr uint8_t audio_payload_type = 97;
+// Static payload types of RFC 3551
+constexpr uint8_t pcmu_payload_type = 0;
+constexpr uint8_t pcma_payload_type = 8;
+constexpr uint32_t video_clock_rate = 90000;
+constexpr uint32_t pcm_clock_rate = 8000;
+// How long the first setup waits for the audio codec, without audio the
+// session is announced with L16
+constexpr auto audio_probe_timeout = std::chrono::seconds(5);
+constexpr auto reconnect_interval = std::chrono::seconds(1);
+// A new session is only started from a keyframe this recent, so the cached
+// frames stay within the jitter the SourceClock accepts
+constexpr auto max_gop_age = std::chrono::seconds(4);
+constexpr auto sender_report_interval = std::chrono::seconds(5);
+constexpr int socket_timeout_s = 5;
+
+uint32_t random_ssrc()
+{
+    static std::mt19937 generator{std::random_device{}()};
+    return static_cast<uint32_t>(generator());
+}
+
+uint8_t payload_type(uint16_t audio_codec)
+{
+    switch (audio_codec) {
+    case MEDIA_CODEC_AUDIO_G711U:
+        return pcmu_payload_type;
+    case MEDIA_CODEC_AUDIO_G711A:
+        return pcma_payload_type;
+    default:
+        return audio_payload_type;
+    }
+}
+
+std::string lowercase(std::string s)
+{
+    for (char &c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+}  // namespace
+
+RtspPublisher::RtspPublisher(std::string url, Counters &counters,
+                             const KeyframeCache &keyframe_cache)
+    : url_(std::move(url)),
+      counters_(counters),
+      keyframe_cache_(keyframe_cache),
+      video_stream_(0, video_payload_type, random_ssrc()),
+      audio_stream_(2, audio_payload_type, random_ssrc())
+{
+    if (!parse_url()) {
+        print("[publisher] Invalid RTSP URL %s\n", url_.c_str());
+    }
+}
+
+RtspPublisher::~RtspPublisher()
+{
+    disconnect();
+}
+
+bool RtspPublisher::parse_url()
+{
+    const std::string scheme = "rtsp://";
+    if (url_.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+    std::string authority = url_.substr(scheme.size(), url_.find('/', scheme.size()) - scheme.size());
+    size_t colon = authority.rfind(':');
+    if (colon == std::string::npos) {
+        host_ = authority;
+        port_ = "554";
+    } else {
+        host_ = authority.substr(0, colon);
+        port_ = authority.substr(colon + 1);
+    }
+    return !host_.empty();
+}
+
+void RtspPublisher::video_frame(const Frame &frame)
+{
+    std::vector<h264::NalUnit> units = h264::split(frame.data, frame.size);
+    bool keyframe = (frame.info.flags & IPC_FRAME_FLAG_IFRAME) != 0;
+    for (const h264::NalUnit &unit : units) {
+        if (unit.type() == h264::nal_sps) {
+            sps_.assign(unit.data, unit.data + unit.size);
+        } else if (unit.type() == h264::nal_pps) {
+            pps_.assign(unit.data, unit.data + unit.size);
+        } else if (unit.type() == h264::nal_idr) {
+            keyframe = true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t elapsed_ms = source_clock_.elapsed_ms(frame.info.timestamp);
+    if (socket_ < 0) {
+        if (sps_.empty() || pps_.empty() || interrupted_ || standby_ ||
+            std::chrono::steady_clock::now() - last_attempt_ < reconnect_interval) {
+            return;
+        }
+        // Readers can only start decoding at a keyframe. Within a GOP the
+        // session starts with the cached frames, the last one is this frame.
+        gop_.clear();
+        if (!keyframe && (keyframe_cache_.copy(gop_, max_gop_age) == 0 ||
+                          gop_.back().info.timestamp != frame.info.timestamp ||
+                          gop_.back().size != frame.size)) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (audio_codec_ == 0) {
+            if (first_keyframe_ == std::chrono::steady_clock::time_point{}) {
+                first_keyframe_ = now;
+            }
+            if (now - first_keyframe_ < audio_probe_timeout) {
+                return;
+            }
+        }
+        last_attempt_ = now;
+        if (!connect()) {
+            disconnect();
+            return;
+        }
+        if (!gop_.empty()) {
+            print("[publisher] Starting with %zu cached frames\n", gop_.size() - 1);
+        }
+        for (size_t i = 0; i + 1 < gop_.size() && socket_ >= 0; ++i) {
+            send_video(h264::split(gop_[i].data.data(), gop_[i].size),
+                       source_clock_.elapsed_ms(gop_[i].info.timestamp));
+        }
+        // The cache shared its blocks, they go back to the pool
+        gop_.clear();
+        if (socket_ < 0) {
+            return;
+        }
+    }
+
+    send_video(units, elapsed_ms);
+}
+
+void RtspPublisher::send_video(const std::vector<h264::NalUnit> &units, int64_t elapsed_ms)
+{
+    video_elapsed_ms_ = elapsed_ms;
+    uint32_t timestamp = SourceClock::to_rtp(elapsed_ms, video_clock_rate);
+    uint32_t packets_before = video_stream_.packets();
+    video_packets_.clear();
+    video_stream_.packetize_h264(units, timestamp, video_packets_);
+    add_sender_report(video_stream_, timestamp, elapsed_ms, video_report_, video_packets_);
+    send_packets(video_packets_, video_stream_, packets_before);
+}
+
+void RtspPublisher::audio_frame(const Frame &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t elapsed_ms = source_clock_.elapsed_ms(frame.info.timestamp);
+    if (frame.info.codec_id != audio_codec_) {
+        audio_codec_ = frame.info.codec_id;
+        if (audio_codec_ == MEDIA_CODEC_AUDIO_AAC) {
+            aac::split(frame.data, frame.size, &aac_config_);
+        }
+        if (announce_codec() != audio_codec_) {
+            print("[publisher] Unsupported audio codec 0x%02x, sending it as L16\n",
+                  audio_codec_);
+        }
+    }
+    if (socket_ < 0) {
+        return;
+    }
+    if (announce_codec() != announced_codec_) {
+        // The SDP no longer matches, announce again at the next keyframe
+        print("[publisher] Audio codec changed to 0x%02x\n", audio_codec_);
+        disconnect();
+        return;
+    }
+
+    uint32_t timestamp = SourceClock::to_rtp(elapsed_ms, audio_clock_rate());
+    uint32_t packets_before = audio_stream_.packets();
+    audio_packets_.clear();
+    switch (announced_codec_) {
+    case MEDIA_CODEC_AUDIO_G711U:
+    case MEDIA_CODEC_AUDIO_G711A:
+        audio_stream_.packetize_g711(frame.data, frame.size, timestamp, audio_packets_);
+        break;
+    case MEDIA_CODEC_AUDIO_AAC:
+        audio_stream_.packetize_aac(aac::split(frame.data, frame.size, nullptr), timestamp,
+                                    audio_packets_);
+        break;
+    default:
+        audio_stream_.packetize_l16(frame.data, frame.size, timestamp, audio_packets_);
+        break;
+    }
+    add_sender_report(audio_stream_, timestamp, elapsed_ms, audio_report_, audio_packets_);
+    send_packets(audio_packets_, audio_stream_, packets_before);
+}
+
+void RtspPublisher::interrupt()
+{
+    interrupted_ = true;
+    int fd = socket_;
+    if (fd >= 0) {
+        // Wakes up a send() or recv() that is blocked on a stalled server
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void RtspPublisher::keepalive()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socket_ < 0) {
+        return;
+    }
+
+    // The server drops a publisher that sends nothing for its read timeout.
+    // A sender report for the last video frame is valid RTCP and changes
+    // nothing for the readers.
+    video_packets_.clear();
+    auto wall_time = source_clock_.origin_wall_time() + std::chrono::milliseconds(video_elapsed_ms_);
+    video_stream_.sender_report(SourceClock::to_rtp(video_elapsed_ms_, video_clock_rate), wall_time,
+                                video_packets_);
+    send_packets(video_packets_, video_stream_, video_stream_.packets());
+}
+
+void RtspPublisher::set_standby(bool standby)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    standby_ = standby;
+    if (standby && socket_ >= 0) {
+        print("[publisher] Standby, closing the session of %s\n", url_.c_str());
+        disconnect();
+    }
+}
+
+void RtspPublisher::add_sender_report(const RtpStream &stream, uint32_t timestamp,
+                                      int64_t elapsed_ms,
+                                      std::chrono::steady_clock::time_point &last_report,
+                                      std::vector<uint8_t> &packets)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report < sender_report_interval) {
+        return;
+    }
+    last_report = now;
+
+    // Both tracks report against the camera clock, which is what lines them up
+    auto wall_time = source_clock_.origin_wall_time() + std::chrono::milliseconds(elapsed_ms);
+    stream.sender_report(timestamp, wall_time, packets);
+}
+
+void RtspPublisher::send_packets(std::vector<uint8_t> &packets, const RtpStream &stream,
+                                 uint32_t packets_before)
+{
+    if (!send_all(packets.data(), packets.size())) {
+        print("[publisher] Connection to %s lost\n", url_.c_str());
+        disconnect();
+        return;
+    }
+    counters_.rtp_packets += stream.packets() - packets_before;
+    counters_.rtp_bytes += packets.size();
+
+    // Discard the RTCP receiver reports the server sends back, so they do
+    // not pile up in the socket buffer
+    uint8_t discard[2048];
+    while (true) {
+        ssize_t n = recv(socket_, discard, sizeof(discard), MSG_DONTWAIT);
+        if (n > 0) {
+            continue;
+        }
+        if (n == 0) {
+            print("[publisher] %s closed the connection\n", url_.c_str());
+            disconnect();
+        }
+        break;
+    }
+}
+
+bool RtspPublisher::send_all(const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = send(socket_, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool RtspPublisher::request(const std::string &method, const std::string &url,
+                            const std::string &headers, const std::string &body,
+                            Response &response)
+{
+    std::string message = method + " " + url + " RTSP/1.0\r\n" +
+                          "CSeq: " + std::to_string(++cseq_) + "\r\n" +
+                          "User-Agent: LSCProxy\r\n";
+    if (!session_.empty()) {
+        message += "Session: " + session_ + "\r\n";
+    }
+    message += headers;
+    if (!body.empty()) {
+        message += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    message += "\r\n" + body;
+
+    if (!send_all(reinterpret_cast<const uint8_t *>(message.data()), message.size())) {
+        return false;
+    }
+
+    std::string reply;
+    size_t header_end;
+    while ((header_end = reply.find("\r\n\r\n")) == std::string::npos) {
+        char buf[1024];
+        ssize_t n = recv(socket_, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        reply.append(buf, n);
+    }
+
+    response = Response{};
+    if (std::sscanf(reply.c_str(), "RTSP/1.0 %d", &response.status) != 1) {
+        return false;
+    }
+    size_t line_start = reply.find("\r\n") + 2;
+    while (line_start < header_end) {
+        size_t line_end = reply.find("\r\n", line_start);
+        std::string line = reply.substr(line_start, line_end - line_start);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            response.headers[lowercase(line.substr(0, colon))] =
+                value == std::string::npos ? "" : line.substr(value);
+        }
+        line_start = line_end + 2;
+    }
+
+    // None of the replies we expect has a body worth reading, but skip it
+    // so it is not mistaken for the next reply
+    auto length = response.headers.find("content-length");
+    if (length != response.headers.end()) {
+        size_t remaining = std::strtoul(length->second.c_str(), nullptr, 10);
+        size_t buffered = reply.size() - header_end - 4;
+        remaining -= std::min(remaining, buffered);
+        while (remaining > 0) {
+            char buf[1024];
+            ssize_t n = recv(socket_, buf, std::min(remaining, sizeof(buf)), 0);
+            if (n <= 0) {
+                return false;
+            }
+            remaining -= static_cast<size_t>(n);
+        }
+    }
+
+    if (response.status != 200) {
+        print("[publisher] %s %s failed with status %d\n", method.c_str(), url.c_str(),
+              response.status);
+        return false;
+    }
+    return true;
+}
+
+std::string RtspPublisher::sdp() const
+{
+    return "v=0\r\n"
+           "o=- 0 0 IN IP4 127.0.0.1\r\n"
+           "s=LSCProxy\r\n"
+           "c=IN IP4 0.0.0.0\r\n"
+           "t=0 0\r\n"
+           "m=video 0 RTP/AVP " + std::to_string(video_payload_type) + "\r\n" +
+           "a=rtpmap:" + std::to_string(video_payload_type) + " H264/90000\r\n" +
+           "a=fmtp:" + std::to_string(video_payload_type) + " packetization-mode=1;" +
+           "profile-level-id=" + h264::profile_level_id(sps_) + ";" +
+           "sprop-parameter-sets=" + h264::sprop_parameter_sets(sps_, pps_) + "\r\n" +
+           "a=control:trackID=0\r\n" +
+           audio_sdp() +
+           "a=control:trackID=1\r\n";
+}
+
+std::string RtspPublisher::audio_sdp() const
+{
+    const std::string pt = std::to_string(audio_payload_type);
+    switch (announced_codec_) {
+    case MEDIA_CODEC_AUDIO_G711U:
+        return "m=audio 0 RTP/AVP " + std::to_string(pcmu_payload_type) + "\r\n" +
+               "a=rtpmap:" + std::to_string(pcmu_payload_type) + " PCMU/8000\r\n";
+    case MEDIA_CODEC_AUDIO_G711A:
+        return "m=audio 0 RTP/AVP " + std::to_string(pcma_payload_type) + "\r\n" +
+               "a=rtpmap:" + std::to_string(pcma_payload_type) + " PCMA/8000\r\n";
+    case MEDIA_CODEC_AUDIO_AAC:
+        return "m=audio 0 RTP/AVP " + pt + "\r\n" +
+               "a=rtpmap:" + pt + " mpeg4-generic/" + std::to_string(audio_clock_rate()) + "/" +
+               std::to_string(aac_config_.channels) + "\r\n" +
+               "a=fmtp:" + pt + " streamtype=5;profile-level-id=1;mode=AAC-hbr;" +
+               "sizelength=13;indexlength=3;indexdeltalength=3;" +
+               "config=" + aac_config_.audio_specific_config() + "\r\n";
+    default:
+        return "m=audio 0 RTP/AVP " + pt + "\r\n" +
+               "a=rtpmap:" + pt + " L16/8000/1\r\n";
+    }
+}
+
+// The codec the audio can be announced with, L16 for the unsupported ones
+uint16_t RtspPublisher::announce_codec() const
+{
+    switch (audio_codec_) {
+    case MEDIA_CODEC_AUDIO_G711U:
+    case MEDIA_CODEC_AUDIO_G711A:
+        return audio_codec_;
+    case MEDIA_CODEC_AUDIO_AAC:
+        return aac_config_.valid() && aac_config_.sample_rate() != 0 ? audio_codec_
+                                                                       : MEDIA_CODEC_AUDIO_PCM;
+    default:
+        return MEDIA_CODEC_AUDIO_PCM;
+    }
+}
+
+uint32_t RtspPublisher::audio_clock_rate() const
+{
+    return announced_codec_ == MEDIA_CODEC_AUDIO_AAC ? aac_config_.sample_rate() : pcm_clock_rate;
+}
+
+bool RtspPublisher::connect()
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses) != 0) {
+        print("[publisher] Cannot resolve %s\n", host_.c_str());
+        return false;
+    }
+
+    int fd = -1;
+    for (addrinfo *address = addresses; address != nullptr; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) {
+        print("[publisher] Cannot connect to %s:%s\n", host_.c_str(), port_.c_str());
+        return false;
+    }
+
+    timeval timeout{socket_timeout_s, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    socket_ = fd;
+
+    announced_codec_ = announce_codec();
+    audio_stream_.set_payload_type(payload_type(announced_codec_));
+
+    Response response;
+    if (!request("ANNOUNCE", url_, "Content-Type: application/sdp\r\n", sdp(), response)) {
+        return false;
+    }
+    if (!request("SETUP", url_ + "/trackID=0",
+                 "Transport: RTP/AVP/TCP;unicast;interleaved=0-1;mode=record\r\n", "", response)) {
+        return false;
+    }
+    session_ = response.headers["session"].substr(0, response.headers["session"].find(';'));
+    if (!request("SETUP", url_ + "/trackID=1",
+                 "Transport: RTP/AVP/TCP;unicast;interleaved=2-3;mode=record\r\n", "", response)) {
+        return false;
+    }
+    if (!request("RECORD", url_, "Range: npt=0.000-\r\n", "", response)) {
+        return false;
+    }
+
+    ++counters_.publisher_connects;
+    print("[publisher] Publishing to %s\n", url_.c_str());
+    return true;
+}
+
+void RtspPublisher::disconnect()
+{
+    int fd = socket_.exchange(-1);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    session_.clear();
+    cseq_ = 0;
+}
+
+}  // namespace framepump
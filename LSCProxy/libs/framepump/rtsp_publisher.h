@@ -0,0 +1,108 @@
+// Sink that publishes the frames to an RTSP server such as mediamtx.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "aac.h"
+#include "counters.h"
+#include "frame_ring.h"
+#include "keyframe_cache.h"
+#include "rtp.h"
+#include "sink.h"
+#include "source_clock.h"
+
+namespace framepump {
+
+// Announces a session with an H.264 and an audio track, records to it and
+// sends the RTP packets interleaved on the RTSP connection. This replaces
+// the FIFOs and the ffmpeg process between the camera and the server.
+//
+// The session is set up on the first keyframe, since the SDP needs the SPS
+// and PPS, and again whenever the connection to the server is lost. A
+// later session can start at any frame: it sends the keyframe and the rest
+// of the GOP from the KeyframeCache first, so its readers get a picture
+// right away instead of waiting for the next keyframe. The audio goes out
+// in the codec the camera encodes it in, which the SDP also needs, so the
+// first setup waits a moment for an audio frame. G.711 and AAC are sent as
+// they are, PCM as L16. RTP timestamps come from the camera's FrameInfo
+// timestamps, so the output is paced by the source and not by the host.
+// While the camera reconnects, sender reports keep the session open so
+// readers stay attached until the frames come back. In standby there is no
+// session, so a server with on demand publishing asks for the stream.
+class RtspPublisher : public Sink {
+public:
+    RtspPublisher(std::string url, Counters &counters, const KeyframeCache &keyframe_cache);
+    ~RtspPublisher() override;
+
+    void video_frame(const Frame &frame) override;
+    void audio_frame(const Frame &frame) override;
+    void interrupt() override;
+    void keepalive() override;
+    void set_standby(bool standby) override;
+
+private:
+    struct Response {
+        int status = 0;
+        std::map<std::string, std::string> headers;
+    };
+
+    bool parse_url();
+    bool connect();
+    void disconnect();
+    bool request(const std::string &method, const std::string &url,
+                 const std::string &headers, const std::string &body, Response &response);
+    bool send_all(const uint8_t *data, size_t size);
+    void send_video(const std::vector<h264::NalUnit> &units, int64_t elapsed_ms);
+    void send_packets(std::vector<uint8_t> &packets, const RtpStream &stream,
+                      uint32_t packets_before);
+    std::string sdp() const;
+    std::string audio_sdp() const;
+    uint16_t announce_codec() const;
+    uint32_t audio_clock_rate() const;
+    void add_sender_report(const RtpStream &stream, uint32_t timestamp, int64_t elapsed_ms,
+                           std::chrono::steady_clock::time_point &last_report,
+                           std::vector<uint8_t> &packets);
+
+    const std::string url_;
+    Counters &counters_;
+    const KeyframeCache &keyframe_cache_;
+    std::string host_;
+    std::string port_;
+
+    // mutex_ guards the connection, the RTP streams and buffers are only
+    // touched by the thread of their own media type
+    std::mutex mutex_;
+    std::atomic<int> socket_{-1};
+    std::atomic<bool> interrupted_{false};
+    bool standby_ = false;
+    int cseq_ = 0;
+    std::string session_;
+    std::chrono::steady_clock::time_point last_attempt_{};
+    std::vector<uint8_t> sps_;
+    std::vector<uint8_t> pps_;
+    // codec_id of the last audio frame, 0 before the first, and the codec
+    // the session was announced with
+    uint16_t audio_codec_ = 0;
+    uint16_t announced_codec_ = 0;
+    aac::Config aac_config_;
+    std::chrono::steady_clock::time_point first_keyframe_{};
+
+    SourceClock source_clock_;
+    RtpStream video_stream_;
+    RtpStream audio_stream_;
+    int64_t video_elapsed_ms_ = 0;
+    std::chrono::steady_clock::time_point video_report_{};
+    std::chrono::steady_clock::time_point audio_report_{};
+    std::vector<uint8_t> video_packets_;
+    std::vector<uint8_t> audio_packets_;
+    // Copy of the KeyframeCache a new session starts with
+    std::vector<FrameSlot> gop_;
+};
+
+}  // namespace framepump
@@ -0,0 +1,40 @@
+// Consumer of the frames received by the pump.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tutk_api.h"
+
+namespace framepump {
+
+struct Frame {
+    const uint8_t *data;
+    size_t size;
+    FrameInfo info;
+};
+
+class Sink {
+public:
+    virtual ~Sink() = default;
+
+    // Called from the video and the audio receive thread respectively, so an
+    // implementation that shares state between the two must lock it. The
+    // frame data is only valid for the duration of the call.
+    virtual void video_frame(const Frame &frame) = 0;
+    virtual void audio_frame(const Frame &frame) = 0;
+
+    // Called by Pump::stop() after the receive threads have been told to
+    // exit, to unblock a thread that waits inside the sink.
+    virtual void interrupt() {}
+
+    // Called about once a second while the session is lost and no frames
+    // arrive, to keep the connections of the sink from timing out.
+    virtual void keepalive() {}
+
+    // Called with true while no one reads the stream. The sink then lets its
+    // connections go and ignores the frames until it is called with false.
+    virtual void set_standby(bool /*standby*/) {}
+};
+
+}  // namespace framepump
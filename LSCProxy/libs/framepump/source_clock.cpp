@@ -0,0 +1,40 @@
+#include "source_clock.h"
+
+#include <cstdlib>
+
+namespace framepump {
+
+namespace {
+
+// Largest difference between the camera clock and the receive clock that
+// is still taken as network jitter rather than as a jump of the camera clock
+constexpr int64_t max_drift_ms = 5000;
+
+}  // namespace
+
+int64_t SourceClock::elapsed_ms(uint32_t camera_timestamp_ms)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!started_) {
+        started_ = true;
+        origin_ms_ = camera_timestamp_ms;
+        origin_steady_ = now;
+        origin_wall_ = std::chrono::system_clock::now();
+    }
+
+    int64_t received_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - origin_steady_).count();
+    if (camera_timestamp_ms == 0) {
+        return received_ms;
+    }
+
+    // Signed difference, so the 32 bit camera timestamp may wrap around
+    int64_t camera_ms = static_cast<int32_t>(camera_timestamp_ms - origin_ms_);
+    if (std::llabs(camera_ms - received_ms) > max_drift_ms) {
+        origin_ms_ = camera_timestamp_ms - static_cast<uint32_t>(received_ms);
+        camera_ms = received_ms;
+    }
+    return camera_ms;
+}
+
+}  // namespace framepump
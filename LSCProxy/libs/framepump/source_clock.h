@@ -0,0 +1,38 @@
+// Maps the camera's FrameInfo timestamps onto the RTP clocks.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace framepump {
+
+// The camera stamps every frame with a millisecond timestamp. Video and
+// audio share one origin, so the RTP timestamps of both tracks come from
+// the same source clock and stay in sync however the frames arrive.
+//
+// When the camera does not fill in timestamps, or its clock jumps (e.g.
+// after it restarted the stream), the receive time is used to keep the
+// timeline continuous. Not thread safe.
+class SourceClock {
+public:
+    // Returns the time of the frame in milliseconds since the origin. This
+    // is negative for a frame of the other track stamped before the origin.
+    int64_t elapsed_ms(uint32_t camera_timestamp_ms);
+
+    // Wall clock time at the origin, for RTCP sender reports.
+    std::chrono::system_clock::time_point origin_wall_time() const { return origin_wall_; }
+
+    // RTP timestamps are modulo 2^32, which also covers negative times
+    static uint32_t to_rtp(int64_t elapsed_ms, uint32_t clock_rate)
+    {
+        return static_cast<uint32_t>(elapsed_ms * clock_rate / 1000);
+    }
+
+private:
+    bool started_ = false;
+    uint32_t origin_ms_ = 0;
+    std::chrono::steady_clock::time_point origin_steady_{};
+    std::chrono::system_clock::time_point origin_wall_{};
+};
+
+}  // namespace framepump
@@ -0,0 +1,46 @@
+#include "tutk_api.h"
+
+#include <dlfcn.h>
+
+#include "log.h"
+
+namespace framepump {
+
+namespace {
+
+template <typename Fn>
+bool resolve(void *handle, const char *name, Fn &out)
+{
+    out = reinterpret_cast<Fn>(dlsym(handle, name));
+    if (out == nullptr) {
+        print("[framepump] Cannot resolve %s: %s\n", name, dlerror());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+TutkApi::~TutkApi()
+{
+    if (handle_ != nullptr) {
+        dlclose(handle_);
+    }
+}
+
+bool TutkApi::load(const char *path)
+{
+    // tutk.py has normally loaded the library already, in which case this
+    // only bumps the reference count and shares the SDK's global state.
+    handle_ = dlopen(path, RTLD_LAZY);
+    if (handle_ == nullptr) {
+        print("[framepump] Cannot open %s: %s\n", path, dlerror());
+        return false;
+    }
+
+    return resolve(handle_, "avRecvFrameData2", recv_frame_data2) &&
+           resolve(handle_, "avRecvAudioData", recv_audio_data) &&
+           resolve(handle_, "avCheckAudioBuf", check_audio_buf);
+}
+
+}  // namespace framepump
@@ -0,0 +1,71 @@
+// Dynamically resolved subset of the TUTK AVAPIs used by the frame pump.
+//
+// The SDK ships as a prebuilt libIOTCAPIs_ALL.so that tutk.py already loads
+// through ctypes. The pump resolves the receive calls from the same library
+// at runtime instead of linking against it, so one build works with whatever
+// SDK copy sits in libs/<arch>/.
+#pragma once
+
+#include <cstdint>
+
+namespace framepump {
+
+// Mirrors FRAMEINFO_t (FrameInfoT in tutk.py).
+struct FrameInfo {
+    uint16_t codec_id;
+    uint8_t flags;
+    uint8_t cam_index;
+    uint8_t online_num;
+    char reserve1[3];
+    uint32_t reserve2;
+    uint32_t timestamp;
+    uint32_t video_width;
+    uint32_t video_height;
+};
+
+// FrameInfo::flags bit of frames that start a GOP.
+constexpr uint8_t IPC_FRAME_FLAG_IFRAME = 0x01;
+
+// FrameInfo::codec_id of the audio codecs, see audio_codec in constants.py.
+constexpr uint16_t MEDIA_CODEC_AUDIO_AAC = 0x88;  // ADTS
+constexpr uint16_t MEDIA_CODEC_AUDIO_G711U = 0x89;
+constexpr uint16_t MEDIA_CODEC_AUDIO_G711A = 0x8A;
+constexpr uint16_t MEDIA_CODEC_AUDIO_PCM = 0x8C;  // 16 bit little endian, 8 kHz mono
+
+// Error codes, see av_error / iotc_error in constants.py.
+constexpr int AV_ER_BUFPARA_MAXSIZE_INSUFF = -20009;
+constexpr int AV_ER_DATA_NOREADY = -20012;
+constexpr int AV_ER_LOSED_THIS_FRAME = -20014;
+constexpr int AV_ER_SESSION_CLOSE_BY_REMOTE = -20015;
+constexpr int AV_ER_REMOTE_TIMEOUT_DISCONNECT = -20016;
+constexpr int IOTC_ER_INVALID_SID = -14;
+
+class TutkApi {
+public:
+    using RecvFrameData2Fn = int (*)(int av_index, char *frame_data, int frame_data_max_size,
+                                     int *actual_frame_size, int *expected_frame_size,
+                                     char *frame_info, int frame_info_max_size,
+                                     int *actual_frame_info_size, unsigned int *frame_index);
+    using RecvAudioDataFn = int (*)(int av_index, char *audio_data, int audio_data_max_size,
+                                    char *frame_info, int frame_info_max_size,
+                                    unsigned int *frame_index);
+    using CheckAudioBufFn = int (*)(int av_index);
+
+    TutkApi() = default;
+    ~TutkApi();
+    TutkApi(const TutkApi &) = delete;
+    TutkApi &operator=(const TutkApi &) = delete;
+
+    // Opens the SDK at path and resolves every symbol. Returns false and
+    // prints the dlerror() message if anything is missing.
+    bool load(const char *path);
+
+    RecvFrameData2Fn recv_frame_data2 = nullptr;
+    RecvAudioDataFn recv_audio_data = nullptr;
+    CheckAudioBufFn check_audio_buf = nullptr;
+
+private:
+    void *handle_ = nullptr;
+};
+
+}  // namespace framepump
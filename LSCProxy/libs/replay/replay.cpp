@@ -0,0 +1,273 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "../framepump/tutk_api.h"
+
+namespace replay {
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+using framepump::FrameInfo;
+
+constexpr char capture_magic[8] = {'L', 'S', 'C', 'C', 'A', 'P', '0', '1'};
+constexpr uint8_t kind_video = 0;
+constexpr uint8_t kind_audio = 1;
+
+constexpr int AV_ER_BUFPARA_MAXSIZE_INSUFF = -20009;
+
+// avCheckAudioBuf counts no further, at full speed every frame is due
+constexpr int max_buffered_audio = 1000;
+
+#pragma pack(push, 1)
+struct RecordHeader {
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint32_t size;
+    uint64_t received_us;
+    FrameInfo info;
+};
+#pragma pack(pop)
+static_assert(sizeof(RecordHeader) == 40, "RecordHeader must match CaptureWriter in bench.py");
+
+struct Frame {
+    // When the frame was received, from the first frame of the capture
+    int64_t received_us;
+    FrameInfo info;
+    std::vector<char> data;
+};
+
+// One stream of the capture, read by the receive thread of its media type
+struct Track {
+    std::vector<Frame> frames;
+    std::atomic<size_t> next{0};
+    unsigned int index = 0;
+
+    bool finished() const { return next >= frames.size(); }
+};
+
+Track video;
+Track audio;
+std::atomic<bool> playing{false};
+
+// Frames are due at base_time + (received_us - base_received_us) / speed.
+// Changing the speed moves the base to the next frame.
+std::mutex pace_mutex;
+double speed = 1.0;
+clock::time_point base_time{};
+int64_t base_received_us = 0;
+
+std::mutex times_mutex;
+std::vector<int64_t> video_times;
+
+int64_t monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               clock::now().time_since_epoch())
+        .count();
+}
+
+bool due(const Frame &frame)
+{
+    std::lock_guard<std::mutex> lock(pace_mutex);
+    if (speed <= 0) {
+        return true;
+    }
+    auto due_time = base_time + std::chrono::microseconds(static_cast<int64_t>(
+                                    (frame.received_us - base_received_us) / speed));
+    return due_time <= clock::now();
+}
+
+// Received time of the next frame of either track
+int64_t next_received_us()
+{
+    int64_t next_us = INT64_MAX;
+    for (const Track *track : {&video, &audio}) {
+        size_t next = track->next;
+        if (next < track->frames.size()) {
+            next_us = std::min(next_us, track->frames[next].received_us);
+        }
+    }
+    return next_us == INT64_MAX ? 0 : next_us;
+}
+
+// Once both tracks are played out the session ends like a camera that hung up
+bool session_over()
+{
+    return !playing || (video.finished() && audio.finished());
+}
+
+void copy_info(const Frame &frame, char *frame_info, int frame_info_max_size)
+{
+    if (frame_info != nullptr && frame_info_max_size > 0) {
+        std::memcpy(frame_info, &frame.info,
+                    std::min(sizeof(frame.info), static_cast<size_t>(frame_info_max_size)));
+    }
+}
+
+}  // namespace
+
+}  // namespace replay
+
+using namespace replay;
+
+extern "C" {
+
+int replay_open(const char *path)
+{
+    std::FILE *file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    char magic[sizeof(capture_magic)];
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, capture_magic, sizeof(magic)) != 0) {
+        std::fclose(file);
+        return -1;
+    }
+
+    RecordHeader header;
+    while (std::fread(&header, sizeof(header), 1, file) == 1) {
+        Track &track = header.kind == kind_video ? video : audio;
+        Frame frame{static_cast<int64_t>(header.received_us), header.info,
+                    std::vector<char>(header.size)};
+        if (std::fread(frame.data.data(), 1, header.size, file) != header.size) {
+            break;
+        }
+        if (header.kind == kind_video || header.kind == kind_audio) {
+            track.frames.push_back(std::move(frame));
+        }
+    }
+    std::fclose(file);
+
+    // The capture starts when the first frame arrived, not when the session did
+    base_received_us = next_received_us();
+    return static_cast<int>(video.frames.size() + audio.frames.size());
+}
+
+void replay_set_speed(double playback_speed)
+{
+    int64_t received_us = next_received_us();
+    std::lock_guard<std::mutex> lock(pace_mutex);
+    speed = playback_speed;
+    base_time = clock::now();
+    base_received_us = received_us;
+}
+
+int replay_done(void)
+{
+    return video.finished() && audio.finished() ? 1 : 0;
+}
+
+int replay_video_times(int64_t *out, int max)
+{
+    std::lock_guard<std::mutex> lock(times_mutex);
+    int count = static_cast<int>(video_times.size());
+    std::copy_n(video_times.begin(), std::min(count, max), out);
+    return count;
+}
+
+// The session calls, they always succeed
+int IOTC_Initialize2(int) { return 0; }
+int IOTC_DeInitialize(void) { return 0; }
+int IOTC_Get_SessionID(void) { return 0; }
+int IOTC_Connect_ByUID_Parallel(const char *, int) { return 0; }
+int IOTC_Session_Close(int) { return 0; }
+int avInitialize(int max_num_allowed) { return max_num_allowed; }
+int avDeInitialize(void) { return 0; }
+int avSendIOCtrl(int, unsigned int, const char *, int) { return 0; }
+int avClientCleanVideoBuf(int) { return 0; }
+int avClientCleanAudioBuf(int) { return 0; }
+
+int avClientStart2(int, const char *, const char *, unsigned int, unsigned int *, int, int *)
+{
+    if (!playing.exchange(true)) {
+        std::lock_guard<std::mutex> lock(pace_mutex);
+        base_time = clock::now();
+    }
+    return 0;
+}
+
+int avClientStop(int)
+{
+    return 0;
+}
+
+int avRecvFrameData2(int, char *frame_data, int frame_data_max_size, int *actual_frame_size,
+                     int *expected_frame_size, char *frame_info, int frame_info_max_size,
+                     int *actual_frame_info_size, unsigned int *frame_index)
+{
+    if (session_over()) {
+        return framepump::AV_ER_SESSION_CLOSE_BY_REMOTE;
+    }
+    if (video.finished() || !due(video.frames[video.next])) {
+        return framepump::AV_ER_DATA_NOREADY;
+    }
+    const Frame &frame = video.frames[video.next];
+
+    int size = static_cast<int>(frame.data.size());
+    *expected_frame_size = size;
+    if (size > frame_data_max_size) {
+        *actual_frame_size = 0;
+        ++video.next;
+        // Keeps the times lined up with the frames of the capture
+        std::lock_guard<std::mutex> lock(times_mutex);
+        video_times.push_back(0);
+        return AV_ER_BUFPARA_MAXSIZE_INSUFF;
+    }
+    std::memcpy(frame_data, frame.data.data(), frame.data.size());
+    *actual_frame_size = size;
+    copy_info(frame, frame_info, frame_info_max_size);
+    *actual_frame_info_size = sizeof(frame.info);
+    *frame_index = video.index++;
+    {
+        std::lock_guard<std::mutex> lock(times_mutex);
+        video_times.push_back(monotonic_us());
+    }
+    ++video.next;
+    return size;
+}
+
+int avCheckAudioBuf(int)
+{
+    if (session_over()) {
+        return framepump::AV_ER_SESSION_CLOSE_BY_REMOTE;
+    }
+    // Like the SDK, report how many frames are waiting to be read
+    int buffered = 0;
+    for (size_t next = audio.next; next < audio.frames.size() && buffered < max_buffered_audio &&
+                                   due(audio.frames[next]);
+         ++next) {
+        ++buffered;
+    }
+    // The receive loops wait for a backlog, so hand out the tail at once
+    return video.finished() && buffered > 0 ? std::max(buffered, 50) : buffered;
+}
+
+int avRecvAudioData(int, char *audio_data, int audio_data_max_size, char *frame_info,
+                    int frame_info_max_size, unsigned int *frame_index)
+{
+    if (session_over()) {
+        return framepump::AV_ER_SESSION_CLOSE_BY_REMOTE;
+    }
+    if (audio.finished() || !due(audio.frames[audio.next])) {
+        return framepump::AV_ER_DATA_NOREADY;
+    }
+
+    const Frame &frame = audio.frames[audio.next++];
+    int size = std::min(static_cast<int>(frame.data.size()), audio_data_max_size);
+    std::memcpy(audio_data, frame.data.data(), size);
+    copy_info(frame, frame_info, frame_info_max_size);
+    *frame_index = audio.index++;
+    return size;
+}
+
+}  // extern "C"
@@ -0,0 +1,59 @@
+/*
+ * Capture replay C API.
+ *
+ * Stand-in for libIOTCAPIs_ALL.so that plays back a capture recorded with
+ * "bench.py capture" instead of talking to a camera. It exports the subset
+ * of the IOTC/AV API that tutk.py and the frame pump use, so the real
+ * pipeline runs against it unchanged. bench.py loads it in place of the
+ * SDK and controls it through the functions below.
+ *
+ * A capture starts with the 8 byte magic "LSCCAP01", followed by a record
+ * per frame, little endian:
+ *
+ *   uint8_t  kind         0 video, 1 audio
+ *   uint8_t  reserved[3]
+ *   uint32_t size         of the frame data
+ *   uint64_t received_us  when the frame was received, from capture start
+ *   FRAMEINFO_t info      24 bytes, as returned by the SDK
+ *   uint8_t  data[size]
+ *
+ * Keep in sync with CaptureWriter in bench.py.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Loads the capture at path. Playback starts with the first session, at
+ * the times the frames were received. Returns the number of frames, or -1
+ * if the capture cannot be read.
+ */
+int replay_open(const char *path);
+
+/*
+ * Changes the playback rate from the next frame on. 1.0 plays the frames at
+ * the times they were received, 2.0 twice as fast and 0 as fast as the
+ * pipeline takes them.
+ */
+void replay_set_speed(double speed);
+
+/* Returns 1 once every frame of the capture has been handed out. */
+int replay_done(void);
+
+/*
+ * Copies up to max CLOCK_MONOTONIC times, in microseconds, at which the
+ * video frames were handed out to the pipeline, 0 for frames that did not
+ * fit into the receive buffer. Returns how many there are.
+ */
+int replay_video_times(int64_t *out, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
@@ -1,36 +1,48 @@
 """
 LSC Indoor Camera Proxy v1.0
 
-This script establishes a connection to an indoor camera using the TUTK
+This script establishes a connection to one or more indoor cameras using the TUTK
 framework.
 It handles the reception of audio
 and video streams, manages the RTSP server, and interacts with other services
-such as FFMPEG and MQTT. The script takes a unique identifier (UID)
-for the camera as a command-line argument and reads configuration
-settings from a "settings.yaml" file.
+such as FFMPEG and MQTT. The cameras are listed in a "settings.yaml" file,
+or a single camera is given by its unique identifier (UID) as a command-line
+argument.
 
 Usage:
-    ./main.py UID
+    ./main.py [UID]
 
 Functions:
-    - receive_audio(tutk): Continuously receives audio data from the
-      TUTK framework
-      and writes it to the audio FIFO file.
-    - receive_video(tutk): Continuously receives video data from the
-       TUTK framework
-      and writes it to the video FIFO file.
-    - clean_buffers(tutk): Periodically cleans video and audio buffers in the
-      TUTK framework.
-    - thread_connect_ccr(tutk, mqtt_enabled, mqtt_username, mqtt_password,
-      mqtt_hostname, mqtt_port, av_username, av_password):
-        Connects to the camera, starts video and audio streams,
-        initializes RTSP server, and manages related threads.
+    - receive_audio(tutk, ring, metrics, max_latency_ms, receiver, batch_frames): Continuously
+      receives audio data from the TUTK framework
+      and queues it for the audio FIFO file.
+    - receive_video(tutk, ring, metrics, max_latency_ms, receiver, batch_frames): Continuously
+      receives video data from the TUTK framework
+      and queues it for the video FIFO file.
+    - write_frames(ring, fifo, metrics): Writes the queued frames to a FIFO file.
+    - wait_for_audio_codec(tutk, metrics): Returns the codec of the first audio frame.
+    - report_first_frame(camera, timer): Logs when the first video frame is written.
+    - thread_connect_ccr(camera, lsc_mqtt_client, proxy_settings, rtsp_server):
+        Connects to a camera, starts video and audio streams,
+        and manages related threads. Reconnects when the session is lost.
+        The streams are received by the native frame pump when it has been
+        built, and by receive_video/receive_audio otherwise. The native
+        pump publishes them to the RTSP server itself unless the ffmpeg
+        publisher has been selected, and records them when record_dir is set.
+    - run_cameras(cameras, lsc_mqtt_client, proxy_settings, rtsp_server): Runs
+      thread_connect_ccr for every camera on a pool of worker threads.
 
 Main:
     - Reads configuration settings from "settings.yaml" file.
-    - Creates FIFO files for audio and video streams.
-    - Initializes TUTK framework and establishes a connection to the camera.
-    - Enters the main loop to manage camera streams and associated threads.
+    - Creates FIFO files for the audio and video streams of every camera.
+    - Initializes the TUTK framework once and starts one RTSP server and one MQTT
+      client shared by all cameras, each camera publishes to its own RTSP path.
+      The cameras connect while the RTSP server starts, their publishers wait
+      until it accepts connections. The steps of the startup are timed in the log.
+    - Starts the HTTP server that exports the metrics of the proxy and mediamtx,
+      serves snapshots of the cameras and takes the reader notifications of
+      mediamtx in the on demand mode.
+    - Connects to the cameras and manages their streams and associated threads.
     - Gracefully shuts down on KeyboardInterrupt, closing all connections and
       stopping threads.
 
@@ -39,234 +51,568 @@ Author:
 """
 
 import time
-import os
 import sys
 import threading
+from concurrent.futures import ThreadPoolExecutor, wait
+from pathlib import Path
 import yaml
+import encoders
+from httpserver import HttpServer
+from demand import DemandControl, StreamControl
+from snapshot import SnapshotRoute
+from metrics import MetricsExporter
 from services import (
     FFMPEG,
+    RTPPublisher,
     RTSPServer
 )
-from utils import usleep
+from utils import usleep, Poller, StartupTimer
 from mqtt import LscMqttClient
-from tutk import Tutk
+from camera import load_cameras
+from fifo import FifoWriter
+from supervisor import SessionSupervisor
+from framepump import BatchReceiver, FramePump
+from backlog import Backlog
+from quality import QualityController
+from ring import FrameRing
 import constants
 
+# How long a receive thread waits for room in a full ring with the "block" policy
+RING_FULL_DELAY_US = 2000
 
-def receive_audio(tutk):
+# The receive loops only read audio once this many frames are buffered
+AUDIO_MIN_BUFFERED = 50
+
+# How long ffmpeg waits for the first audio frame to learn the audio codec
+AUDIO_PROBE_S = 5
+
+# The startup log stops waiting for the first video frame after this long
+FIRST_FRAME_TIMEOUT_S = 30
+
+
+def next_bufs(tutk, ring, count):
     """
-    Continuously receives audio data from the TUTK framework and writes it
-    to the audio FIFO file.
+    Returns the ring buffers to receive the next frames into. With the "block"
+    policy this waits until the writer has made room.
 
     Args:
         tutk (Tutk): The TUTK framework instance.
+        ring (FrameRing): The ring of the stream.
+        count (int): Maximum number of buffers.
 
     Returns:
-        None
+        list: The buffers, empty if the ring is full or the proxy is shutting down.
     """
 
-    buf = tutk.create_buf(constants.settings["AUDIO_BUF_SIZE"])
+    buffers = ring.acquire(count)
+    while not buffers and ring.block and not tutk.graceful_shutdown:
+        usleep(RING_FULL_DELAY_US)
+        buffers = ring.acquire(count)
+    return buffers
 
-    print("Start IPCAM audio stream...")
-    fifo_file = constants.settings["AUDIO_FIFO_PATH"]
-    audio_pipe_fd = os.open(fifo_file, os.O_WRONLY)
-    if audio_pipe_fd == -1:
-        print("Cannot open audio_fifo file")
-    else:
-        print("OK open audio_fifo file")
 
-    while True:
-        status = tutk.av_check_audio_buf()
-        if status < 0:
-            break
-        if status < 50:
-            usleep(10000)
-            continue
+def write_frames(ring, fifo, metrics):
+    """
+    Writes the frames queued in the ring to the FIFO file until the ring is closed.
 
-        status = tutk.av_recv_audio_data(buf, constants.settings["AUDIO_BUF_SIZE"])
+    Args:
+        ring (FrameRing): The ring of the stream.
+        fifo (FifoWriter): Writer of the FIFO.
+        metrics (StreamMetrics): Counters of the stream.
 
-        if status == constants.av_error["AV_ER_SESSION_CLOSE_BY_REMOTE"]:
-            print("[thread_ReceiveAudio] AV_ER_SESSION_CLOSE_BY_REMOTE")
-            break
-        if status == constants.av_error["AV_ER_REMOTE_TIMEOUT_DISCONNECT"]:
-            print("[thread_ReceiveAudio] AV_ER_REMOTE_TIMEOUT_DISCONNECT")
-            break
-        if status == constants.iotc_error["IOTC_ER_INVALID_SID"]:
-            print("[thread_ReceiveAudio] Session cant be used anymore")
-            break
-        if status == constants.av_error["AV_ER_LOSED_THIS_FRAME"]:
+    Returns:
+        None
+    """
+
+    while not ring.closed:
+        frame = ring.front()
+        if frame is None:
+            ring.wait(0.1)
             continue
+        started = time.perf_counter_ns()
+        fifo.write(frame)
+        metrics.write_us.observe((time.perf_counter_ns() - started) // 1000)
+        metrics.written += 1
+        metrics.written_bytes += len(frame)
+        ring.release()
 
-        if tutk.graceful_shutdown:
-            break
 
-        # Audio Playback
-        try:
-            status = os.write(audio_pipe_fd, buf)
-            if status < 0:
-                print(f"audio_playback::write , ret=[{status}]")
-        except BrokenPipeError:
-            usleep(10000)
-            continue
+def wait_for_audio_codec(tutk, metrics, timeout_s=AUDIO_PROBE_S):
+    """
+    Waits for the first audio frame of the session and returns its codec.
 
-    # Close unused pipe ends
-    os.close(audio_pipe_fd)
-    print("[receive_audio] thread exit")
+    Args:
+        tutk (Tutk): The TUTK framework instance.
+        metrics (CameraMetrics): Counters of the camera, which keep the codec.
+        timeout_s (float): How long to wait for the frame.
 
+    Returns:
+        int: FrameInfoT.codec_id of the audio, PCM if no audio frame arrived in time.
+    """
 
-def receive_video(tutk):
+    deadline = time.monotonic() + timeout_s
+    while not tutk.graceful_shutdown and time.monotonic() < deadline:
+        _, streams = metrics.values()
+        codec = streams["audio"]["codec"]
+        if codec:
+            return codec
+        time.sleep(0.1)
+    return constants.audio_codec["MEDIA_CODEC_AUDIO_PCM"]
+
+
+def report_first_frame(camera, timer, timeout_s=FIRST_FRAME_TIMEOUT_S):
     """
-    Continuously receives video data from the TUTK framework and writes it to
-    the video FIFO file.
+    Waits for the first video frame written to the FIFO or the publisher and logs
+    the time it took since the start of the proxy. Runs on a thread of its own.
 
     Args:
-        tutk (Tutk): The TUTK framework instance.
+        camera (Camera): The camera.
+        timer (StartupTimer): Timer of the camera's startup.
+        timeout_s (float): How long to wait for the frame.
 
     Returns:
         None
     """
 
-    print("Start IPCAM video stream...")
+    deadline = time.monotonic() + timeout_s
+    while not camera.tutk.graceful_shutdown and time.monotonic() < deadline:
+        _, streams = camera.metrics.values()
+        if streams["video"]["written"]:
+            timer.mark("first video frame written")
+            return
+        time.sleep(0.02)
 
-    fifo_file = constants.settings["VIDEO_FIFO_PATH"]
-    video_pipe_fd = os.open(fifo_file, os.O_WRONLY)
-    if video_pipe_fd == -1:
-        print("Cannot open video_fifo file")
-    else:
-        print("OK open video_fifo file")
 
-    buf = tutk.create_buf(constants.settings["VIDEO_BUF_SIZE"])
+def session_closed(status, thread_name):
+    """
+    Checks whether a receive status means that the session is gone.
 
-    while True:
-        status = tutk.av_recv_framedata2(buf, constants.settings["VIDEO_BUF_SIZE"])
+    Args:
+        status (int): Status of the receive call.
+        thread_name (str): Name of the receive thread for the log.
 
-        if status == constants.av_error["AV_ER_DATA_NOREADY"]:
-            usleep(10000)
-            continue
-        if status == constants.av_error["AV_ER_SESSION_CLOSE_BY_REMOTE"]:
-            print("[thread_ReceiveVideo] AV_ER_SESSION_CLOSE_BY_REMOTE")
-            break
-        if status == constants.av_error["AV_ER_REMOTE_TIMEOUT_DISCONNECT"]:
-            print("[thread_ReceiveVideo] AV_ER_REMOTE_TIMEOUT_DISCONNECT")
-            break
-        if status == constants.iotc_error["IOTC_ER_INVALID_SID"]:
-            print("[thread_ReceiveVideo] Session can't be used anymore")
-            break
+    Returns:
+        bool: True if the receive thread has to exit.
+    """
+
+    if status == constants.av_error["AV_ER_SESSION_CLOSE_BY_REMOTE"]:
+        print(f"[{thread_name}] AV_ER_SESSION_CLOSE_BY_REMOTE")
+        return True
+    if status == constants.av_error["AV_ER_REMOTE_TIMEOUT_DISCONNECT"]:
+        print(f"[{thread_name}] AV_ER_REMOTE_TIMEOUT_DISCONNECT")
+        return True
+    if status == constants.iotc_error["IOTC_ER_INVALID_SID"]:
+        print(f"[{thread_name}] Session can't be used anymore")
+        return True
+    return False
 
+
+def receive_audio(tutk, ring, metrics, max_latency_ms=0, receiver=None, batch_frames=1):
+    """
+    Continuously receives audio data from the TUTK framework and queues it
+    for the audio FIFO file, until the session ends.
+
+    Args:
+        tutk (Tutk): The TUTK framework instance.
+        ring (FrameRing): Ring the audio frames are received into.
+        metrics (StreamMetrics): Counters of the stream.
+        max_latency_ms (int): Receive lag after which frames are dropped, 0 never drops.
+        receiver (BatchReceiver): Receives several frames per call, or None to
+            receive them one by one.
+        batch_frames (int): Maximum number of frames per call.
+
+    Returns:
+        None
+    """
+
+    buf_size = constants.settings["AUDIO_BUF_SIZE"]
+    # Frames that do not fit into the ring are received here and dropped
+    overflow_bufs = [tutk.create_buf(buf_size)]
+    if receiver is None:
+        # The Tutk object receives one frame per call with the same interface
+        receiver = tutk
+        batch_frames = 1
+
+    print("Start IPCAM audio stream...")
+
+    poller = Poller()
+    backlog = Backlog(max_latency_ms, False)
+    while True:
+        buffers = next_bufs(tutk, ring, batch_frames)
         if tutk.graceful_shutdown:
             break
+        received = receiver.recv_audio(buffers or overflow_bufs, buf_size, AUDIO_MIN_BUFFERED)
+        if tutk.graceful_shutdown:
+            break
+        if not received:
+            usleep(poller.next_delay())
+            continue
 
-        try:
-            # Video Playback
-            status = os.write(video_pipe_fd, buf)
+        closed = False
+        committed = 0
+        for index, (status, frame_info) in enumerate(received):
+            if session_closed(status, "thread_ReceiveAudio"):
+                closed = True
+                break
             if status < 0:
-                print(f"video_playback::write , ret=[{status}]")
-        except BrokenPipeError:
-            os.close(video_pipe_fd)
-            # make this line shorter
-            fifo_file = constants.settings["VIDEO_FIFO_PATH"]
-            video_pipe_fd = os.open(fifo_file, os.O_WRONLY)
-            if video_pipe_fd == -1:
-                print("Cannot open video_fifo file")
-            else:
-                print("OK open video_fifo file")
-            usleep(10000)
-            continue
+                metrics.lost += 1
+                continue
+
+            poller.frame_received()
+            metrics.frames += 1
+            metrics.bytes += status
+            metrics.codec = frame_info.codec_id
+            if not buffers:
+                metrics.overflows += 1
+                continue
+            flushing = backlog.dropping
+            if not backlog.accept(frame_info.timestamp, False):
+                metrics.dropped += 1
+                metrics.flushes += not flushing and backlog.dropping
+                continue
+            metrics.lag_ms = backlog.last_lag_ms
+
+            # Audio Playback, status is the size of the received audio frame
+            ring.commit(status, index - committed)
+            committed += 1
+        if closed:
+            break
 
-    # Close unused pipe ends
-    os.close(video_pipe_fd)
-    print("[receive_video] thread exit")
+    print("[receive_audio] thread exit")
 
 
-def clean_buffers(tutk):
+def receive_video(tutk, ring, metrics, max_latency_ms=0, receiver=None, batch_frames=1):
     """
-    Periodically cleans video and audio buffers in the TUTK framework.
+    Continuously receives video data from the TUTK framework and queues it for
+    the video FIFO file, until the session ends.
 
     Args:
         tutk (Tutk): The TUTK framework instance.
+        ring (FrameRing): Ring the video frames are received into.
+        metrics (StreamMetrics): Counters of the stream.
+        max_latency_ms (int): Receive lag after which frames are dropped, 0 never drops.
+        receiver (BatchReceiver): Receives several frames per call, or None to
+            receive them one by one.
+        batch_frames (int): Maximum number of frames per call.
 
     Returns:
         None
     """
 
+    print("Start IPCAM video stream...")
+
+    # Frames that do not fit into the ring are received here and dropped
+    overflow_bufs = [tutk.create_buf(ring.frame_size)]
+    if receiver is None:
+        # The Tutk object receives one frame per call with the same interface
+        receiver = tutk
+        batch_frames = 1
+
+    poller = Poller()
+    backlog = Backlog(max_latency_ms, True)
+    # A new session may start in the middle of a GOP
+    wait_for_keyframe = True
     while True:
-        time.sleep(5)
-        tutk.clean_video_buf()
-        time.sleep(5)
-        tutk.clean_audio_buf()
+        buffers = next_bufs(tutk, ring, batch_frames)
+        if tutk.graceful_shutdown:
+            break
+        buf_size = ring.frame_size if buffers else len(overflow_bufs[0])
+        received = receiver.recv_video(buffers or overflow_bufs, buf_size)
+        if tutk.graceful_shutdown:
+            break
+        if not received:
+            usleep(poller.next_delay())
+            continue
 
+        closed = False
+        committed = 0
+        for index, (status, frame_info) in enumerate(received):
+            if session_closed(status, "thread_ReceiveVideo"):
+                closed = True
+                break
+            if status == constants.av_error["AV_ER_BUFPARA_MAXSIZE_INSUFF"]:
+                # The SDK dropped a frame larger than the buffer, usually an IDR
+                # frame, and its GOP with it. The next ones get larger buffers.
+                metrics.lost += 1
+                wait_for_keyframe = True
+                if ring.grow(receiver.expected_video_size) > len(overflow_bufs[0]):
+                    print(f"[receive_video] Frame of {receiver.expected_video_size} bytes "
+                          f"did not fit, receiving up to {ring.frame_size} bytes")
+                    overflow_bufs = [tutk.create_buf(ring.frame_size)]
+                continue
+            if status < 0:
+                metrics.lost += 1
+                continue
+
+            poller.frame_received()
+            metrics.frames += 1
+            metrics.bytes += status
+            metrics.codec = frame_info.codec_id
+            if not buffers:
+                metrics.overflows += 1
+                # The writer fell behind. This GOP is broken now, so resume at
+                # the next keyframe once there is room again.
+                wait_for_keyframe = True
+                continue
+            keyframe = bool(frame_info.flags & constants.frame_flags["IPC_FRAME_FLAG_IFRAME"])
+            wait_for_keyframe = wait_for_keyframe and not keyframe
+            flushing = backlog.dropping
+            if wait_for_keyframe or not backlog.accept(frame_info.timestamp, keyframe):
+                metrics.dropped += 1
+                metrics.flushes += not flushing and backlog.dropping
+                continue
+            metrics.lag_ms = backlog.last_lag_ms
+
+            # Video Playback, status is the size of the received frame
+            ring.commit(status, index - committed)
+            committed += 1
+        if closed:
+            break
 
-def thread_connect_ccr(tutk, mqtt_enabled, mqtt_username,
-                       mqtt_password, mqtt_hostname, mqtt_port, av_username, av_password):
+    print("[receive_video] thread exit")
+
+
+def thread_connect_ccr(camera, lsc_mqtt_client, proxy_settings, rtsp_server=None):
     """
-    Connects to the camera, starts video and audio streams,
-    initializes RTSP server, initializes MQTT client.
+    Connects to the camera, starts video and audio streams and
+    adds the camera's sensors to the MQTT client. Runs on a worker thread
+    per camera until the proxy shuts down.
+
+    When the session is lost it is reestablished by a SessionSupervisor. The
+    FIFOs, ffmpeg and the native publisher stay up in the meantime, so RTSP
+    readers stay attached and the video resumes at the next keyframe.
+
+    In the on demand mode the camera is stopped and the publisher is taken off
+    the RTSP server while the stream has no readers, and both are started again
+    once the camera's Demand is requested by a reader. The session stays up.
 
     Args:
-        tutk (Tutk): The TUTK framework instance.
-        mqtt_enabled (bool): Flag indicating whether MQTT is enabled.
-        mqtt_username (str): MQTT username.
-        mqtt_password (str): MQTT password.
-        mqtt_hostname (str): MQTT broker hostname.
-        mqtt_port (int): MQTT broker port.
-        av_username (str): TUTK AV server username.
-        av_password (str): TUTK AV server password.
+        camera (Camera): The camera to connect to.
+        lsc_mqtt_client (LscMqttClient): The shared MQTT client, or None if MQTT is disabled.
+        proxy_settings (dict): The "proxy" section of settings.yaml.
+        rtsp_server (RTSPServer): The RTSP server, the publishers wait until it is ready.
 
     Returns:
         None
     """
 
-    tutk.iotc_connect_by_uid_parallel()
-
-    tutk.av_client_start2(av_username, av_password)
-
-    print("Client started")
-
-    if not tutk.start_ipcam_stream():
-        sys.exit(1)
-    else:
-        print("IOCTRL commands send successfully")
-
-        print("Starting RTSP Server...")
-        rtsp_server = RTSPServer()
-        rtsp_thread = threading.Thread(target=rtsp_server.start)
-        rtsp_thread.daemon = True
-        rtsp_thread.start()
-        time.sleep(2)
-
-        print("Starting video stream...")
-        video_thread = threading.Thread(target=receive_video, args=(tutk,))
+    native_pump = proxy_settings.get("native_pump", True)
+    passthrough = proxy_settings.get("passthrough", True)
+    audio_transcode = proxy_settings.get("audio_transcode", False)
+    publisher = proxy_settings.get("publisher", "native")
+    max_latency_ms = proxy_settings.get("max_latency_ms", 1500)
+    video_ring_frames = proxy_settings.get("ring_video_frames", 32)
+    audio_ring_frames = proxy_settings.get("ring_audio_frames", 64)
+    ring_policy = proxy_settings.get("ring_policy", "drop")
+    memory_budget_mb = proxy_settings.get("memory_budget_mb", 32)
+    recv_batch_frames = proxy_settings.get("recv_batch_frames", 8)
+    flip_by_ffmpeg = proxy_settings.get("flip", "camera") == "ffmpeg"
+    on_demand = proxy_settings.get("on_demand", False)
+    encoder = encoders.select(proxy_settings.get("video_encoder", "auto"))
+    record_dir = proxy_settings.get("record_dir", "")
+    frame_bus_mb = proxy_settings.get("frame_bus_mb", 0)
+
+    tutk = camera.tutk
+    timer = StartupTimer(camera.name)
+    quality = None
+    if proxy_settings.get("adaptive_quality", False):
+        # Before connecting, start_ipcam_stream sets the level of the controller
+        quality = QualityController(camera, proxy_settings.get("quality_best", 2),
+                                    proxy_settings.get("quality_worst", 5))
+    supervisor = SessionSupervisor(camera)
+    if not supervisor.connect():
+        return
+    timer.mark("session up")
+
+    pump = None
+    rtp_publisher = None
+    if native_pump and not FramePump.available():
+        print("Native frame pump not built. Falling back to Python receive loops")
+    elif native_pump:
+        pump = FramePump(tutk, max_latency_ms, video_ring_frames, audio_ring_frames,
+                         ring_policy, int(memory_budget_mb * 1024 * 1024))
+        camera.metrics.attach_pump(pump)
+        camera.snapshot.attach_pump(pump)
+    if record_dir and pump is None:
+        print(f"[{camera.name}] Recording needs the native frame pump, not recording")
+    elif record_dir:
+        directory = Path(record_dir) / camera.name
+        directory.mkdir(parents=True, exist_ok=True)
+        print(f"[{camera.name}] Recording to {directory}...")
+        pump.record(directory, proxy_settings.get("record_segment_s", 60),
+                    proxy_settings.get("record_max_age_s", 86400),
+                    proxy_settings.get("record_max_mb", 0) * 1024 * 1024,
+                    proxy_settings.get("record_sync_s", 10))
+    if frame_bus_mb and pump is None:
+        print(f"[{camera.name}] The frame bus needs the native frame pump, not publishing")
+    elif frame_bus_mb:
+        if not pump.frame_bus(f"/lscproxy-{camera.name}", frame_bus_mb * 1024 * 1024):
+            print(f"[{camera.name}] frame_bus_mb must be at least 1, not publishing")
+
+    def wait_for_rtsp_server():
+        # The session was set up while mediamtx started
+        if rtsp_server is not None and not rtsp_server.ready.is_set():
+            if rtsp_server.wait_ready():
+                timer.mark("RTSP server ready")
+            else:
+                print(f"[{camera.name}] RTSP server not ready, publishing anyway")
+
+    if pump is not None and publisher == "native":
+        wait_for_rtsp_server()
+        print(f"[{camera.name}] Starting native RTP publisher...")
+        rtp_publisher = RTPPublisher(pump, camera.rtsp_url)
+        rtp_publisher.start()
+    elif pump is not None:
+        print(f"[{camera.name}] Starting native frame pump...")
+        pump.start(camera.video_fifo, camera.audio_fifo)
+
+    # The FIFOs and their writers outlive the sessions, so ffmpeg keeps reading
+    # while the camera reconnects
+    video_fifo = FifoWriter(camera.video_fifo)
+    audio_fifo = FifoWriter(camera.audio_fifo)
+    writer_threads = []
+    receiver = None
+    if pump is None:
+        # Without the pump the native library can still batch the receive calls
+        if FramePump.available() and recv_batch_frames > 1:
+            receiver = BatchReceiver(tutk, recv_batch_frames)
+        video_ring = FrameRing(tutk, video_ring_frames, constants.settings["VIDEO_BUF_SIZE"],
+                               ring_policy)
+        audio_ring = FrameRing(tutk, audio_ring_frames, constants.settings["AUDIO_BUF_SIZE"],
+                               ring_policy)
+        for stream, ring, fifo, metrics in (
+                ("video", video_ring, video_fifo, camera.metrics.video),
+                ("audio", audio_ring, audio_fifo, camera.metrics.audio)):
+            writer_thread = threading.Thread(target=write_frames, args=(ring, fifo, metrics),
+                                             name=f"{camera.name}-{stream}-tx")
+            writer_thread.daemon = True
+            writer_thread.start()
+            writer_threads.append(writer_thread)
+
+    def start_receive_threads():
+        print(f"[{camera.name}] Starting video stream...")
+        video_thread = threading.Thread(target=receive_video, name=f"{camera.name}-video-rx",
+                                        args=(tutk, video_ring, camera.metrics.video,
+                                              max_latency_ms, receiver, recv_batch_frames))
         video_thread.start()
 
-        print("Starting audio stream...")
-        audio_thread = threading.Thread(target=receive_audio, args=(tutk,))
+        print(f"[{camera.name}] Starting audio stream...")
+        audio_thread = threading.Thread(target=receive_audio, name=f"{camera.name}-audio-rx",
+                                        args=(tutk, audio_ring, camera.metrics.audio,
+                                              max_latency_ms, receiver, recv_batch_frames))
         audio_thread.start()
-        time.sleep(1)
-
-        cleanup_buffers_thread = threading.Thread(target=clean_buffers, args=(tutk,))
-        cleanup_buffers_thread.daemon = True
-        cleanup_buffers_thread.start()
-
-        print("Starting ffmpeg...")
-        ffmpeg = FFMPEG()
+        return video_thread, audio_thread
+
+    if pump is None:
+        receive_threads = start_receive_threads()
+    report_thread = threading.Thread(target=report_first_frame, args=(camera, timer),
+                                     name=f"{camera.name}-startup", daemon=True)
+    report_thread.start()
+
+    # The native publisher feeds the RTSP server itself
+    ffmpeg = None
+    if rtp_publisher is None:
+        # ffmpeg has to know the format of the audio FIFO before it opens it
+        audio_codec = wait_for_audio_codec(tutk, camera.metrics)
+        timer.mark("audio codec known")
+        wait_for_rtsp_server()
+        print(f"[{camera.name}] Starting ffmpeg, audio codec 0x{audio_codec:02x}...")
+        ffmpeg = FFMPEG(camera.video_fifo, camera.audio_fifo, camera.rtsp_url, passthrough,
+                        audio_codec, audio_transcode, encoder)
         ffmpeg_thread = threading.Thread(target=ffmpeg.start)
         ffmpeg_thread.daemon = True
         ffmpeg_thread.start()
 
-        if mqtt_enabled:
-            print("Starting MQTT...")
+    if lsc_mqtt_client is not None:
+        lsc_mqtt_client.add_camera(camera, ffmpeg, flip_by_ffmpeg)
 
-            lsc_mqtt_client = LscMqttClient(tutk, mqtt_username, mqtt_password,
-                                            mqtt_hostname, mqtt_port, ffmpeg)
-            lsc_mqtt_client_thread = threading.Thread(target=lsc_mqtt_client.start)
-            lsc_mqtt_client_thread.daemon = True
-            lsc_mqtt_client_thread.start()
+    stream = StreamControl(camera, rtp_publisher, ffmpeg, quality, on_demand)
+    stream.session_started()
+    stream.poll()
+    try:
+        while True:
+            if pump is not None:
+                # Wait in steps so that a shutdown and the readers are noticed
+                while not pump.wait(1) and not tutk.graceful_shutdown:
+                    stream.poll()
+            else:
+                for receive_thread in receive_threads:
+                    while receive_thread.is_alive():
+                        receive_thread.join(1)
+                        stream.poll()
+
+            if tutk.graceful_shutdown:
+                break
 
-        video_thread.join()
-        audio_thread.join()
+            supervisor.session_lost()
+            if not supervisor.connect():
+                break
 
-        rtsp_server.stop()
+            if pump is not None:
+                pump.resume(tutk)
+            else:
+                receive_threads = start_receive_threads()
+
+            # start_ipcam_stream resets the camera, restore what the sensors set
+            if lsc_mqtt_client is not None:
+                lsc_mqtt_client.restore_camera(camera)
+            # It also starts the camera, which stays stopped while idle or private
+            stream.session_started()
+            stream.poll()
+    finally:
+        if pump is not None:
+            print(f"[{camera.name}] [frame_pump] {pump.stats()}")
+            camera.metrics.detach_pump()
+            camera.snapshot.detach_pump()
+            pump.stop()
+        supervisor.disconnect()
+
+    if pump is None:
+        video_ring.close()
+        audio_ring.close()
+    if receiver is not None:
+        receiver.close()
+    if ffmpeg is not None:
         ffmpeg.stop()
+    # A writer may still be blocked opening a FIFO that ffmpeg never opened
+    for writer_thread in writer_threads:
+        writer_thread.join(timeout=1)
+    video_fifo.close()
+    audio_fifo.close()
+
+
+def run_cameras(cameras, lsc_mqtt_client, proxy_settings, rtsp_server=None):
+    """
+    Runs the session of every camera on a pool of worker threads, one per
+    camera, until all sessions have ended or Ctrl+C is pressed.
+
+    Args:
+        cameras (list): The Camera objects.
+        lsc_mqtt_client (LscMqttClient): The shared MQTT client, or None if MQTT is disabled.
+        proxy_settings (dict): The "proxy" section of settings.yaml.
+        rtsp_server (RTSPServer): The RTSP server the cameras publish to.
+
+    Returns:
+        None
+    """
+
+    with ThreadPoolExecutor(max_workers=len(cameras), thread_name_prefix="camera") as pool:
+        sessions = {pool.submit(thread_connect_ccr, camera, lsc_mqtt_client, proxy_settings,
+                                rtsp_server): camera
+                    for camera in cameras}
+        pending = set(sessions)
+        try:
+            while pending:
+                # Wait in steps so that Ctrl+C still reaches the main thread
+                done, pending = wait(pending, timeout=1)
+                for session in done:
+                    # sys.exit() in a session only ends that session
+                    error = session.exception()
+                    if error is not None:
+                        print(f"[{sessions[session].name}] Session ended: {error!r}")
+        finally:
+            for camera in cameras:
+                camera.tutk.graceful_shutdown = True
 
 
 def print_ascii_title():
@@ -285,11 +631,7 @@ def print_ascii_title():
 
 
 if __name__ == "__main__":
-    if len(sys.argv) < 2:
-        print("Usage: ./main.py UID")
-        sys.exit(1)
-
-    uid = sys.argv[1]
+    uid = sys.argv[1] if len(sys.argv) > 1 else None
 
     settings_yaml_file = constants.settings["SETTINGS_PATH"]
     try:
@@ -303,47 +645,107 @@ if __name__ == "__main__":
             mqtt_hostname = data['homeassistant_credentials']['mqtt_hostname']
             mqtt_port = data['homeassistant_credentials']['mqtt_port']
 
-        av_username = data['tutk_credentials']['av_username']
-        av_password = data['tutk_credentials']['av_password']
+        proxy_settings = data.get('proxy') or {}
+
+        cameras = load_cameras(data, uid)
 
     except KeyError as e:
-        print(f"Error: Required key not found: {e}")
+        if uid is None and e.args == ('cameras',):
+            print("Usage: ./main.py UID, or list the cameras in settings.yaml")
+        else:
+            print(f"Error: Required key not found: {e}")
+        sys.exit(1)
+    except ValueError as e:
+        print(f"Error: {e}")
         sys.exit(1)
 
-    fifos_dir = constants.settings["FIFOS_DIR"]
-    audio_fifo_file = constants.settings["AUDIO_FIFO_PATH"]
-    video_fifo_file = constants.settings["VIDEO_FIFO_PATH"]
-
-    if not fifos_dir.exists():
-        fifos_dir.mkdir(parents=True, exist_ok=True)
-        print(f"Directory '{fifos_dir}' created.")
-
-    if not audio_fifo_file.exists():
-        os.mkfifo(audio_fifo_file)
-        print(f"Audio FIFO '{audio_fifo_file}' created.")
-
-    if not video_fifo_file.exists():
-        os.mkfifo(video_fifo_file)
-        print(f"Video FIFO '{video_fifo_file}' created.")
+    for camera in cameras:
+        camera.create_fifos()
+        camera.snapshot.height = proxy_settings.get("snapshot_height", 0)
 
-    tutk_framework = Tutk(uid)
+    # The IOTC and AV modules are initialized once for all sessions
+    tutk_framework = cameras[0].tutk
 
     tutk_framework.iotc_initialize2(0)
-    tutk_framework.av_initialize(2)
-
-    # Connect to the camera
+    tutk_framework.av_initialize(2 * len(cameras))
+
+    print_ascii_title()
+    startup_timer = StartupTimer("proxy")
+
+    http_port = proxy_settings.get("http_port", 9996)
+    demand_url = None
+    if proxy_settings.get("on_demand", False):
+        if http_port:
+            # The hooks of mediamtx reach the proxy on the loopback
+            demand_url = f"http://127.0.0.1:{http_port}/demand"
+        else:
+            print("on_demand needs the HTTP server, the cameras stream all the time")
+            proxy_settings["on_demand"] = False
+    if proxy_settings.get("on_demand", False) and proxy_settings.get("record_dir", ""):
+        # The recorder is a reader that is always there
+        print("on_demand does not apply while recording, the cameras stream all the time")
+        demand_url = None
+        proxy_settings["on_demand"] = False
+
+    # Detected once, for the substreams and the ffmpeg of every camera
+    encoder = encoders.select(proxy_settings.get("video_encoder", "auto"))
+
+    print("Starting RTSP Server...")
+    rtsp_server = RTSPServer(proxy_settings.get("substream_height", 360),
+                             proxy_settings.get("substream_fps", 5),
+                             proxy_settings.get("substream_bitrate", "300k"),
+                             demand_url, proxy_settings.get("on_demand_grace_s", 30),
+                             encoder)
+    rtsp_thread = threading.Thread(target=rtsp_server.start)
+    rtsp_thread.daemon = True
+    rtsp_thread.start()
+
+    def report_rtsp_server():
+        if rtsp_server.wait_ready():
+            startup_timer.mark("RTSP server ready")
+
+    # Not waited for here, the cameras connect in the meantime
+    threading.Thread(target=report_rtsp_server, name="rtsp-ready", daemon=True).start()
+
+    http_server = None
+    if http_port:
+        http_server = HttpServer(proxy_settings.get("http_host", "0.0.0.0"), http_port)
+        metrics_exporter = MetricsExporter(cameras, constants.settings["MEDIAMTX_METRICS_URL"])
+        http_server.add_route("/metrics", metrics_exporter.route)
+        http_server.add_route("/snapshot.jpg", SnapshotRoute(cameras).route)
+        if demand_url is not None:
+            http_server.add_route("/demand", DemandControl(cameras).route)
+        http_thread = threading.Thread(target=http_server.start)
+        http_thread.daemon = True
+        http_thread.start()
+
+    lsc_mqtt_client = None
+    if mqtt_enabled:
+        print("Starting MQTT...")
+
+        lsc_mqtt_client = LscMqttClient(mqtt_username, mqtt_password,
+                                        mqtt_hostname, mqtt_port)
+        lsc_mqtt_client_thread = threading.Thread(target=lsc_mqtt_client.start)
+        lsc_mqtt_client_thread.daemon = True
+        lsc_mqtt_client_thread.start()
+
+    # Connect to the cameras
+    startup_timer.mark("services started")
     try:
-        print_ascii_title()
-
-        thread_connect_ccr(tutk_framework, mqtt_enabled, mqtt_username,
-                           mqtt_password, mqtt_hostname, mqtt_port, av_username, av_password)
+        run_cameras(cameras, lsc_mqtt_client, proxy_settings, rtsp_server)
     except KeyboardInterrupt:
-        tutk_framework.graceful_shutdown = True
         print("You pressed Ctrl+C!")
         print("Gracefully shutting down")
 
-    tutk_framework.av_client_stop()
-    tutk_framework.iotc_session_close()
+    if http_server is not None:
+        http_server.stop()
+    rtsp_server.stop()
+    if lsc_mqtt_client is not None:
+        lsc_mqtt_client.save_states()
+
+    for camera in cameras:
+        camera.tutk.av_client_stop()
+        camera.tutk.iotc_session_close()
     tutk_framework.iotc_de_initialize()
 
     print("\nLSC Indoor Camera Proxy. Shutted down.")
@@ -0,0 +1,383 @@
+"""
+Proxy Metrics Module.
+
+This module counts what happens to the frames of every camera and exports the
+counters in the Prometheus text format.
+
+Every stage of the pipeline has its own counters, so a latency can be traced to
+where it comes from. The receive lag is the delay the TUTK link adds. The write
+duration is the time the FIFO, or the RTSP connection of the native publisher,
+takes per frame. The metrics of mediamtx are appended to the export, under their
+own names, and cover the RTSP server. The camera label is the RTSP path, which
+is the "name" label in the mediamtx metrics.
+
+The Python receive loops update a CameraMetrics object, the native frame pump
+keeps the same counters itself and they are read through FramePump.stats().
+
+Classes:
+    Histogram: Counts observations in buckets.
+    StreamMetrics: Counters of the video or the audio stream of a camera.
+    CameraMetrics: Counters of a camera and its session.
+    MetricsExporter: Renders the counters of all cameras for /metrics.
+
+Author:
+    Berobloom
+"""
+
+import bisect
+import threading
+import urllib.request
+import constants
+from framepump import LATENCY_BOUNDS_US
+
+METRICS_PREFIX = "lscproxy_"
+
+STREAMS = ("video", "audio")
+
+# Name, type, help and key in the stream values
+STREAM_FAMILIES = (
+    ("frames_received_total", "counter", "Frames received from the camera.", "frames"),
+    ("bytes_received_total", "counter", "Bytes received from the camera.", "bytes"),
+    ("frames_lost_total", "counter",
+     "Receive errors such as AV_ER_LOSED_THIS_FRAME.", "lost"),
+    ("frames_dropped_total", "counter",
+     "Frames dropped to bound the latency or to resume at a keyframe.", "dropped"),
+    ("backlog_flushes_total", "counter",
+     "Times the backlog control started dropping frames.", "flushes"),
+    ("ring_overflows_total", "counter",
+     "Frames dropped because the writer fell behind.", "overflows"),
+    ("frames_written_total", "counter", "Frames written to the FIFO or the publisher.", "written"),
+    ("bytes_written_total", "counter", "Bytes written to the FIFO or the publisher.",
+     "written_bytes"),
+)
+
+# Name, type, help and key in the camera values
+CAMERA_FAMILIES = (
+    ("session_up", "gauge", "1 while the TUTK session of the camera is up.", "session_up"),
+    ("video_quality", "gauge",
+     "Video quality level set on the camera, 1 is the best and 5 the worst.", "quality"),
+    ("reconnects_total", "counter", "TUTK sessions established after a lost one.", "reconnects"),
+    ("write_errors_total", "counter", "Failed writes of the native frame pump.", "write_errors"),
+    ("fifo_reopens_total", "counter", "FIFOs the native frame pump reopened.", "fifo_reopens"),
+    ("rtp_packets_total", "counter", "RTP packets sent by the native publisher.", "rtp_packets"),
+    ("rtp_bytes_total", "counter", "RTP bytes sent by the native publisher.", "rtp_bytes"),
+    ("publisher_connects_total", "counter",
+     "RTSP sessions the native publisher set up.", "publisher_connects"),
+    ("record_segments_total", "counter", "MP4 segments the recorder started.",
+     "record_segments"),
+    ("record_bytes_total", "counter", "Bytes the recorder wrote.", "record_bytes"),
+    ("record_dropped_total", "counter",
+     "Frames the recorder dropped because the disk fell behind.", "record_dropped"),
+    ("bus_frames_total", "counter", "Frames published to the shared memory frame bus.",
+     "bus_frames"),
+    ("bus_bytes_total", "counter", "Bytes published to the shared memory frame bus.",
+     "bus_bytes"),
+    ("frame_memory_bytes", "gauge",
+     "Bytes the native frame pump holds for frames, within the memory budget.", "memory_bytes"),
+    ("frame_memory_refused_total", "counter",
+     "Frames dropped or not cached because the memory budget had no room.", "memory_refused"),
+    ("video_oversized_total", "counter",
+     "Video frames lost for not fitting into the receive buffer.", "video_oversized"),
+)
+
+
+class Histogram():
+    """
+    Histogram Class.
+
+    Attributes:
+        counts: Observations per bucket, not cumulative, the last bucket is unbounded.
+        sum: Sum of all observations.
+
+    Methods:
+        __init__(self, bounds): Creates the buckets with the given upper bounds.
+        observe(self, value): Counts a value.
+    """
+
+    def __init__(self, bounds):
+        self._bounds = bounds
+        self.counts = [0] * (len(bounds) + 1)
+        self.sum = 0
+
+    def observe(self, value):
+        """
+        Counts a value.
+
+        Args:
+            value (int): The value to count.
+
+        Returns:
+            None
+        """
+
+        self.counts[bisect.bisect_left(self._bounds, value)] += 1
+        self.sum += value
+
+
+class StreamMetrics():
+    """
+    Counters of the video or the audio stream of a camera. The receive thread
+    updates the receive counters and the writer thread the write counters.
+
+    Attributes:
+        frames: Frames received.
+        bytes: Bytes received.
+        lost: Receive errors.
+        dropped: Frames dropped by the backlog control or while waiting for a keyframe.
+        flushes: Times the backlog control started dropping.
+        overflows: Frames dropped because the ring was full.
+        written: Frames written to the FIFO.
+        written_bytes: Bytes written to the FIFO.
+        lag_ms: Receive lag of the last frame.
+        codec: FrameInfoT.codec_id of the last frame, 0 before the first.
+        write_us: Histogram of the FIFO write durations in microseconds.
+
+    Methods:
+        values(self): Returns the counters as a dictionary.
+    """
+
+    def __init__(self):
+        self.frames = 0
+        self.bytes = 0
+        self.lost = 0
+        self.dropped = 0
+        self.flushes = 0
+        self.overflows = 0
+        self.written = 0
+        self.written_bytes = 0
+        self.lag_ms = 0
+        self.codec = 0
+        self.write_us = Histogram(LATENCY_BOUNDS_US)
+
+    def values(self):
+        """
+        Returns the counters.
+
+        Returns:
+            dict: Counter name to value, and "write_us" to the bucket counts and the sum.
+        """
+
+        return {
+            "frames": self.frames,
+            "bytes": self.bytes,
+            "lost": self.lost,
+            "dropped": self.dropped,
+            "flushes": self.flushes,
+            "overflows": self.overflows,
+            "written": self.written,
+            "written_bytes": self.written_bytes,
+            "lag_ms": self.lag_ms,
+            "codec": self.codec,
+            "write_us": (list(self.write_us.counts), self.write_us.sum),
+        }
+
+
+class CameraMetrics():
+    """
+    Counters of a camera and its session.
+
+    Attributes:
+        video: StreamMetrics of the video stream.
+        audio: StreamMetrics of the audio stream.
+        session_up: True while the TUTK session is up.
+        reconnects: Sessions established after a lost one.
+        quality: Video quality level set on the camera.
+        _pump: FramePump whose counters replace the stream counters, or None.
+        _lock: Keeps the pump from being freed while its counters are read.
+
+    Methods:
+        attach_pump(self, pump): Reads the stream counters from the native frame pump.
+        detach_pump(self): Stops reading from the pump before it is freed.
+        values(self): Returns the counters of the camera and of both streams.
+    """
+
+    def __init__(self):
+        self.video = StreamMetrics()
+        self.audio = StreamMetrics()
+        self.session_up = False
+        self.reconnects = 0
+        self.quality = constants.video_quality["AVIOCTRL_QUALITY_HIGH"]
+        self._pump = None
+        self._lock = threading.Lock()
+
+    def attach_pump(self, pump):
+        """
+        Reads the stream counters from the native frame pump from now on.
+
+        Args:
+            pump (FramePump): The pump receiving the streams of the camera.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            self._pump = pump
+
+    def detach_pump(self):
+        """
+        Stops reading from the pump, call before the pump is stopped.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            self._pump = None
+
+    def values(self):
+        """
+        Returns the counters of the camera and of both streams.
+
+        Returns:
+            tuple: Dictionary of the camera counters, and dictionary of stream
+                name to the dictionary of its counters.
+        """
+
+        camera = {
+            "session_up": int(self.session_up),
+            "reconnects": self.reconnects,
+            "quality": self.quality,
+            "write_errors": 0,
+            "fifo_reopens": 0,
+            "rtp_packets": 0,
+            "rtp_bytes": 0,
+            "publisher_connects": 0,
+            "record_segments": 0,
+            "record_bytes": 0,
+            "record_dropped": 0,
+            "bus_frames": 0,
+            "bus_bytes": 0,
+            "memory_bytes": 0,
+            "memory_refused": 0,
+            "video_oversized": 0,
+        }
+        with self._lock:
+            stats = self._pump.stats() if self._pump is not None else None
+
+        if stats is None:
+            return camera, {"video": self.video.values(), "audio": self.audio.values()}
+
+        for key in ("write_errors", "fifo_reopens", "rtp_packets", "rtp_bytes",
+                    "publisher_connects", "record_segments", "record_bytes", "record_dropped",
+                    "bus_frames", "bus_bytes", "memory_bytes", "memory_refused",
+                    "video_oversized"):
+            camera[key] = stats[key]
+        streams = {}
+        for stream in STREAMS:
+            streams[stream] = {
+                "frames": stats[f"{stream}_frames"],
+                "bytes": stats[f"{stream}_bytes"],
+                "lost": stats[f"{stream}_lost"],
+                "dropped": stats[f"{stream}_dropped"],
+                "flushes": stats[f"{stream}_flushes"],
+                "overflows": stats[f"{stream}_overflows"],
+                "written": stats[f"{stream}_written"],
+                "written_bytes": stats[f"{stream}_written_bytes"],
+                "lag_ms": stats[f"{stream}_lag_ms"],
+                "codec": stats[f"{stream}_codec"],
+                "write_us": (stats[f"{stream}_write_us"], stats[f"{stream}_write_us_sum"]),
+            }
+        return camera, streams
+
+
+class MetricsExporter():
+    """
+    Renders the counters of all cameras in the Prometheus text format, followed by
+    the metrics of mediamtx.
+
+    Attributes:
+        _cameras: The Camera objects.
+        _mediamtx_url: URL of the mediamtx metrics, or None.
+
+    Methods:
+        __init__(self, cameras, mediamtx_url): Initializes the exporter.
+        render(self): Returns the metrics as text.
+        route(self, query): HttpServer route serving the metrics.
+    """
+
+    def __init__(self, cameras, mediamtx_url=None):
+        self._cameras = cameras
+        self._mediamtx_url = mediamtx_url
+
+    @staticmethod
+    def _family(lines, name, kind, description):
+        lines.append(f"# HELP {METRICS_PREFIX}{name} {description}")
+        lines.append(f"# TYPE {METRICS_PREFIX}{name} {kind}")
+
+    def _mediamtx_metrics(self):
+        try:
+            with urllib.request.urlopen(self._mediamtx_url, timeout=1) as response:
+                return response.read().decode("utf-8"), 1
+        except (OSError, ValueError):
+            return "", 0
+
+    def render(self):
+        """
+        Returns the metrics.
+
+        Returns:
+            str: The metrics in the Prometheus text format.
+        """
+
+        values = [(camera.name, *camera.metrics.values()) for camera in self._cameras]
+        lines = []
+
+        for name, kind, description, key in CAMERA_FAMILIES:
+            self._family(lines, name, kind, description)
+            for camera_name, camera, _ in values:
+                lines.append(f'{METRICS_PREFIX}{name}{{camera="{camera_name}"}} {camera[key]}')
+
+        for name, kind, description, key in STREAM_FAMILIES:
+            self._family(lines, name, kind, description)
+            for camera_name, _, streams in values:
+                for stream in STREAMS:
+                    lines.append(f'{METRICS_PREFIX}{name}{{camera="{camera_name}",'
+                                 f'stream="{stream}"}} {streams[stream][key]}')
+
+        self._family(lines, "receive_lag_seconds", "gauge",
+                     "How much later than its camera timestamp the last frame was received.")
+        for camera_name, _, streams in values:
+            for stream in STREAMS:
+                lines.append(f'{METRICS_PREFIX}receive_lag_seconds{{camera="{camera_name}",'
+                             f'stream="{stream}"}} {streams[stream]["lag_ms"] / 1000}')
+
+        name = "write_duration_seconds"
+        self._family(lines, name, "histogram",
+                     "Time the FIFO write or the RTP send of a frame took.")
+        for camera_name, _, streams in values:
+            for stream in STREAMS:
+                counts, sum_us = streams[stream]["write_us"]
+                labels = f'camera="{camera_name}",stream="{stream}"'
+                total = 0
+                for bound, count in zip(LATENCY_BOUNDS_US, counts):
+                    total += count
+                    lines.append(f'{METRICS_PREFIX}{name}_bucket{{{labels},'
+                                 f'le="{bound / 1e6}"}} {total}')
+                total += counts[-1]
+                lines.append(f'{METRICS_PREFIX}{name}_bucket{{{labels},le="+Inf"}} {total}')
+                lines.append(f'{METRICS_PREFIX}{name}_sum{{{labels}}} {sum_us / 1e6}')
+                lines.append(f'{METRICS_PREFIX}{name}_count{{{labels}}} {total}')
+
+        if self._mediamtx_url is not None:
+            mediamtx, up = self._mediamtx_metrics()
+            self._family(lines, "mediamtx_up", "gauge",
+                         "1 if the mediamtx metrics could be read.")
+            lines.append(f"{METRICS_PREFIX}mediamtx_up {up}")
+            if mediamtx:
+                lines.append(mediamtx.rstrip("\n"))
+
+        return "\n".join(lines) + "\n"
+
+    def route(self, query):
+        """
+        HttpServer route serving the metrics.
+
+        Args:
+            query (dict): Query parameters of the request, unused.
+
+        Returns:
+            tuple: Status code, content type and body.
+        """
+
+        return 200, "text/plain; version=0.0.4", self.render().encode("utf-8")
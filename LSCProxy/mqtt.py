@@ -1,13 +1,19 @@
 """
 MQTT Client Class.
+
+The paho network thread only queues the commands of Home Assistant. A worker
+thread applies them, so the IOCTRLs and ffmpeg restarts they cause do not hold
+up the connection, and a command that is superseded while it waits, e.g. a
+switch toggled on and off again, is dropped. The states are published retained
+and only when they change, instead of every sensor once a second.
 """
-import os
-import time
 import json
 import sys
+import threading
 from sensors.nightvision import Nightvision
 from sensors.private import Private
 from sensors.flip import Flip
+from statestore import StateStore
 import paho.mqtt.client as mqtt
 
 
@@ -16,28 +22,50 @@ class LscMqttClient():
     MQTT Client Class.
 
     This class represents an MQTT client for LSC (Light, Sensor, Camera) devices.
+    One client serves the sensors of every camera of the proxy.
 
     Attributes:
-        _tutk: Instance of the Tutk class for handling camera-related functionalities.
         _username: MQTT broker username.
         _password: MQTT broker password.
         _hostname: MQTT broker hostname.
         _port: MQTT broker port.
-        _sensors: Dictionary to store Sensor objects.
+        _sensors: Dictionary to store Sensor objects. The Flip sensor of a camera is only
+            added when an FFMPEG process is given.
+        _camera_sensors: Dictionary mapping a camera name to the Sensor objects of the camera.
+        _sensors_lock: Lock guarding the sensors, cameras are added from their own threads.
+        _connected: Flag indicating whether the client is connected to the broker.
+        _published: Dictionary mapping a state topic to the payload last published on it.
+        _work: Condition the worker waits on for commands and announcements.
+        _commands: Dictionary mapping a command topic to the last payload received on it,
+            in the order they arrived.
+        _announcements: Lists of sensors to announce.
+        _state_store: StateStore the sensors save their state in.
         _client: Paho MQTT client instance.
 
     Methods:
-        __init__(self, tutk, username, password, hostname, port,
-            ffmpeg_process): Initializes the LSC MQTT client.
+        __init__(self, username, password, hostname, port): Initializes the LSC MQTT client.
+        add_camera(self, camera, ffmpeg_process): Adds the sensors of a camera.
+        restore_camera(self, camera): Applies the state of a camera's sensors again.
+        _queue_announcement(self, sensors): Has the worker announce sensors.
+        _announce(self, sensors): Announces sensors to Home Assistant.
+        _publish_state(self, sensor): Publishes the state of a sensor if it changed.
         _on_connect(self, client, userdata, flags, rc): Callback function on MQTT connection.
         _on_message(self, client, userdata, msg): Callback function on MQTT message reception.
-        _start(self): Starts the MQTT client loop and handles MQTT interactions.
+        save_states(self): Writes the states of the sensors that were not written yet.
+        start(self): Starts the MQTT client loop and applies the queued commands.
     """
 
-    def __init__(self, tutk, username, password, hostname, port, ffmpeg_process):
+    def __init__(self, username, password, hostname, port):
         self._sensors = {}
+        self._camera_sensors = {}
+        self._sensors_lock = threading.Lock()
+        self._connected = False
+        self._published = {}
+        self._work = threading.Condition()
+        self._commands = {}
+        self._announcements = []
+        self._state_store = StateStore()
 
-        self._tutk = tutk
         self._username = username
         self._password = password
         self._hostname = hostname
@@ -50,15 +78,136 @@ class LscMqttClient():
         keepalive = 60
         self._client.connect(self._hostname, self._port, keepalive)
 
+    def add_camera(self, camera, ffmpeg_process, flip_by_ffmpeg=False):
+        """
+        Adds the sensors of a camera and announces them once connected.
+
+        Parameters:
+            camera: Camera object the sensors control.
+            ffmpeg_process: FFMPEG object of the camera, or None if it has none.
+            flip_by_ffmpeg: True to flip with an ffmpeg filter instead of on the camera.
+
+        Returns:
+            None
+        """
+
+        tutk = camera.tutk
+        name = camera.mqtt_name
+
         # Add sensors here
-        nightvision = Nightvision("Night vision",
-                                  "switch", "mdi:light-flood-down", self._tutk, ffmpeg_process)
-        private = Private("Private", "switch", "mdi:eye-off", self._tutk, ffmpeg_process)
-        flip = Flip("Flip", "switch", "mdi:flip-vertical", self._tutk, ffmpeg_process)
+        store = self._state_store
+        sensors = [
+            Nightvision("Night vision", "switch", "mdi:light-flood-down", tutk,
+                        ffmpeg_process, name, store),
+            Private("Private", "switch", "mdi:eye-off", tutk, ffmpeg_process, name, store),
+        ]
+
+        # The camera flips the image itself, the ffmpeg filter needs an ffmpeg process
+        if not flip_by_ffmpeg:
+            sensors.append(Flip("Flip", "switch", "mdi:flip-vertical", tutk, None, name,
+                                store))
+        elif ffmpeg_process is not None:
+            sensors.append(Flip("Flip", "switch", "mdi:flip-vertical", tutk,
+                                ffmpeg_process, name, store))
+
+        with self._sensors_lock:
+            for sensor in sensors:
+                self._sensors[sensor.command_topic] = sensor
+            self._camera_sensors[camera.name] = sensors
+            connected = self._connected
 
-        self._sensors[nightvision.command_topic] = nightvision
-        self._sensors[private.command_topic] = private
-        self._sensors[flip.command_topic] = flip
+        # Sensors added before the connection are announced by _on_connect
+        if connected:
+            self._queue_announcement(sensors)
+
+    def restore_camera(self, camera):
+        """
+        Applies the last state of a camera's sensors again, e.g. after the camera
+        reconnected and was reset to its defaults.
+
+        Parameters:
+            camera: Camera object whose sensors are restored.
+
+        Returns:
+            None
+        """
+
+        with self._sensors_lock:
+            sensors = self._camera_sensors.get(camera.name, [])
+            connected = self._connected
+
+        # Before the connection the states are restored by _on_connect
+        if not connected:
+            return
+        for sensor in sensors:
+            # A camera that is reconnecting must not keep the others from their state
+            try:
+                sensor.read_last_state()
+            except Exception as e:  # pylint: disable=broad-except
+                print(f"[mqtt] Restoring {sensor.state_topic} failed: {e!r}")
+            self._publish_state(sensor)
+
+    def _queue_announcement(self, sensors):
+        """
+        Subscribes to the commands of sensors and has the worker announce them,
+        which restores their last state on the camera.
+
+        Parameters:
+            sensors: List of Sensor objects.
+
+        Returns:
+            None
+        """
+
+        for sensor in sensors:
+            self._client.subscribe(sensor.subscribe)
+        with self._work:
+            self._announcements.append(sensors)
+            self._work.notify()
+
+    def _announce(self, sensors):
+        """
+        Publishes the configuration of sensors to Home Assistant, restores their
+        last state and publishes it. Runs on the worker.
+
+        Parameters:
+            sensors: List of Sensor objects.
+
+        Returns:
+            None
+        """
+
+        # Retained, so Home Assistant finds them also when it starts after the proxy
+        for sensor in sensors:
+            self._client.publish(sensor.config_topic, json.dumps(sensor.config_payload),
+                                 qos=1, retain=True)
+
+        # Try to get the last state from sensors
+        print("Retrieving last state from sensors")
+        for sensor in sensors:
+            # A camera that is reconnecting must not keep the others from their state
+            try:
+                sensor.read_last_state()
+            except Exception as e:  # pylint: disable=broad-except
+                print(f"[mqtt] Restoring {sensor.state_topic} failed: {e!r}")
+            self._publish_state(sensor)
+
+    def _publish_state(self, sensor):
+        """
+        Publishes the state of a sensor, retained, unless it was published already.
+
+        Parameters:
+            sensor: Sensor object.
+
+        Returns:
+            None
+        """
+
+        with self._sensors_lock:
+            if self._published.get(sensor.state_topic) == sensor.state_payload:
+                return
+            self._published[sensor.state_topic] = sensor.state_payload
+        self._client.publish(sensor.state_topic, sensor.state_payload, qos=1, retain=True)
 
     def _on_connect(self, client, userdata, flags, rc):
         """
@@ -76,23 +225,12 @@ class LscMqttClient():
 
         if rc == 0:
             print(f"Sucessfully connected to broker: {self._hostname} on port {self._port}")
-            for sensor_command_topic, sensor_object in self._sensors.items():
-                found_sensor = self._sensors[sensor_command_topic]
-                self._client.subscribe(found_sensor.subscribe)
-
-            amount = 3
-            for i in range(amount):
-                for sensor_command_topic, sensor in self._sensors.items():
-                    self._client.publish(sensor.config_topic, json.dumps(sensor.config_payload))
-                time.sleep(1)
-
-            # Try to get the last state from sensors
-            states_dir = "states"
-            if not os.path.exists(states_dir):
-                os.makedirs(states_dir)
-            print("Retrieving last state from sensors")
-            for sensor_command_topic, sensor in self._sensors.items():
-                sensor.read_last_state()
+            with self._sensors_lock:
+                self._connected = True
+                # The broker may have lost the retained states meanwhile
+                self._published.clear()
+                sensors = list(self._sensors.values())
+            self._queue_announcement(sensors)
         else:
             print("Cannot connect to broker. Exit application")
             sys.exit(1)
@@ -113,15 +251,30 @@ class LscMqttClient():
         topic = msg.topic
         payload = msg.payload.decode('utf-8')
 
-        # If a topic is a command_topic from our sensors then handle the data
-        if topic in self._sensors:
-            found_sensor = self._sensors[topic]
-            found_sensor.handle_data(payload)
-            client.publish(found_sensor.state_topic, found_sensor.state_payload)
+        # If a topic is a command_topic from our sensors then queue the data, a
+        # command still waiting for the worker is replaced
+        with self._sensors_lock:
+            found_sensor = self._sensors.get(topic)
+        if found_sensor is not None:
+            with self._work:
+                self._commands[topic] = payload
+                self._work.notify()
+
+    def save_states(self):
+        """
+        Writes the states of the sensors that the state store did not write yet,
+        e.g. at shutdown.
+
+        Returns:
+            None
+        """
+
+        self._state_store.flush()
 
     def start(self):
         """
-        Start the MQTT client loop and handle MQTT interactions.
+        Start the MQTT client loop and apply the queued commands and announcements
+        until the proxy shuts down.
 
         Returns:
             None
@@ -130,7 +283,26 @@ class LscMqttClient():
         self._client.loop_start()
 
         while True:
-            # Send  state to MQTT Server
-            for command_topic, sensor_object in self._sensors.items():
-                self._client.publish(sensor_object.state_topic, sensor_object.state_payload)
-            time.sleep(1)
+            with self._work:
+                while not self._commands and not self._announcements:
+                    self._work.wait()
+                if self._announcements:
+                    sensors = self._announcements.pop(0)
+                    topic = None
+                else:
+                    topic = next(iter(self._commands))
+                    payload = self._commands.pop(topic)
+
+            # A failure must not stop the only thread that applies the commands
+            try:
+                if topic is None:
+                    self._announce(sensors)
+                    continue
+                with self._sensors_lock:
+                    sensor = self._sensors[topic]
+                # Nothing to do if the switch is already in that state
+                if payload != sensor.state_payload:
+                    sensor.handle_data(payload)
+                self._publish_state(sensor)
+            except Exception as e:  # pylint: disable=broad-except
+                print(f"[mqtt] {topic or 'Announcement'} failed: {e!r}")
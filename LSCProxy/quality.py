@@ -0,0 +1,195 @@
+"""
+Quality Control Module.
+
+This module adapts the video quality of a camera to its link. A weak Wi-Fi
+link shows up as lost frames (AV_ER_LOSED_THIS_FRAME), as frames that queue up
+in the SDK, i.e. a growing receive lag, and as a frame rate that drops below
+what the camera delivers on a good link. The controller looks at these over
+windows of a few seconds. After a few bad windows it steps the quality of the
+stream down one level through IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ, and after
+a long run of good windows it steps it up again. The steps up wait longer
+each time one of them had to be taken back quickly, so a marginal link does
+not keep toggling between two levels.
+
+Classes:
+    QualityController: Steps the video quality of one camera down and up.
+
+Author:
+    Berobloom
+"""
+
+import time
+import constants
+
+# Length of a measurement window
+WINDOW_S = 5
+
+# Consecutive bad windows before stepping down, good windows before stepping up
+BAD_WINDOWS = 2
+GOOD_WINDOWS = 12
+
+# A step up that is taken back within this long doubles the good windows the
+# next one needs, up to MAX_GOOD_WINDOWS
+QUICK_STEP_DOWN_S = 60
+MAX_GOOD_WINDOWS = 120
+
+# A window is bad above these values and good below the second ones
+BAD_LOSS_RATE = 0.05
+GOOD_LOSS_RATE = 0.01
+BAD_LAG_MS = 1000
+GOOD_LAG_MS = 300
+# Frame rate relative to the best one of the session
+BAD_FPS_RATIO = 0.6
+GOOD_FPS_RATIO = 0.9
+
+
+class QualityController():
+    """
+    Quality Controller Class.
+
+    Attributes:
+        _camera: Camera whose quality is controlled.
+        _best: Best quality level the controller sets, AVIOCTRL_QUALITY_MAX is 1.
+        _worst: Worst quality level the controller sets, AVIOCTRL_QUALITY_MIN is 5.
+        _window_start: Monotonic time the current window started, None before the first.
+        _last: Video counters at the start of the window.
+        _best_fps: Highest frame rate of a window in this session.
+        _bad: Consecutive bad windows.
+        _good: Consecutive good windows.
+        _good_needed: Good windows the next step up needs.
+        _stepped_up_at: Monotonic time of the last step up, or None.
+
+    Methods:
+        __init__(self, camera, best, worst): Initializes the controller.
+        reset(self): Starts over after a reconnect.
+        poll(self): Evaluates the window once it is over, call about once a second.
+        _evaluate(self, frames, lost, lag_ms, elapsed): Classifies a window.
+        _step(self, level): Sets the quality level on the camera.
+    """
+
+    def __init__(self, camera, best=constants.video_quality["AVIOCTRL_QUALITY_HIGH"],
+                 worst=constants.video_quality["AVIOCTRL_QUALITY_MIN"]):
+        self._camera = camera
+        self._best = best
+        self._worst = max(best, worst)
+        self._window_start = None
+        self._last = None
+        self._best_fps = 0
+        self._bad = 0
+        self._good = 0
+        self._good_needed = GOOD_WINDOWS
+        self._stepped_up_at = None
+        camera.tutk.quality = best
+        camera.metrics.quality = best
+
+    def reset(self):
+        """
+        Starts the measurement over, e.g. after a reconnect. The camera keeps the
+        level, start_ipcam_stream sets it again.
+
+        Returns:
+            None
+        """
+
+        self._window_start = None
+        self._bad = 0
+        self._good = 0
+
+    def poll(self):
+        """
+        Evaluates the current window once it is over and steps the quality if
+        needed. Call it about once a second while the camera streams.
+
+        Returns:
+            None
+        """
+
+        now = time.monotonic()
+        _, streams = self._camera.metrics.values()
+        video = streams["video"]
+        counters = (video["frames"], video["lost"])
+        if self._window_start is None:
+            self._window_start = now
+            self._last = counters
+            return
+        elapsed = now - self._window_start
+        if elapsed < WINDOW_S:
+            return
+
+        frames = counters[0] - self._last[0]
+        lost = counters[1] - self._last[1]
+        self._window_start = now
+        self._last = counters
+        verdict = self._evaluate(frames, lost, video["lag_ms"], elapsed)
+
+        level = self._camera.tutk.quality
+        if verdict == "bad":
+            self._good = 0
+            self._bad += 1
+            if self._bad >= BAD_WINDOWS and level < self._worst:
+                if self._stepped_up_at is not None and \
+                        now - self._stepped_up_at < QUICK_STEP_DOWN_S:
+                    self._good_needed = min(self._good_needed * 2, MAX_GOOD_WINDOWS)
+                self._stepped_up_at = None
+                self._step(level + 1)
+        elif verdict == "good":
+            self._bad = 0
+            self._good += 1
+            if self._good >= self._good_needed and level > self._best:
+                self._stepped_up_at = now
+                self._step(level - 1)
+        else:
+            self._bad = 0
+            self._good = 0
+
+    def _evaluate(self, frames, lost, lag_ms, elapsed):
+        """
+        Classifies a window by its loss rate, receive lag and frame rate.
+
+        Args:
+            frames (int): Frames received in the window.
+            lost (int): Frames lost in the window.
+            lag_ms (int): Receive lag of the last frame.
+            elapsed (float): Length of the window in seconds.
+
+        Returns:
+            str: "bad", "good", or "fair" for neither.
+        """
+
+        fps = frames / elapsed
+        if frames == 0 and lost == 0:
+            # The camera is idle or reconnecting, nothing to learn from
+            return "fair"
+        self._best_fps = max(self._best_fps, fps)
+        loss_rate = lost / (frames + lost)
+        fps_ratio = fps / self._best_fps
+
+        if loss_rate > BAD_LOSS_RATE or lag_ms > BAD_LAG_MS or fps_ratio < BAD_FPS_RATIO:
+            return "bad"
+        if loss_rate < GOOD_LOSS_RATE and lag_ms < GOOD_LAG_MS and fps_ratio >= GOOD_FPS_RATIO:
+            return "good"
+        return "fair"
+
+    def _step(self, level):
+        """
+        Sets the quality level on the camera, and in the counters once it is applied.
+
+        Args:
+            level (int): The new quality level.
+
+        Returns:
+            None
+        """
+
+        self._bad = 0
+        self._good = 0
+        direction = "down" if level > self._camera.tutk.quality else "up"
+        print(f"[{self._camera.name}] Link quality {direction}, "
+              f"video quality {self._camera.tutk.quality} -> {level}")
+        if self._camera.tutk.ioctrl_set_quality(level):
+            self._camera.tutk.quality = level
+            self._camera.metrics.quality = level
+        else:
+            print(f"[{self._camera.name}] Camera rejected video quality {level}")
+        # The frame rate of another level is not comparable
+        self._best_fps = 0
@@ -0,0 +1,223 @@
+"""
+Frame Ring
+
+This module provides the queue between a receive thread and the thread that
+writes its frames to the FIFO. It mirrors FrameRing in libs/framepump.
+
+Every slot is a buffer allocated up front, and the TUTK framework receives
+straight into the slot, so queueing a frame neither allocates nor copies. A frame
+that does not fit is dropped by the SDK, after it the ring grows its buffers to
+the next of the block sizes of FramePool in libs/framepump. A batched receive
+fills several free slots at once, the frames that are dropped leave their slot to
+the next commit. The receive thread keeps the SDK drained while the writer is
+blocked on a full FIFO or on ffmpeg opening it.
+There is one producer and one consumer, and each index is only written by one of
+them, so the ring needs no lock. The condition is only used to put an idle writer
+to sleep.
+
+Author:
+    Berobloom
+"""
+
+import threading
+
+RING_POLICIES = ("drop", "block")
+
+# Block sizes of FramePool, 1 KiB in steps of four up to 4 MiB
+MIN_BLOCK_SIZE = 1024
+MAX_BLOCK_SIZE = 4 * 1024 * 1024
+
+
+def block_size(size):
+    """
+    Returns the size of the smallest block that holds size bytes.
+
+    Args:
+        size (int): Size of a frame.
+
+    Returns:
+        int: The block size, at most MAX_BLOCK_SIZE.
+    """
+
+    block = MIN_BLOCK_SIZE
+    while block < size and block < MAX_BLOCK_SIZE:
+        block *= 4
+    return block
+
+
+class FrameRing():
+    """
+    Single producer, single consumer ring of frames.
+
+    Attributes:
+        block: True if the receive thread waits for room, False if it drops frames.
+        _tutk: The TUTK framework instance the buffers are created with.
+        _frame_size: Size every buffer handed to the producer has at least.
+        _buffers: Preallocated ctypes buffers, one per slot.
+        _views: Memoryviews of the buffers.
+        _sizes: Size of the frame in every slot.
+        _head: Number of frames queued so far, written by the producer only.
+        _tail: Number of frames written so far, written by the consumer only.
+        _wakeup: Condition the idle consumer waits on.
+        _closed: True once close() was called.
+
+    Methods:
+        __init__(self, tutk, capacity, frame_size, policy): Allocates the slots.
+        grow(self, size): Makes room for frames of size bytes.
+        acquire(self, count): Returns the buffers to receive the next frames into.
+        commit(self, size, index): Queues the frame in an acquired buffer.
+        front(self): Returns the oldest queued frame.
+        release(self): Hands the slot of the oldest frame back.
+        wait(self, timeout): Waits until a frame is queued.
+        close(self): Wakes up the consumer for good.
+    """
+
+    def __init__(self, tutk, capacity, frame_size, policy="drop"):
+        if capacity <= 0:
+            raise ValueError("Ring capacity must be positive")
+        if policy not in RING_POLICIES:
+            raise ValueError(f"Ring policy must be one of {', '.join(RING_POLICIES)}")
+
+        self.block = policy == "block"
+        self._tutk = tutk
+        self._frame_size = frame_size
+        self._buffers = [tutk.create_buf(frame_size) for _ in range(capacity)]
+        self._views = [memoryview(buf) for buf in self._buffers]
+        self._sizes = [0] * capacity
+        self._head = 0
+        self._tail = 0
+        self._wakeup = threading.Condition()
+        self._closed = False
+
+    @property
+    def closed(self):
+        """
+        Whether close() was called.
+
+        Returns:
+            bool: True once the ring is closed.
+        """
+
+        return self._closed
+
+    @property
+    def frame_size(self):
+        """
+        Size of the buffers returned by acquire().
+
+        Returns:
+            int: The size in bytes.
+        """
+
+        return self._frame_size
+
+    def grow(self, size):
+        """
+        Makes room for frames of size bytes, after the SDK dropped one that did
+        not fit. The free slots get their larger buffer when they are acquired.
+
+        Args:
+            size (int): Size of the frame that did not fit.
+
+        Returns:
+            int: The new size of the buffers.
+        """
+
+        self._frame_size = max(self._frame_size, block_size(size))
+        return self._frame_size
+
+    def acquire(self, count=1):
+        """
+        Returns the buffers to receive the next frames into.
+
+        Args:
+            count (int): Maximum number of buffers.
+
+        Returns:
+            list: The buffers of the free slots in order, empty if the ring is full.
+        """
+
+        capacity = len(self._buffers)
+        free = min(count, capacity - (self._head - self._tail))
+        slots = [(self._head + i) % capacity for i in range(free)]
+        for slot in slots:
+            # Only the producer touches the free slots
+            if len(self._buffers[slot]) < self._frame_size:
+                self._buffers[slot] = self._tutk.create_buf(self._frame_size)
+                self._views[slot] = memoryview(self._buffers[slot])
+        return [self._buffers[slot] for slot in slots]
+
+    def commit(self, size, index=0):
+        """
+        Queues a frame received into one of the buffers returned by acquire().
+
+        Args:
+            size (int): Size of the frame.
+            index (int): Position of the buffer among those not committed yet. The
+                frames before it were dropped and their buffers are reused.
+
+        Returns:
+            None
+        """
+
+        capacity = len(self._buffers)
+        slot = self._head % capacity
+        if index:
+            # The slots are free and only the producer touches them, so the
+            # buffer of the frame can simply trade places with the dropped one
+            other = (self._head + index) % capacity
+            self._buffers[slot], self._buffers[other] = self._buffers[other], self._buffers[slot]
+            self._views[slot], self._views[other] = self._views[other], self._views[slot]
+        self._sizes[slot] = size
+        with self._wakeup:
+            self._head += 1
+            self._wakeup.notify()
+
+    def front(self):
+        """
+        Returns the oldest queued frame. It stays valid until release().
+
+        Returns:
+            memoryview: The frame, or None if the ring is empty.
+        """
+
+        if self._tail == self._head:
+            return None
+        slot = self._tail % len(self._buffers)
+        return self._views[slot][:self._sizes[slot]]
+
+    def release(self):
+        """
+        Hands the slot of the frame returned by front() back to the producer.
+
+        Returns:
+            None
+        """
+
+        self._tail += 1
+
+    def wait(self, timeout):
+        """
+        Waits until a frame is queued, the ring is closed or the timeout passes.
+
+        Args:
+            timeout (float): Maximum time to wait in seconds.
+
+        Returns:
+            None
+        """
+
+        with self._wakeup:
+            self._wakeup.wait_for(lambda: self._tail != self._head or self._closed, timeout)
+
+    def close(self):
+        """
+        Wakes up the consumer, and keeps waking it up from now on.
+
+        Returns:
+            None
+        """
+
+        with self._wakeup:
+            self._closed = True
+            self._wakeup.notify_all()
@@ -14,7 +14,8 @@ class Sensor:
         _device_type: Type of the device (e.g., switch).
         _friendly_name: User-friendly name of the sensor.
         _ffmpeg_process: Instance of the FFMPEG class.
-        _safe_name: Sanitized and lowercased name of the sensor.
+        _safe_name: Sanitized and lowercased name of the sensor, prefixed with the
+            camera name when the proxy serves several cameras.
         _topic: MQTT topic associated with the sensor.
         _subscribe: MQTT topic used for subscribing to sensor commands.
         _config_topic: MQTT topic for sending sensor configuration to Home Assistant.
@@ -23,16 +24,16 @@ class Sensor:
         _command_topic: MQTT topic for receiving commands from Home Assistant.
         _config_payload: Payload containing sensor configuration for Home Assistant.
         _payload_dict: Dictionary mapping payload values to boolean states.
+        _state_store: StateStore the state is saved in, shared by all sensors.
 
     Methods:
-        __init__(self, name, device_type, icon, on_behavior, off_behavior, tutk,
-            sensor_dict, ffmpeg_process):
-            Initializes the Sensor object.
+        __init__(self, name, device_type, icon, tutk, ffmpeg_process, camera_name,
+            state_store): Initializes the Sensor object.
         handle_data(self, payload): Handles incoming
             commands from Home Assistant specific to switches.
         toggle_switch(self, enable): Toggles the switch based on the given enable state.
-        save_state(self): Saves the current state of the sensor to a file.
-        read_last_state(self): Reads the last saved state of the sensor from a file.
+        save_state(self): Saves the current state of the sensor in the state store.
+        read_last_state(self): Reads and applies the last saved state of the sensor.
 
     Properties:
         command_topic: Getter for the command topic.
@@ -44,13 +45,23 @@ class Sensor:
         state_payload: Getter for the state payload.
     """
 
-    def __init__(self, name, device_type, icon, tutk, ffmpeg_process):
+    def __init__(self, name, device_type, icon, tutk, ffmpeg_process, camera_name=None,
+                 state_store=None):
         self._tutk = tutk
+        self._state_store = state_store
         self._device_type = device_type
         self._friendly_name = name
         self._ffmpeg_process = ffmpeg_process
 
+        # Every camera is its own Home Assistant device
+        device_id = "02LSC02"
+        device_name = "LSC Indoor Camera"
         self._safe_name = name.replace(" ", "").lower()
+        if camera_name is not None:
+            device_id = f"02LSC02{camera_name}"
+            device_name = f"LSC Indoor Camera {camera_name}"
+            self._safe_name = f"{camera_name.lower()}_{self._safe_name}"
+
         self._topic = f"homeassistant/{device_type}/{self._safe_name}"
         self._subscribe = f"{self._topic}/#"
         self._config_topic = f"{self._topic}/config"
@@ -66,11 +77,11 @@ class Sensor:
             "unique_id": f"{self._safe_name}{device_type}02LSC02",
             "device": {
                 "identifiers": [
-                    "02LSC02"
+                    device_id
                 ],
                 "manufacturer": "LSC",
                 "model": "LSC Smart Connect Indoor Camera",
-                "name": "LSC Indoor Camera"
+                "name": device_name
             }
         }
         if device_type == "switch":
@@ -83,7 +94,8 @@ class Sensor:
 
     def handle_data(self, payload):
         """
-        Handles incoming commands from Home Assistant specific to switches.
+        Handles incoming commands from Home Assistant specific to switches. The
+        state only changes if the camera did not reject the command.
 
         Parameters:
             payload: Payload received from Home Assistant.
@@ -95,12 +107,12 @@ class Sensor:
         if self._device_type == "switch":
             for key, value in self._payload_dict.items():
                 if payload == key:
-                    self._toggle_switch(value)
-                    self._state_payload = payload
-                    self.save_state()
+                    if self.toggle_switch(value) is not False:
+                        self._state_payload = payload
+                        self.save_state()
                     break
 
-    def _toggle_switch(self, enable):
+    def toggle_switch(self, enable):
         """
         Toggles the switch based on the given enable state.
 
@@ -108,7 +120,7 @@ class Sensor:
             enable: Boolean value representing the desired state of the switch.
 
         Returns:
-            None
+            False if the camera rejected the command, anything else otherwise.
         """
 
         if self._device_type == "switch":
@@ -121,52 +133,34 @@ class Sensor:
 
     def save_state(self):
         """
-        Saves the current state of the sensor to a file.
+        Saves the current state of the sensor in the state store, which writes it
+        to disk a moment later.
 
         Returns:
             None
         """
 
-        file = f"states/{self._safe_name}"
-
-        try:
-            f = open(file, "x", encoding="utf-8")
-        except:
-            pass
-
-        f = open(file, "r", encoding="utf-8")
-
-        contents = f.read()
-        if contents != self._state_payload:
-            f = open(file, "w", encoding="utf-8")
-            f.write(self._state_payload)
-            f.close()
+        if self._state_store is not None:
+            self._state_store.set(self._safe_name, self._state_payload)
 
     def read_last_state(self):
         """
-        Reads the last saved state of the sensor from a file.
+        Reads the last saved state of the sensor from the state store and applies it.
 
         Returns:
             None
         """
 
-        file = f"states/{self._safe_name}"
-
-        try:
-            f = open(file, "x", encoding="utf-8")
-        except:
-
-            pass
-
-        f = open(file, "r", encoding="utf-8")
+        if self._state_store is None:
+            return
 
-        contents = f.read()
+        contents = self._state_store.get(self._safe_name)
         if contents in self._payload_dict:
             if self._device_type == "switch":
                 if contents == "ON":
-                    self._toggle_switch(True)
+                    self.toggle_switch(True)
                 if contents == "OFF":
-                    self._toggle_switch(False)
+                    self.toggle_switch(False)
                 self._state_payload = contents
 
     @property
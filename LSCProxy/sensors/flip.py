@@ -7,6 +7,10 @@ from sensor import Sensor
 class Flip(Sensor):
     """
     Flip sensor class.
+
+    The camera flips the image itself, so toggling does not interrupt the stream.
+    When the sensor is given an FFMPEG process, the image is flipped by an ffmpeg
+    filter instead, which restarts ffmpeg, for firmware that ignores the request.
     """
 
     def toggle_switch(self, enable):
@@ -17,29 +21,29 @@ class Flip(Sensor):
             enable: Boolean value representing the desired state of the switch.
 
         Returns:
-            None
+            bool: False if the camera rejected the command.
         """
 
         if self._device_type == "switch":
             if enable:
-                self.on()
-            else:
-                self.off()
+                return self.on()
+            return self.off()
+        return None
 
     def on(self):
         """
-        Enable video flipping and restart the FFMPEG process.
+        Enable video flipping.
         """
 
-        if not self._ffmpeg_process.is_flipped:
-            self._ffmpeg_process.enable_flip()
-            self._ffmpeg_process.restart()
+        if self._ffmpeg_process is None:
+            return self._tutk.ioctrl_enable_flip()
+        return self._ffmpeg_process.enable_flip()
 
     def off(self):
         """
-        Disable video flipping and restart the FFMPEG process.
+        Disable video flipping.
         """
 
-        if self._ffmpeg_process.is_flipped:
-            self._ffmpeg_process.disable_flip()
-            self._ffmpeg_process.restart()
+        if self._ffmpeg_process is None:
+            return self._tutk.ioctrl_disable_flip()
+        return self._ffmpeg_process.disable_flip()
@@ -17,25 +17,25 @@ class Nightvision(Sensor):
             enable: Boolean value representing the desired state of the switch.
 
         Returns:
-            None
+            bool: False if the camera rejected the command.
         """
 
         if self._device_type == "switch":
             if enable:
-                self.on()
-            else:
-                self.off()
+                return self.on()
+            return self.off()
+        return None
 
     def on(self):
         """
         Enable night vision.
         """
 
-        self._tutk.ioctrl_enable_nightvision()
+        return self._tutk.ioctrl_enable_nightvision()
 
     def off(self):
         """
         Disable night vision.
         """
 
-        self._tutk.ioctrl_disable_nightvision()
+        return self._tutk.ioctrl_disable_nightvision()
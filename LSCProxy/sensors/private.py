@@ -7,8 +7,19 @@ from sensor import Sensor
 class Private(Sensor):
     """
     Private sensor class.
+
+    The switch stops the camera and records that in tutk.private, so that the
+    on demand mode does not start the camera again for a reader. The state is
+    taken from the state store right away, before the MQTT client connects.
     """
 
+    def __init__(self, name, device_type, icon, tutk, ffmpeg_process, camera_name=None,
+                 state_store=None):
+        super().__init__(name, device_type, icon, tutk, ffmpeg_process, camera_name,
+                         state_store)
+        if state_store is not None:
+            tutk.private = state_store.get(self._safe_name) == "ON"
+
     def toggle_switch(self, enable):
         """
         Toggles the switch based on the given enable state.
@@ -17,25 +28,31 @@ class Private(Sensor):
             enable: Boolean value representing the desired state of the switch.
 
         Returns:
-            None
+            bool: False if the camera rejected the command.
         """
 
         if self._device_type == "switch":
             if enable:
-                self.on()
-            else:
-                self.off()
+                return self.on()
+            return self.off()
+        return None
 
     def on(self):
         """
         Enable private.
         """
 
-        self._tutk.ioctrl_stop_camera()
+        status = self._tutk.ioctrl_stop_camera()
+        if status is not False:
+            self._tutk.private = True
+        return status
 
     def off(self):
         """
         Disable private.
         """
 
-        self._tutk.ioctrl_start_camera()
+        status = self._tutk.ioctrl_start_camera()
+        if status is not False:
+            self._tutk.private = False
+        return status
@@ -8,26 +8,47 @@ Classes:
     Process: Wrapper class for subprocess.Popen,
     providing consistent process execution and termination.
     RTSPServer: Encapsulates the functionality to start and stop the RTSP server.
+    RTPPublisher: Encapsulates the native publisher that feeds the RTSP server directly.
     FFMPEG: Encapsulates the functionality to start, stop, and restart the FFMPEG process.
 
 Attributes:
-    AUDIO_FIFO_PATH: Path to the audio FIFO.
-    VIDEO_FIFO_PATH: Path to the video FIFO.
     MEDIAMTX_PATH: Path to the mediamtx command.
 
 Note:
     This module assumes the existence of the following global variables:
-    - AUDIO_FIFO_PATH: Path to the audio FIFO.
-    - VIDEO_FIFO_PATH: Path to the video FIFO.
     - MEDIAMTX_PATH: Path to the mediamtx command.
+
+    One RTSP server serves every camera, each camera publishes to its own path.
 """
 
 import subprocess
 import signal
+import socket
 import sys
 import os
 import threading
+import time
+from urllib.parse import urlsplit
 import constants
+import encoders
+
+# Readers wait this long for the camera to wake up in the on demand mode
+DEMAND_START_TIMEOUT_S = 20
+
+# Longest the publishers wait for mediamtx to bind its port
+RTSP_READY_TIMEOUT_S = 10
+
+# ffmpeg demuxer of the audio FIFO per FrameInfoT.codec_id, and what the audio
+# is published as without a transcode. PCM is only byte swapped to L16.
+AUDIO_FORMATS = {
+    constants.audio_codec["MEDIA_CODEC_AUDIO_PCM"]: (
+        ["-f", "s16le", "-ar", "8000", "-ac", "1"], "pcm_s16be"),
+    constants.audio_codec["MEDIA_CODEC_AUDIO_G711U"]: (
+        ["-f", "mulaw", "-ar", "8000", "-ac", "1"], "copy"),
+    constants.audio_codec["MEDIA_CODEC_AUDIO_G711A"]: (
+        ["-f", "alaw", "-ar", "8000", "-ac", "1"], "copy"),
+    constants.audio_codec["MEDIA_CODEC_AUDIO_AAC"]: (["-f", "aac"], "copy"),
+}
 
 
 class Process():
@@ -64,6 +85,7 @@ class Process():
             try:
                 with subprocess.Popen(
                     self.process_object.command,
+                    env=getattr(self.process_object, "env", None),
                     stdin=subprocess.DEVNULL,
                     stdout=sys.stdout,
                     stderr=sys.stderr,
@@ -91,7 +113,11 @@ class Process():
         """
 
         if self.pid is not None:
-            os.kill(self.pid, signal.SIGKILL)
+            try:
+                os.kill(self.pid, signal.SIGKILL)
+            except ProcessLookupError:
+                # Already gone, e.g. Ctrl+C reached the whole process group
+                pass
 
 
 class RTSPServer():
@@ -99,23 +125,58 @@ class RTSPServer():
     RTSP Server Wrapper Class.
 
     This class encapsulates the functionality to start and stop the RTSP server
-    using the mediamtx command.
+    using the mediamtx command. mediamtx publishes a low resolution substream of
+    every path on demand, its ffmpeg gets the settings and the video encoder
+    through the environment.
+    In the on demand mode the runOnDemand and runOnUnDemand hooks of the camera
+    paths are set through the environment as well, they report the readers to
+    the demand_url of the proxy.
 
     Attributes:
         name: Name of the RTSP server process.
         command: Command to start the RTSP server.
+        env: Environment of the RTSP server process and its runOnDemand commands.
         process: Instance of the Process class for managing the RTSP server process.
+        ready: Event set once the RTSP server accepts connections.
 
     Methods:
-        __init__(self): Initializes the RTSPServer object with default settings.
+        __init__(self, substream_height, substream_fps, substream_bitrate, demand_url,
+            demand_grace_s, encoder): Initializes the RTSPServer object with the settings
+            of the substreams and of the on demand mode.
         start(self): Starts the RTSP server process.
         stop(self): Stops the RTSP server process.
+        wait_ready(self, timeout_s): Waits until the RTSP server accepts connections.
     """
 
-    def __init__(self):
+    def __init__(self, substream_height=360, substream_fps=5, substream_bitrate="300k",
+                 demand_url=None, demand_grace_s=30, encoder=None):
+        if encoder is None:
+            encoder = encoders.ENCODERS["libx264"]
         self.name = "mediamtx"
         self.command = [constants.settings["MEDIAMTX_PATH"], "rtsp/mediamtx.yml"]
+        self.env = dict(os.environ)
+        self.env.update({
+            "LSC_SUB_HEIGHT": str(substream_height),
+            "LSC_SUB_FPS": str(substream_fps),
+            "LSC_SUB_BITRATE": str(substream_bitrate),
+            # A keyframe every 2 seconds
+            "LSC_SUB_GOP": str(max(1, int(2 * substream_fps))),
+            # Split into arguments by the shell of runOnDemand
+            "LSC_SUB_DEVICE": " ".join(encoder.device_args),
+            "LSC_SUB_UPLOAD": f",{encoder.upload}" if encoder.upload else "",
+            "LSC_SUB_VCODEC": " ".join(encoder.codec_args),
+        })
+        if demand_url is not None:
+            # Overrides of pathDefaults, the substreams keep their own runOnDemand
+            hook = f"sh -c 'curl -fsS -o /dev/null \"{demand_url}?path=$MTX_PATH&state=%s\"'"
+            self.env.update({
+                "MTX_PATHDEFAULTS_RUNONDEMAND": hook % "start",
+                "MTX_PATHDEFAULTS_RUNONUNDEMAND": hook % "stop",
+                "MTX_PATHDEFAULTS_RUNONDEMANDSTARTTIMEOUT": f"{DEMAND_START_TIMEOUT_S}s",
+                "MTX_PATHDEFAULTS_RUNONDEMANDCLOSEAFTER": f"{demand_grace_s}s",
+            })
         self.process = Process(self)
+        self.ready = threading.Event()
 
     def start(self):
         """
@@ -137,6 +198,96 @@ class RTSPServer():
 
         self.process.stop()
 
+    def wait_ready(self, timeout_s=RTSP_READY_TIMEOUT_S):
+        """
+        Waits until the RTSP server accepts connections on its port, so the
+        publishers do not connect before mediamtx has bound it.
+
+        Args:
+            timeout_s (float): How long to wait.
+
+        Returns:
+            bool: True once the server is ready, False if it is not in time.
+        """
+
+        url = urlsplit(constants.settings["RTSP_BASE_URL"])
+        address = (url.hostname, url.port or 554)
+        deadline = time.monotonic() + timeout_s
+        while not self.ready.is_set():
+            try:
+                with socket.create_connection(address, timeout=0.5):
+                    self.ready.set()
+            except OSError:
+                if time.monotonic() >= deadline:
+                    return False
+                time.sleep(0.05)
+        return True
+
+
+class RTPPublisher():
+    """
+    RTP Publisher Wrapper Class.
+
+    This class encapsulates the RTP publisher of the native frame pump. It packetizes
+    the camera's streams and publishes them to the RTSP server straight from the receive
+    threads, which replaces the FIFOs and the FFMPEG process.
+
+    Attributes:
+        name: Name of the publisher.
+        url: RTSP URL the streams are published to.
+        _pump: Instance of the FramePump class receiving the streams.
+
+    Methods:
+        __init__(self, pump, url): Initializes the RTPPublisher object.
+        start(self): Starts receiving and publishing the streams.
+        stop(self): Stops receiving and publishing the streams.
+        set_standby(self, standby): Stops or resumes publishing while the streams are
+            still received.
+    """
+
+    def __init__(self, pump, url):
+        self.name = "publisher"
+        self.url = url
+        self._pump = pump
+
+    def start(self):
+        """
+        Start receiving and publishing the streams.
+
+        Returns:
+            bool: True if the publisher was started, False otherwise.
+        """
+
+        if not self._pump.start_publisher(self.url):
+            print(f"{self.name} cannot be started")
+            return False
+
+        return True
+
+    def stop(self):
+        """
+        Stop receiving and publishing the streams.
+
+        Returns:
+            None
+        """
+
+        self._pump.stop()
+
+    def set_standby(self, standby):
+        """
+        Stops publishing while no one reads the streams, or resumes at the next
+        keyframe. The RTSP server sees no publisher in the meantime.
+
+        Args:
+            standby (bool): True to stop publishing, False to resume.
+
+        Returns:
+            None
+        """
+
+        self._pump.set_standby(standby)
+
 
 class FFMPEG():
     """
@@ -148,38 +299,77 @@ class FFMPEG():
         name: Name of the FFMPEG process.
         command: Command to start the FFMPEG process.
         is_flipped: Flag indicating if video output is flipped.
+        passthrough: Flag indicating if the camera's H.264 is remuxed without re-encoding
+            whenever no video filter is needed.
+        audio_codec: FrameInfoT.codec_id of the audio in the audio FIFO.
+        audio_transcode: Flag indicating if the audio is re-encoded to AAC instead of
+            published in the codec of the camera.
+        encoder: Encoder the video is re-encoded with when it has to be.
+        video_fifo: Path to the video FIFO.
+        audio_fifo: Path to the audio FIFO.
+        url: RTSP URL the streams are published to.
         _process: Instance of the Process class for managing the FFMPEG process.
 
     Methods:
-        __init__(self): Initializes the FFMPEG object with default settings.
+        __init__(self, video_fifo, audio_fifo, url, passthrough, audio_codec,
+            audio_transcode, encoder): Initializes the FFMPEG object for the FIFOs of
+            one camera.
         start(self): Starts the FFMPEG process.
         stop(self): Stops the FFMPEG process.
         restart(self): Restarts the FFMPEG process.
-        enable_flip(self): Enables video flipping and restarts the FFMPEG process.
-        disable_flip(self): Disables video flipping and restarts the FFMPEG process.
+        enable_flip(self): Enables the flip filter and restarts the FFMPEG process once.
+        disable_flip(self): Disables the flip filter and restarts the FFMPEG process once.
     """
 
     def _ffmpeg_command_builder(self, video_filter=None):
-        command = [
-            "ffmpeg", "-re", "-hide_banner",
-            "-thread_queue_size", "4096", "-f", "s16le", "-ar", "8000", "-ac", "1", "-i",
-            constants.settings["AUDIO_FIFO_PATH"],
-            "-thread_queue_size", "4096", "-f", "h264", "-i",
-            constants.settings["VIDEO_FIFO_PATH"],
+        pcm = constants.audio_codec["MEDIA_CODEC_AUDIO_PCM"]
+        audio_input, audio_output = AUDIO_FORMATS.get(self.audio_codec, AUDIO_FORMATS[pcm])
+        transcode = video_filter is not None or not self.passthrough
+        # The FIFOs deliver the frames as the camera sends them, so ffmpeg needs no
+        # wall clock pacing with -re
+        command = ["ffmpeg", "-hide_banner"]
+        if transcode:
+            command.extend(self.encoder.device_args)
+        command += [
+            "-thread_queue_size", "4096", *audio_input, "-i",
+            str(self.audio_fifo),
+            # Raw H.264 carries no timestamps, so let the demuxer generate them
+            "-thread_queue_size", "4096", "-fflags", "+genpts", "-f", "h264", "-i",
+            str(self.video_fifo),
         ]
 
-        if video_filter is not None:
-            command.extend(["-vf", video_filter])
+        if transcode and self.encoder.video_filter(video_filter) is not None:
+            command.extend(["-vf", self.encoder.video_filter(video_filter)])
+
+        if self.audio_transcode:
+            command.extend(["-c:a", "aac", "-b:a", "32000", "-async", "1"])
+        elif audio_output == "copy":
+            command.extend(["-c:a", "copy"])
+        else:
+            command.extend(["-c:a", audio_output, "-async", "1"])
+
+        if not transcode:
+            # The camera already delivers H.264, forward the NAL units as they are
+            command.extend(["-c:v", "copy"])
+        else:
+            command.extend(self.encoder.video_args())
 
         command.extend([
-            "-c:a", "aac", "-b:a", "32000", "-c:v", "libx264", "-preset",
-            "ultrafast", "-tune", "zerolatency", "-async", "1",
-            "-f", "rtsp", "-rtsp_transport", "tcp", "rtsp://localhost:8554/stream"
+            "-f", "rtsp", "-rtsp_transport", "tcp", self.url
         ])
         return command
 
-    def __init__(self):
+    def __init__(self, video_fifo, audio_fifo, url, passthrough=True,
+                 audio_codec=constants.audio_codec["MEDIA_CODEC_AUDIO_PCM"],
+                 audio_transcode=False, encoder=None):
         self.name = "ffmpeg"
+        self.encoder = encoder if encoder is not None else encoders.ENCODERS["libx264"]
+        self.passthrough = passthrough
+        self.audio_codec = audio_codec
+        self.audio_transcode = audio_transcode
+        self.video_fifo = video_fifo
+        self.audio_fifo = audio_fifo
+        self.url = url
         self.command = self._ffmpeg_command_builder()
         self.is_flipped = False
 
@@ -251,6 +441,6 @@ class FFMPEG():
         """
 
         if self.is_flipped:
-            self.command = self.command = self._ffmpeg_command_builder()
+            self.command = self._ffmpeg_command_builder()
             self.is_flipped = False
             self.restart()
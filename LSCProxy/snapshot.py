@@ -0,0 +1,160 @@
+"""
+Snapshot Module.
+
+This module serves JPEG snapshots of the cameras on /snapshot.jpg. A snapshot is
+the last keyframe cached by the native frame pump, decoded by ffmpeg. The JPEG is
+kept until the camera sends the next keyframe, so there is one decode per GOP
+however many clients poll, and no RTSP session is opened for it.
+
+Classes:
+    Snapshot: The snapshot of one camera.
+    SnapshotRoute: Serves /snapshot.jpg for the cameras.
+
+Author:
+    Berobloom
+"""
+
+import subprocess
+import threading
+
+# How long ffmpeg may take to decode a keyframe
+DECODE_TIMEOUT_S = 5
+
+
+def decode_jpeg(keyframe, height=0):
+    """
+    Decodes an H.264 keyframe into a JPEG with ffmpeg.
+
+    Args:
+        keyframe (bytes): The keyframe with its SPS and PPS in Annex B format.
+        height (int): Height to scale the picture to, 0 keeps the camera's size.
+
+    Returns:
+        bytes: The JPEG, or None if ffmpeg failed.
+    """
+
+    command = ["ffmpeg", "-hide_banner", "-loglevel", "error",
+               "-f", "h264", "-i", "pipe:0", "-frames:v", "1"]
+    if height:
+        command.extend(["-vf", f"scale=-2:{height}"])
+    command.extend(["-f", "image2", "-c:v", "mjpeg", "-q:v", "3", "pipe:1"])
+    try:
+        result = subprocess.run(command, input=keyframe, capture_output=True,
+                                timeout=DECODE_TIMEOUT_S, check=True)
+    except (OSError, subprocess.SubprocessError) as e:
+        print(f"[snapshot] Cannot decode the keyframe: {e}")
+        return None
+    return result.stdout or None
+
+
+class Snapshot():
+    """
+    Snapshot Class.
+
+    Attributes:
+        height: Height of the JPEG, 0 for the camera's size.
+        _pump: FramePump whose keyframe cache is decoded, or None.
+        _lock: Keeps the pump from being freed while its keyframe is read.
+        _decode_lock: Lets one request decode while the others wait for its JPEG.
+        _sequence: Number of the keyframe the JPEG was decoded from.
+        _jpeg: The last JPEG, or None.
+
+    Methods:
+        __init__(self, height): Initializes the snapshot.
+        attach_pump(self, pump): Takes the snapshots from the pump's keyframe cache.
+        detach_pump(self): Stops reading from the pump before it is freed.
+        jpeg(self): Returns the JPEG of the last keyframe.
+    """
+
+    def __init__(self, height=0):
+        self.height = height
+        self._pump = None
+        self._lock = threading.Lock()
+        self._decode_lock = threading.Lock()
+        self._sequence = 0
+        self._jpeg = None
+
+    def attach_pump(self, pump):
+        """
+        Takes the snapshots from the keyframe cache of the native frame pump.
+
+        Args:
+            pump (FramePump): The pump receiving the streams of the camera.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            self._pump = pump
+
+    def detach_pump(self):
+        """
+        Stops reading from the pump, call before the pump is stopped.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            self._pump = None
+
+    def jpeg(self):
+        """
+        Returns the JPEG of the last keyframe, decoding it if it is a new one.
+
+        Returns:
+            bytes: The JPEG, or None if no keyframe has been received.
+        """
+
+        with self._decode_lock:
+            with self._lock:
+                if self._pump is None:
+                    return None
+                sequence, keyframe = self._pump.keyframe()
+
+            if keyframe is None:
+                return None
+            if sequence != self._sequence or self._jpeg is None:
+                self._jpeg = decode_jpeg(keyframe, self.height)
+                self._sequence = sequence
+            return self._jpeg
+
+
+class SnapshotRoute():
+    """
+    Snapshot Route Class.
+
+    Attributes:
+        _cameras: Dictionary of camera name to Camera.
+        _default: Name of the camera served without a camera parameter.
+
+    Methods:
+        __init__(self, cameras): Initializes the route for the cameras.
+        route(self, query): Route of /snapshot.jpg.
+    """
+
+    def __init__(self, cameras):
+        self._cameras = {camera.name: camera for camera in cameras}
+        self._default = cameras[0].name
+
+    def route(self, query):
+        """
+        Route of /snapshot.jpg?camera=<name>, returns the JPEG of the camera's last
+        keyframe. The first camera is served without a camera parameter.
+
+        Args:
+            query (dict): Query parameters of the request.
+
+        Returns:
+            tuple: The status code, the content type and the body.
+        """
+
+        camera = self._cameras.get(query.get("camera", [self._default])[0])
+        if camera is None:
+            return 404, "text/plain", b"Unknown camera\n"
+
+        jpeg = camera.snapshot.jpeg()
+        if jpeg is None:
+            return 503, "text/plain", b"No keyframe yet\n"
+        return 200, "image/jpeg", jpeg
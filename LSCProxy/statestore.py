@@ -0,0 +1,185 @@
+"""
+State Store Module.
+
+This module keeps the last state of every sensor in one JSON file, so it can be
+restored after a restart. The file is read once at startup and the states are
+served from memory from then on. A change is written behind: a thread writes all
+states that changed within a short delay at once, into a temporary file that
+replaces the old one, so a crash never leaves a half written file and a toggle
+never waits for the disk.
+
+The states of older versions, one file per sensor in the same directory, are
+taken over when the store is loaded.
+
+Classes:
+    StateStore: The states of all sensors, shared by them.
+
+Author:
+    Berobloom
+"""
+
+import json
+import os
+import threading
+import time
+from pathlib import Path
+
+# Changes within this many seconds are written together
+WRITE_DELAY_S = 2
+
+STATES_FILE = "states.json"
+
+
+class StateStore():
+    """
+    State Store Class.
+
+    Attributes:
+        _path: Path of the JSON file.
+        _states: Dictionary mapping a sensor name to its state.
+        _lock: Condition guarding the states, the writer waits on it.
+        _dirty: True while there are changes that have not been written.
+        _flush_lock: Lock serializing the writes of the writer thread and flush().
+
+    Methods:
+        __init__(self, directory): Loads the states from the directory.
+        get(self, name, default): Returns the state of a sensor.
+        set(self, name, state): Changes the state of a sensor, written later.
+        flush(self): Writes the changes now.
+        _load(self): Reads the states from the file and the legacy files.
+        _write(self, states): Replaces the file with the states.
+        _write_behind(self): Writes the changes after the delay, runs on a thread.
+    """
+
+    def __init__(self, directory="states"):
+        self._path = Path(directory) / STATES_FILE
+        self._states = {}
+        self._lock = threading.Condition()
+        self._dirty = False
+        self._flush_lock = threading.Lock()
+        self._load()
+
+        writer = threading.Thread(target=self._write_behind, name="state-writer")
+        writer.daemon = True
+        writer.start()
+
+    def get(self, name, default=None):
+        """
+        Returns the state of a sensor.
+
+        Args:
+            name (str): Name of the sensor.
+            default: Returned if no state has been stored for the sensor.
+
+        Returns:
+            str: The state, or default.
+        """
+
+        with self._lock:
+            return self._states.get(name, default)
+
+    def set(self, name, state):
+        """
+        Changes the state of a sensor. The file is written a moment later, together
+        with the other changes made meanwhile.
+
+        Args:
+            name (str): Name of the sensor.
+            state (str): The new state.
+
+        Returns:
+            None
+        """
+
+        with self._lock:
+            if self._states.get(name) == state:
+                return
+            self._states[name] = state
+            # Only the first change wakes the writer, the later ones join its batch
+            if not self._dirty:
+                self._dirty = True
+                self._lock.notify()
+
+    def flush(self):
+        """
+        Writes the changes that have not been written yet, e.g. at shutdown.
+
+        Returns:
+            None
+        """
+
+        # The writer thread and a flush at shutdown must not share the .tmp file
+        with self._flush_lock:
+            with self._lock:
+                if not self._dirty:
+                    return
+                states = dict(self._states)
+                self._dirty = False
+            self._write(states)
+
+    def _load(self):
+        """
+        Reads the states from the file, and those of the legacy files of single
+        sensors that are not in it yet.
+
+        Returns:
+            None
+        """
+
+        directory = self._path.parent
+        try:
+            with open(self._path, "r", encoding="utf-8") as f:
+                self._states = json.load(f)
+        except FileNotFoundError:
+            pass
+        except (OSError, ValueError) as e:
+            print(f"Cannot read {self._path}, starting without states: {e}")
+
+        if not directory.is_dir():
+            return
+        for legacy in directory.iterdir():
+            if legacy.name == STATES_FILE or legacy.suffix == ".tmp" or not legacy.is_file():
+                continue
+            if legacy.name not in self._states:
+                self._states[legacy.name] = legacy.read_text(encoding="utf-8")
+                self._dirty = True
+
+    def _write(self, states):
+        """
+        Replaces the file with the states.
+
+        Args:
+            states (dict): Dictionary mapping a sensor name to its state.
+
+        Returns:
+            None
+        """
+
+        temporary = self._path.with_suffix(".tmp")
+        try:
+            self._path.parent.mkdir(parents=True, exist_ok=True)
+            with open(temporary, "w", encoding="utf-8") as f:
+                json.dump(states, f, indent=2, sort_keys=True)
+                f.flush()
+                os.fsync(f.fileno())
+            os.replace(temporary, self._path)
+        except OSError as e:
+            print(f"Cannot write {self._path}: {e}")
+
+    def _write_behind(self):
+        """
+        Writes the changes a moment after the first of them, until the proxy exits.
+
+        Returns:
+            None
+        """
+
+        while True:
+            with self._lock:
+                while not self._dirty:
+                    self._lock.wait()
+                # Collects the changes that follow
+                deadline = time.monotonic() + WRITE_DELAY_S
+                while self._dirty and time.monotonic() < deadline:
+                    self._lock.wait(deadline - time.monotonic())
+            self.flush()
@@ -0,0 +1,120 @@
+"""
+Session Supervisor Module.
+
+This module keeps the TUTK session of a camera up. When connecting fails or the
+session is lost, only the IOTC/AV session is set up again, with an exponential
+backoff between the attempts. Everything downstream of the session — the RTSP
+server, the FIFOs, ffmpeg and the native publisher — stays up in the meantime.
+
+Classes:
+    SessionSupervisor: Connects, reconnects and closes the session of one camera.
+
+Author:
+    Berobloom
+"""
+
+import random
+import time
+
+INITIAL_BACKOFF_S = 1
+MAX_BACKOFF_S = 60
+
+# A session that lasted this long counts as healthy and resets the backoff
+STABLE_SESSION_S = 60
+
+
+class SessionSupervisor():
+    """
+    Session Supervisor Class.
+
+    Attributes:
+        _camera: Camera object whose session is supervised.
+        _backoff: Current delay before the next attempt in seconds.
+        _connected_at: Monotonic time the current session was established.
+
+    Methods:
+        __init__(self, camera): Initializes the supervisor.
+        connect(self): Establishes the session, retrying with backoff until it is up.
+        disconnect(self): Closes the session.
+        session_lost(self): Closes a lost session and waits before the next attempt.
+    """
+
+    def __init__(self, camera):
+        self._camera = camera
+        self._backoff = INITIAL_BACKOFF_S
+        self._connected_at = None
+
+    def _try_connect(self):
+        tutk = self._camera.tutk
+        if not tutk.iotc_connect_by_uid_parallel():
+            return False
+        if not tutk.av_client_start2(self._camera.av_username, self._camera.av_password):
+            return False
+        print(f"[{self._camera.name}] Client started")
+
+        if not tutk.start_ipcam_stream():
+            print(f"[{self._camera.name}] Cannot start the stream")
+            return False
+        print(f"[{self._camera.name}] IOCTRL commands send successfully")
+        return True
+
+    def _wait_backoff(self):
+        # Jitter keeps cameras that dropped off together from reconnecting in lockstep
+        delay = self._backoff * random.uniform(0.8, 1.2)
+        print(f"[{self._camera.name}] Reconnecting in {delay:.1f} s")
+        deadline = time.monotonic() + delay
+        while not self._camera.tutk.graceful_shutdown:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            time.sleep(min(1, remaining))
+        self._backoff = min(self._backoff * 2, MAX_BACKOFF_S)
+
+    def connect(self):
+        """
+        Establishes the session, retrying with an exponential backoff until it is up.
+
+        Returns:
+            bool: True once connected, False if the proxy is shutting down.
+        """
+
+        while not self._camera.tutk.graceful_shutdown:
+            if self._try_connect():
+                if self._connected_at is not None:
+                    self._camera.metrics.reconnects += 1
+                self._connected_at = time.monotonic()
+                self._camera.metrics.session_up = True
+                return True
+            self.disconnect()
+            self._wait_backoff()
+        return False
+
+    def disconnect(self):
+        """
+        Closes the session.
+
+        Returns:
+            None
+        """
+
+        self._camera.metrics.session_up = False
+        self._camera.tutk.av_client_stop()
+        self._camera.tutk.iotc_session_close()
+
+    def session_lost(self):
+        """
+        Closes a lost session and waits before the next attempt to connect.
+
+        Returns:
+            None
+        """
+
+        self.disconnect()
+        if self._camera.tutk.graceful_shutdown:
+            return
+
+        if self._connected_at is not None and \
+                time.monotonic() - self._connected_at >= STABLE_SESSION_S:
+            self._backoff = INITIAL_BACKOFF_S
+        print(f"[{self._camera.name}] Session lost")
+        self._wait_backoff()
@@ -0,0 +1,89 @@
+"""
+Tests of the on demand mode with the Private switch.
+
+Run them from LSCProxy with: python3 -m unittest discover tests
+"""
+
+import sys
+import unittest
+from pathlib import Path
+from unittest import mock
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+
+# pylint: disable=wrong-import-position
+from demand import Demand, StreamControl
+from sensors.private import Private
+
+
+class FakeCamera():
+    """
+    A camera with a mocked TUTK session.
+    """
+
+    def __init__(self):
+        self.name = "test"
+        self.demand = Demand()
+        self.tutk = mock.Mock()
+        self.tutk.private = False
+        self.tutk.ioctrl_start_camera.return_value = True
+        self.tutk.ioctrl_stop_camera.return_value = True
+
+
+class PrivateOnDemandTest(unittest.TestCase):
+    """
+    A reader must not start a camera whose Private switch is on.
+    """
+
+    def setUp(self):
+        self.camera = FakeCamera()
+        self.publisher = mock.Mock()
+        self.stream = StreamControl(self.camera, self.publisher, on_demand=True)
+        self.private = Private("Private", "switch", "mdi:eye-off", self.camera.tutk, None,
+                               self.camera.name)
+        # No readers, the camera idles
+        self.stream.poll()
+        self.assertTrue(self.stream.idle)
+        self.publisher.set_standby.assert_called_once_with(True)
+
+    def test_reader_does_not_start_a_private_camera(self):
+        self.private.handle_data("ON")
+        self.camera.tutk.ioctrl_start_camera.reset_mock()
+        self.publisher.set_standby.reset_mock()
+
+        self.camera.demand.request(True)
+        self.stream.poll()
+
+        self.assertFalse(self.stream.idle)
+        self.camera.tutk.ioctrl_start_camera.assert_not_called()
+        self.publisher.set_standby.assert_not_called()
+
+        # Private off starts the camera and the publisher follows
+        self.private.handle_data("OFF")
+        self.stream.poll()
+        self.camera.tutk.ioctrl_start_camera.assert_called_once()
+        self.publisher.set_standby.assert_called_once_with(False)
+
+    def test_reconnect_keeps_a_private_camera_stopped(self):
+        self.private.handle_data("ON")
+        self.camera.demand.request(True)
+        self.stream.poll()
+        self.camera.tutk.ioctrl_stop_camera.reset_mock()
+
+        self.stream.session_started()
+        self.stream.poll()
+
+        self.camera.tutk.ioctrl_stop_camera.assert_called_once()
+        self.publisher.set_standby.assert_called_once_with(True)
+
+    def test_reader_starts_the_camera(self):
+        self.camera.demand.request(True)
+        self.stream.poll()
+
+        self.assertFalse(self.stream.idle)
+        self.camera.tutk.ioctrl_start_camera.assert_called_once()
+        self.publisher.set_standby.assert_called_with(False)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -10,13 +10,16 @@ receiving audio and video streams, and controlling camera settings.
 IOCTRL Constants:
     - IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ: Handles nightvision
     - IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ: Handles quality settings
+    - IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ: Handles the orientation of the image
     - IOTYPE_USER_IPCAM_START: Handles the start of the camera
     - IOTYPE_USER_IPCAM_STOP: Handles the stop of the camera
     - IOTYPE_USER_IPCAM_AUDIOSTART: Handles the start of the audio
 
 IOCTRL Structures:
     - SMsgAVIoctrlSetVideoModeReq: Structure for setting video mode through IOCTRL.
+    - SMsgAVIoctrlSetVideoModeResp: Structure of the response to the video mode.
     - SMsgAVIoctrlSetStreamCtrlReq: Structure for setting stream control through IOCTRL.
+    - SMsgAVIoctrlSetStreamCtrlResp: Structure of the response to the stream control.
     - SMsgAVIoctrlAVStream: Structure for AV stream control through IOCTRL.
     - FrameInfoT: Structure for video and audio frame information.
 
@@ -26,7 +29,9 @@ Tutk Class:
     - Provides functions for disabling/enabling night
       vision, setting video quality, and controlling camera streams.
     - Handles the initiation and cleanup of audio and video streams.
-    - Implements functions for IOCTRL commands to control camera settings.
+    - Implements functions for IOCTRL commands to control camera settings. The
+      commands go through an IoctrlChannel, which tells from the response of the
+      camera whether it applied them.
     - Supports initialization, connection, and cleanup of TUTK sessions.
 
 Note:
@@ -40,9 +45,9 @@ Author:
 import ctypes
 import os
 import sys
-import pathlib
 import constants
 import msghandler
+from ioctrl import IoctrlChannel
 
 
 # IOCTRL structs
@@ -54,6 +59,15 @@ class SMsgAVIoctrlSetVideoModeReq(ctypes.Structure):
                 ("mode", ctypes.c_uint)]
 
 
+class SMsgAVIoctrlSetVideoModeResp(ctypes.Structure):
+    """
+    Structure of the response to IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ.
+    """
+    _fields_ = [("channel", ctypes.c_uint),
+                ("result", ctypes.c_ubyte),
+                ("reserved", ctypes.c_ubyte * 3)]
+
+
 class SMsgAVIoctrlSetStreamCtrlReq(ctypes.Structure):
     """
     Structure for setting stream control through IOCTRL.
@@ -62,6 +76,35 @@ class SMsgAVIoctrlSetStreamCtrlReq(ctypes.Structure):
                 ("quality", ctypes.c_uint)]
 
 
+class SMsgAVIoctrlSetStreamCtrlResp(ctypes.Structure):
+    """
+    Structure of the response to IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ.
+    """
+    _fields_ = [("result", ctypes.c_int),
+                ("reserved", ctypes.c_ubyte * 4)]
+
+
+def _response_result(struct_type, data):
+    # A short response counts as success, zero padded
+    data = data[:ctypes.sizeof(struct_type)].ljust(ctypes.sizeof(struct_type), b"\0")
+    return struct_type.from_buffer_copy(data).result == 0
+
+
+# Response type of the commands the camera answers, and whether a response
+# reports success. Only the response types of the TUTK AVIOCTRL definitions
+# are listed. A command without a verified response, e.g. the vendor specific
+# gray mode, is sent without waiting, a guessed type would have every call wait
+# for the timeout on a firmware that answers differently.
+IOCTRL_RESPONSES = {
+    constants.ioctrl["IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ"]: (
+        constants.ioctrl["IOTYPE_USER_IPCAM_SETSTREAMCTRL_RESP"],
+        lambda data: _response_result(SMsgAVIoctrlSetStreamCtrlResp, data)),
+    constants.ioctrl["IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ"]: (
+        constants.ioctrl["IOTYPE_USER_IPCAM_SET_VIDEOMODE_RESP"],
+        lambda data: _response_result(SMsgAVIoctrlSetVideoModeResp, data)),
+}
+
+
 class SMsgAVIoctrlAVStream(ctypes.Structure):
     """
     Structure for AV stream control through IOCTRL.
@@ -103,18 +146,29 @@ class Tutk():
         error_constants (dict): Dictionary of TUTK error msghandler.
         settings (dict): Dictionary of TUTK settings.
         ioctrl (dict): Dictionary of TUTK IOCTRL commands.
+        ioctrl_channel (IoctrlChannel): Channel the IOCTRL commands are sent through.
+        quality (int): Video quality level start_ipcam_stream sets, see video_quality
+            in constants.py.
+        private (bool): True while the Private switch keeps the camera stopped.
 
     Methods:
         __init__(self, uid): Initializes the TUTK wrapper with a unique identifier (UID).
         av_client_stop(self): Stops the AV client connection.
         iotc_session_close(self): Closes the IOTC session.
         av_send_ioctrl(self, iotype_command, struct): Sends an IOCTRL command to the AV client.
+        av_recv_ioctrl(self, iotype, buf, timeout_ms): Receives an IOCTRL response.
+        ioctrl_request(self, iotype_command, struct): Sends an IOCTRL command and returns
+            a Future of whether the camera applied it.
         ioctrl_disable_nightvision(self): Disables night vision through IOCTRL.
         ioctrl_enable_nightvision(self): Enables night vision through IOCTRL.
         ioctrl_enable_hd_quality(self): Sets video quality to HD through IOCTRL.
+        ioctrl_set_quality(self, quality): Sets the video quality level through IOCTRL.
+        ioctrl_enable_flip(self): Turns the image upside down through IOCTRL.
+        ioctrl_disable_flip(self): Turns the image back upright through IOCTRL.
         ioctrl_start_camera(self): Starts the camera through IOCTRL.
         ioctrl_stop_camera(self): Stops the camera through IOCTRL.
         ioctrl_start_audio(self): Starts audio streaming through IOCTRL.
+        ioctrl_stop_audio(self): Stops audio streaming through IOCTRL.
         start_ipcam_stream(self): Initiates the camera stream with necessary settings.
         av_initialize(self, max_num_allowed): Initializes the
             AV client with the maximum number of allowed connections.
@@ -129,7 +183,13 @@ class Tutk():
         create_buf(self, buf_size): Creates a buffer of the specified size.
         av_recv_framedata2(self, buf, buf_size): Receives video frame data into the provided buffer.
         av_recv_audio_data(self, buf, buf_size): Receives audio data into the provided buffer.
+        recv_video(self, buffers, buf_size): Receives a video frame like a batch of one.
+        recv_audio(self, buffers, buf_size, min_buffered): Receives an audio frame
+            like a batch of one.
         av_check_audio_buf(self): Checks the availability of audio data in the buffer.
+        video_frame_info(self): Frame information of the last received video frame.
+        audio_frame_info(self): Frame information of the last received audio frame.
+        expected_video_size(self): Size of the last video frame that did not fit.
     """
 
     def __init__(self, uid):
@@ -137,10 +197,10 @@ class Tutk():
         self.uid = uid
         self.av_index = None
         self.session_id = None
+        self.quality = constants.video_quality["AVIOCTRL_QUALITY_HIGH"]
+        self.private = False
 
-        lib_iot = pathlib.Path().absolute() / "libs/x64/libIOTCAPIs_ALL.so"
-
-        self._iot = ctypes.CDLL(lib_iot, mode=os.RTLD_LAZY)
+        self._iot = ctypes.CDLL(constants.settings["IOTC_LIB_PATH"], mode=os.RTLD_LAZY)
 
         self._iot.avInitialize.argtypes = [ctypes.c_int]
 
@@ -157,7 +217,11 @@ class Tutk():
         self._iot.IOTC_Connect_ByUID_Parallel.restype = ctypes.c_int
 
         self._iot.avSendIOCtrl.argtypes = [ctypes.c_int, ctypes.c_int,
-                                           ctypes.c_char_p, ctypes.c_size_t]
+                                           ctypes.c_void_p, ctypes.c_int]
+
+        self._iot.avRecvIOCtrl.argtypes = [ctypes.c_int, ctypes.POINTER(ctypes.c_uint),
+                                           ctypes.c_char_p, ctypes.c_int, ctypes.c_uint]
+        self._iot.avRecvIOCtrl.restype = ctypes.c_int
 
         self._iot.avClientStart2.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_char_p,
                                              ctypes.c_int, ctypes.POINTER(ctypes.c_uint), ctypes.c_int,
@@ -171,13 +235,13 @@ class Tutk():
                                                ctypes.c_int,
                                                ctypes.POINTER(ctypes.c_int),
                                                ctypes.POINTER(ctypes.c_int),
-                                               ctypes.c_char_p, ctypes.c_size_t,
+                                               ctypes.c_void_p, ctypes.c_int,
                                                ctypes.POINTER(ctypes.c_int),
                                                ctypes.POINTER(ctypes.c_uint)]
         self._iot.avRecvFrameData2.restype = ctypes.c_int
 
         self._iot.avRecvAudioData.argtypes = (ctypes.c_int,
-                                              ctypes.c_char_p, ctypes.c_int,
+                                              ctypes.c_void_p, ctypes.c_int,
                                               ctypes.POINTER(FrameInfoT),
                                               ctypes.c_int,
                                               ctypes.POINTER(ctypes.c_uint))
@@ -199,9 +263,21 @@ class Tutk():
         self._audio_frame_info = FrameInfoT()
         self._audio_frm_no = ctypes.c_uint()
 
+        # The pointer arguments of the receive calls are built once, not per frame
+        self._video_args = (ctypes.byref(self._video_out_buf_size),
+                            ctypes.byref(self._video_out_frm_size),
+                            ctypes.addressof(self._video_frame_info), ctypes.sizeof(FrameInfoT),
+                            ctypes.byref(self._video_out_frm_info_size),
+                            ctypes.byref(self._video_frm_no))
+        self._audio_args = (ctypes.byref(self._audio_frame_info),
+                            self._audio_out_frm_info_size.value,
+                            ctypes.byref(self._audio_frm_no))
+
         self._srv_type = ctypes.c_uint()
         self._resend = ctypes.c_int(-1)
 
+        self.ioctrl_channel = IoctrlChannel(self)
+
     def av_client_stop(self):
         """
         Stops the AV client connection.
@@ -210,7 +286,9 @@ class Tutk():
             None
         """
 
-        self._iot.avClientStop(self.av_index)
+        if self.av_index is not None:
+            self._iot.avClientStop(self.av_index)
+            self.av_index = None
 
     def iotc_session_close(self):
         """
@@ -220,7 +298,9 @@ class Tutk():
             None
         """
 
-        self._iot.IOTC_Session_Close(self.session_id)
+        if self.session_id is not None:
+            self._iot.IOTC_Session_Close(self.session_id)
+            self.session_id = None
 
     def av_send_ioctrl(self, iotype_command, struct):
         """
@@ -231,12 +311,15 @@ class Tutk():
             struct: IOCTRL command structure.
 
         Returns:
-            bool: True if the command was sent successfully, False otherwise.
+            bool: True if the command was sent successfully, False otherwise, also
+                while there is no session.
         """
 
-        struct_bytes = bytes(struct)
-        status = self._iot.avSendIOCtrl(self.av_index, iotype_command,
-                                        struct_bytes, len(struct_bytes))
+        av_index = self.av_index
+        if av_index is None:
+            return False
+        status = self._iot.avSendIOCtrl(av_index, iotype_command,
+                                        ctypes.byref(struct), ctypes.sizeof(struct))
 
         if status < 0:
             print(f"Error status: {status}")
@@ -244,12 +327,59 @@ class Tutk():
 
         return True
 
-    def ioctrl_disable_nightvision(self):
+    def av_recv_ioctrl(self, iotype, buf, timeout_ms):
+        """
+        Receives the next IOCTRL response of the camera.
+
+        Args:
+            iotype (c_uint): Set to the type of the response.
+            buf: Buffer the response is received into.
+            timeout_ms (int): How long to wait for a response.
+
+        Returns:
+            int: Size of the response, or the error code, AV_ER_TIMEOUT if there was none.
+        """
+
+        av_index = self.av_index
+        if av_index is None:
+            return constants.av_error["AV_ER_SESSION_CLOSE_BY_REMOTE"]
+        return self._iot.avRecvIOCtrl(av_index, ctypes.byref(iotype), buf, len(buf),
+                                      timeout_ms)
+
+    def ioctrl_request(self, iotype_command, struct):
+        """
+        Sends an IOCTRL command without waiting for the response of the camera.
+
+        Args:
+            iotype_command (int): IOCTRL command type.
+            struct: IOCTRL command structure.
+
+        Returns:
+            Future: True if the camera applied the command or does not answer it,
+                False if it could not be sent or the camera rejected it, None if
+                the response did not arrive in time.
+        """
+
+        return self.ioctrl_channel.request(iotype_command, struct,
+                                           IOCTRL_RESPONSES.get(iotype_command))
+
+    def _ioctrl(self, iotype_command, struct, wait=True):
+        future = self.ioctrl_request(iotype_command, struct)
+        if not wait:
+            return future
+        # An unanswered command may still have been applied, only a rejection fails
+        return future.result() is not False
+
+    def ioctrl_disable_nightvision(self, wait=True):
         """
         Disables night vision through IOCTRL.
 
+        Args:
+            wait (bool): False to return without waiting for the response.
+
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
         """
 
         io_nightvision = SMsgAVIoctrlSetVideoModeReq()
@@ -257,51 +387,107 @@ class Tutk():
         io_nightvision.mode = 1
 
         # get constants from msghandler.py
-        status = self.av_send_ioctrl(
-            constants.ioctrl["IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ"], io_nightvision)
+        status = self._ioctrl(
+            constants.ioctrl["IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ"], io_nightvision, wait)
 
         return status
 
-    def ioctrl_enable_nightvision(self):
+    def ioctrl_enable_nightvision(self, wait=True):
         """
         Enables night vision through IOCTRL.
 
+        Args:
+            wait (bool): False to return without waiting for the response.
+
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
         """
 
         io_nightvision = SMsgAVIoctrlSetVideoModeReq()
         io_nightvision.channel = 0
         io_nightvision.mode = 0
 
-        status = self.av_send_ioctrl(
-            constants.ioctrl["IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ"], io_nightvision)
+        status = self._ioctrl(
+            constants.ioctrl["IOTYPE_USER_IPCAM_SETGRAY_MODE_REQ"], io_nightvision, wait)
 
         return status
 
-    def ioctrl_enable_hd_quality(self):
+    def ioctrl_enable_hd_quality(self, wait=True):
         """
         Sets video quality to HD through IOCTRL.
 
+        Args:
+            wait (bool): False to return without waiting for the response.
+
+        Returns:
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
+        """
+
+        return self.ioctrl_set_quality(constants.video_quality["AVIOCTRL_QUALITY_HIGH"], wait)
+
+    def ioctrl_set_quality(self, quality, wait=True):
+        """
+        Sets the video quality level through IOCTRL.
+
+        Args:
+            quality (int): Level from AVIOCTRL_QUALITY_MAX to AVIOCTRL_QUALITY_MIN.
+            wait (bool): False to return without waiting for the response.
+
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
         """
 
         io_quality = SMsgAVIoctrlSetStreamCtrlReq()
         io_quality.channel = 0
-        io_quality.quality = 2
+        io_quality.quality = quality
 
-        status = self.av_send_ioctrl(
-            constants.ioctrl["IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ"], io_quality)
+        status = self._ioctrl(
+            constants.ioctrl["IOTYPE_USER_IPCAM_SETSTREAMCTRL_REQ"], io_quality, wait)
 
         return status
 
-    def ioctrl_start_camera(self):
+    def _ioctrl_set_video_mode(self, mode):
+        io_video_mode = SMsgAVIoctrlSetVideoModeReq()
+        io_video_mode.channel = 0
+        io_video_mode.mode = constants.video_mode[mode]
+
+        return self._ioctrl(
+            constants.ioctrl["IOTYPE_USER_IPCAM_SET_VIDEOMODE_REQ"], io_video_mode)
+
+    def ioctrl_enable_flip(self):
+        """
+        Turns the image upside down through IOCTRL, for a camera mounted on the
+        ceiling. The camera's encoder flips it, so the stream is not interrupted.
+
+        Returns:
+            bool: False if the command could not be sent or the camera rejected it.
+        """
+
+        return self._ioctrl_set_video_mode("AVIOCTRL_VIDEOMODE_FLIP_MIRROR")
+
+    def ioctrl_disable_flip(self):
+        """
+        Turns the image back upright through IOCTRL.
+
+        Returns:
+            bool: False if the command could not be sent or the camera rejected it.
+        """
+
+        return self._ioctrl_set_video_mode("AVIOCTRL_VIDEOMODE_NORMAL")
+
+    def ioctrl_start_camera(self, wait=True):
         """
         Starts the camera through IOCTRL.
 
+        Args:
+            wait (bool): False to return without waiting for the response.
+
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
         """
 
         self.clean_audio_buf()
@@ -309,7 +495,7 @@ class Tutk():
         io_camera = SMsgAVIoctrlAVStream()
         io_camera.channel = 1
 
-        status = self.av_send_ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_START"], io_camera)
+        status = self._ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_START"], io_camera, wait)
 
         return status
 
@@ -318,56 +504,74 @@ class Tutk():
         Stops the camera through IOCTRL.
 
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
         """
 
         io_camera = SMsgAVIoctrlAVStream()
         io_camera.channel = 1
 
-        status = self.av_send_ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_STOP"], io_camera)
+        status = self._ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_STOP"], io_camera)
 
         return status
 
-    def ioctrl_start_audio(self):
+    def ioctrl_start_audio(self, wait=True):
         """
         Starts audio streaming through IOCTRL.
 
+        Args:
+            wait (bool): False to return without waiting for the response.
+
         Returns:
-            int: Status code of the IOCTRL command.
+            bool: False if the command could not be sent or the camera rejected it.
+                A Future of the result of ioctrl_request if wait is False.
         """
 
         io_audio = SMsgAVIoctrlAVStream()
         io_audio.channel = 1
 
-        status = self.av_send_ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_AUDIOSTART"], io_audio)
+        status = self._ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_AUDIOSTART"], io_audio, wait)
 
         return status
 
-    def start_ipcam_stream(self):
+    def ioctrl_stop_audio(self):
         """
-        Initiates the camera stream with necessary settings.
+        Stops audio streaming through IOCTRL.
 
         Returns:
-            bool: True if the camera stream was initiated successfully, False otherwise.
+            bool: False if the command could not be sent or the camera rejected it.
         """
 
-        if not self.ioctrl_disable_nightvision():
-            print("Cannot start camera. Error while disabling nightvision")
-            return False
+        io_audio = SMsgAVIoctrlAVStream()
+        io_audio.channel = 1
 
-        if not self.ioctrl_enable_hd_quality():
-            print("Cannot start camera. Error while setting quality to HD")
-            return False
+        status = self._ioctrl(constants.ioctrl["IOTYPE_USER_IPCAM_AUDIOSTOP"], io_audio)
 
-        if not self.ioctrl_start_camera():
-            print("Cannot start camera. Camera error")
-            return False
+        return status
 
-        if not self.ioctrl_start_audio():
-            print("Cannot start camera. Error while starting audio")
-            return False
+    def start_ipcam_stream(self):
+        """
+        Initiates the camera stream with necessary settings.
 
-        return True
+        Returns:
+            bool: True if the camera stream was initiated successfully, False otherwise.
+        """
+
+        # Sent back to back, the camera answers the first ones while the
+        # later ones are on the way
+        requests = (
+            ("Error while disabling nightvision", self.ioctrl_disable_nightvision(wait=False)),
+            ("Error while setting the quality",
+             self.ioctrl_set_quality(self.quality, wait=False)),
+            ("Camera error", self.ioctrl_start_camera(wait=False)),
+            ("Error while starting audio", self.ioctrl_start_audio(wait=False)),
+        )
+
+        started = True
+        for error, future in requests:
+            if future.result() is False:
+                print(f"Cannot start camera. {error}")
+                started = False
+        return started
 
     def av_initialize(self, max_num_allowed):
         """
@@ -401,7 +605,9 @@ class Tutk():
             None
         """
 
-        self._iot.avClientCleanAudioBuf(self.av_index)
+        av_index = self.av_index
+        if av_index is not None:
+            self._iot.avClientCleanAudioBuf(av_index)
 
     def clean_video_buf(self):
         """
@@ -411,7 +617,9 @@ class Tutk():
             None
         """
 
-        self._iot.avClientCleanVideoBuf(self.av_index)
+        av_index = self.av_index
+        if av_index is not None:
+            self._iot.avClientCleanVideoBuf(av_index)
 
     def iotc_initialize2(self, num):
         """
@@ -435,20 +643,22 @@ class Tutk():
         Connects to the camera by UID in parallel mode.
 
         Returns:
-            None
+            bool: True if connected, False otherwise.
         """
 
         tmp_session_id = self._iot.IOTC_Get_SessionID()
         if tmp_session_id < 0:
             print("Get session ID failed")
-            sys.exit(1)
+            return False
         new_session_id = self._iot.IOTC_Connect_ByUID_Parallel(self.uid.encode('utf-8'),
                                                                tmp_session_id)
         if new_session_id < 0:
             print(f"Connect by UID failed. Error code: {new_session_id}")
-            sys.exit(1)
-        else:
-            self.session_id = new_session_id
+            msghandler.parse_error_number(new_session_id)
+            return False
+
+        self.session_id = new_session_id
+        return True
 
     def av_client_start2(self, av_id, av_pass):
         """
@@ -459,17 +669,20 @@ class Tutk():
             av_pass (str): AV password.
 
         Returns:
-            None
+            bool: True if the AV client was started, False otherwise.
         """
 
         timeout = 20
         service_type = 0
-        self.av_index = self._iot.avClientStart2(self.session_id, av_id.encode('utf-8'),
-                                                 av_pass.encode('utf-8'), timeout, ctypes.byref(self._srv_type),
-                                                 service_type, ctypes.byref(self._resend))
-        if self.av_index < 0:
-            print(f"avClientStart2 failed[{self.av_index}]")
-            sys.exit(1)
+        av_index = self._iot.avClientStart2(self.session_id, av_id.encode('utf-8'),
+                                            av_pass.encode('utf-8'), timeout, ctypes.byref(self._srv_type),
+                                            service_type, ctypes.byref(self._resend))
+        if av_index < 0:
+            print(f"avClientStart2 failed[{av_index}]")
+            return False
+
+        self.av_index = av_index
+        return True
 
     def create_buf(self, buf_size):
         """
@@ -497,13 +710,7 @@ class Tutk():
             int: Status code of the AV reception.
         """
 
-        status = self._iot.avRecvFrameData2(self.av_index, buf, buf_size,
-                                            ctypes.byref(self._video_out_buf_size),
-                                            ctypes.byref(self._video_out_frm_size),
-                                            ctypes.cast(ctypes.byref(self._video_frame_info),
-                                                        ctypes.c_char_p), ctypes.sizeof(FrameInfoT),
-                                            ctypes.byref(self._video_out_frm_info_size),
-                                            ctypes.byref(self._video_frm_no))
+        status = self._iot.avRecvFrameData2(self.av_index, buf, buf_size, *self._video_args)
         return status
 
     def av_recv_audio_data(self, buf, buf_size):
@@ -518,13 +725,52 @@ class Tutk():
             int: Status code of the AV reception.
         """
 
-        status = self._iot.avRecvAudioData(self.av_index, ctypes.cast(buf, ctypes.c_char_p),
-                                           buf_size,
-                                           self._audio_frame_info,
-                                           self._audio_out_frm_info_size,
-                                           self._audio_frm_no)
+        status = self._iot.avRecvAudioData(self.av_index, buf, buf_size, *self._audio_args)
         return status
 
+    def recv_video(self, buffers, buf_size):
+        """
+        Receives a video frame into the first buffer. Same interface as
+        BatchReceiver.recv_video, for when the native library is not built.
+
+        Args:
+            buffers (list): Buffers to receive the frames into.
+            buf_size (int): Size of every buffer.
+
+        Returns:
+            list: (status, FrameInfoT) of the received frame, empty if none was ready.
+        """
+
+        status = self.av_recv_framedata2(buffers[0], buf_size)
+        if status == constants.av_error["AV_ER_DATA_NOREADY"]:
+            return []
+        return [(status, self._video_frame_info)]
+
+    def recv_audio(self, buffers, buf_size, min_buffered):
+        """
+        Receives an audio frame into the first buffer once min_buffered frames
+        are buffered. Same interface as BatchReceiver.recv_audio.
+
+        Args:
+            buffers (list): Buffers to receive the frames into.
+            buf_size (int): Size of every buffer.
+            min_buffered (int): Frames the SDK has to buffer before one is received.
+
+        Returns:
+            list: (status, FrameInfoT) of the received frame, or of the failed buffer
+                check, empty if none was ready.
+        """
+
+        status = self.av_check_audio_buf()
+        if status < 0:
+            return [(status, self._audio_frame_info)]
+        if status < min_buffered:
+            return []
+        status = self.av_recv_audio_data(buffers[0], buf_size)
+        if status == constants.av_error["AV_ER_DATA_NOREADY"]:
+            return []
+        return [(status, self._audio_frame_info)]
+
     def av_check_audio_buf(self):
         """
         Checks the availability of audio data in the buffer.
@@ -535,3 +781,37 @@ class Tutk():
 
         status = self._iot.avCheckAudioBuf(self.av_index)
         return status
+
+    @property
+    def video_frame_info(self):
+        """
+        Frame information of the last received video frame.
+
+        Returns:
+            FrameInfoT: Filled in by av_recv_framedata2.
+        """
+
+        return self._video_frame_info
+
+    @property
+    def expected_video_size(self):
+        """
+        Size of the last video frame that did not fit into its buffer, same
+        attribute as BatchReceiver.expected_video_size.
+
+        Returns:
+            int: Set by av_recv_framedata2 along with AV_ER_BUFPARA_MAXSIZE_INSUFF.
+        """
+
+        return self._video_out_frm_size.value
+
+    @property
+    def audio_frame_info(self):
+        """
+        Frame information of the last received audio frame.
+
+        Returns:
+            FrameInfoT: Filled in by av_recv_audio_data.
+        """
+
+        return self._audio_frame_info
@@ -3,11 +3,17 @@ Module Description: This module provides utility functions related to time.
 
 Contents:
 - usleep(u_seconds): Sleeps for a specified duration in microseconds.
+- Poller: Paces a receive loop that polls the TUTK framework.
+- StartupTimer: Logs how long the steps of the startup take.
+- PROCESS_START: Monotonic time the proxy started at.
 
-Note: This module uses the 'time' module.
+Note: This module uses the 'time' and 'threading' modules.
 """
+import threading
 import time
 
+PROCESS_START = time.monotonic()
+
 
 def usleep(u_seconds):
     """
@@ -20,3 +26,108 @@ def usleep(u_seconds):
     >>> usleep(500000)  # Sleep for 0.5 seconds
     """
     time.sleep(u_seconds / 1e6)
+
+
+class Poller():
+    """
+    Paces a receive loop that polls the TUTK framework.
+
+    The TUTK receive functions never block. Instead of sleeping a fixed time when no
+    data is ready, the poller learns the frame interval of the stream and sleeps until
+    shortly before the next frame is due, then polls in small steps. When no frame has
+    arrived for a while it backs off exponentially, so an idle stream hardly wakes up.
+    This mirrors Poller in libs/framepump.
+
+    Methods:
+        frame_received(self): Records the arrival of a frame.
+        next_delay(self): Returns how long to sleep in microseconds.
+    """
+
+    POLL_STEP = 2000
+    EARLY_WAKEUP = 3000
+    MIN_INTERVAL = 5000
+    MAX_INTERVAL = 1000000
+    IDLE_AFTER = 1000000
+    IDLE_BACKOFF_START = 10000
+    IDLE_BACKOFF_MAX = 200000
+
+    def __init__(self):
+        self._last_frame = None
+        self._interval = 0
+        self._backoff = 0
+
+    def frame_received(self):
+        """
+        Records the arrival of a frame.
+
+        Returns:
+            None
+        """
+
+        now = time.monotonic()
+        if self._last_frame is not None:
+            sample = (now - self._last_frame) * 1e6
+            sample = min(max(sample, self.MIN_INTERVAL), self.MAX_INTERVAL)
+            if self._interval == 0:
+                self._interval = sample
+            else:
+                self._interval = (self._interval * 7 + sample) / 8
+        self._last_frame = now
+        self._backoff = 0
+
+    def next_delay(self):
+        """
+        Returns how long to sleep after no data was ready.
+
+        Returns:
+            int: Delay in microseconds.
+        """
+
+        if self._last_frame is None:
+            since_frame = self.IDLE_AFTER + 1
+        else:
+            since_frame = (time.monotonic() - self._last_frame) * 1e6
+
+        if since_frame > self.IDLE_AFTER:
+            if self._backoff == 0:
+                self._backoff = self.IDLE_BACKOFF_START
+            else:
+                self._backoff = min(self._backoff * 2, self.IDLE_BACKOFF_MAX)
+            return self._backoff
+
+        return int(max(self._interval - self.EARLY_WAKEUP - since_frame, self.POLL_STEP))
+
+
+class StartupTimer():
+    """
+    Logs how long the steps of the startup take, from the start of the proxy and
+    from the previous step, so a slow step shows up in the log.
+
+    Methods:
+        mark(self, step): Logs that a step is done.
+    """
+
+    def __init__(self, name, started=PROCESS_START):
+        self._name = name
+        self._started = started
+        self._last = started
+        self._lock = threading.Lock()
+
+    def mark(self, step):
+        """
+        Logs that a step is done.
+
+        Args:
+        - step (str): What is done.
+
+        Returns:
+            float: Seconds since the start.
+        """
+
+        with self._lock:
+            now = time.monotonic()
+            since_last = now - self._last
+            self._last = now
+        print(f"[{self._name}] Startup: {step} after {now - self._started:.2f} s "
+              f"(+{since_last:.2f} s)")
+        return now - self._started
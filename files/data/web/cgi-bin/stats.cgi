@@ -0,0 +1,144 @@
+#!/bin/sh
+
+# Reports the load of the camera as one line of JSON, so the proxy and
+# dashboards can tell limits of the camera apart from those of the host:
+#
+#   cpu     Usage of all CPUs over the sample in percent, and the load average
+#   memory  Total and available memory in kB
+#   wlan0   Link quality, signal and noise level from /proc/net/wireless, and
+#           the receive and send rate over the sample, the stream is most of tx
+#   dgiot   Threads of dgiot, its CPU usage and that of its busiest threads in
+#           percent of one CPU, the encoder and the TUTK server run in there
+#
+# Takes SAMPLE_S to answer, the rates are measured between two snapshots.
+
+BUSYBOX="/mnt/busybox"
+SAMPLE_S=1
+BUSIEST_THREADS=5
+
+DGIOT_PID=$(${BUSYBOX} pidof dgiot | ${BUSYBOX} awk '{print $1}')
+
+snapshot () {
+    echo "# stat"
+    ${BUSYBOX} head -n 1 /proc/stat
+    echo "# net"
+    ${BUSYBOX} grep "wlan0:" /proc/net/dev
+    if [ -n "${DGIOT_PID}" ]
+    then
+        echo "# tasks"
+        cat /proc/${DGIOT_PID}/task/*/stat 2>/dev/null
+    fi
+}
+
+echo -en "Content-Type: application/json\r\n\r\n"
+
+{
+    echo "# sample 0"
+    snapshot
+    sleep ${SAMPLE_S}
+    echo "# sample 1"
+    snapshot
+    echo "# memory"
+    cat /proc/meminfo
+    echo "# wireless"
+    cat /proc/net/wireless
+    echo "# load"
+    cat /proc/loadavg
+    echo "# uptime"
+    cat /proc/uptime
+    echo "# cpus"
+    ${BUSYBOX} grep -c "^processor" /proc/cpuinfo
+} | ${BUSYBOX} awk -v pid="${DGIOT_PID}" -v sample_s="${SAMPLE_S}" -v busiest="${BUSIEST_THREADS}" '
+function percent(part, whole) {
+    return whole > 0 ? sprintf("%.1f", 100 * part / whole) : "0.0"
+}
+function json_string(value) {
+    gsub(/["\\]/, "", value)
+    return "\"" value "\""
+}
+/^# / { section = $2; if (section == "sample") sample = $3; next }
+section == "stat" {
+    total[sample] = 0
+    for (i = 2; i <= NF; i++) total[sample] += $i
+    # idle and iowait
+    idle[sample] = $5 + $6
+}
+section == "net" {
+    sub(/^[^:]*:/, "")
+    rx[sample] = $1
+    tx[sample] = $9
+}
+section == "tasks" {
+    # The name is in parentheses and may contain spaces
+    tid = $1
+    name = $0
+    sub(/^[^(]*\(/, "", name)
+    sub(/\)[^)]*$/, "", name)
+    rest = $0
+    sub(/^.*\) /, "", rest)
+    split(rest, field, " ")
+    # utime and stime
+    ticks[sample, tid] = field[12] + field[13]
+    if (sample == 1) {
+        names[tid] = name
+        tids[++threads] = tid
+    }
+}
+section == "memory" && $1 == "MemTotal:" { mem_total = $2 }
+section == "memory" && $1 == "MemFree:" { mem_free = $2 }
+section == "memory" && ($1 == "Buffers:" || $1 == "Cached:") { mem_cache += $2 }
+section == "memory" && $1 == "MemAvailable:" { mem_available = $2 }
+section == "wireless" && $1 == "wlan0:" {
+    link = $3 + 0
+    level = $4 + 0
+    noise = $5 + 0
+    # Some drivers report the levels as unsigned bytes
+    if (level > 0) level -= 256
+    if (noise > 0) noise -= 256
+    wireless = 1
+}
+section == "load" { load = $1 "," $2 "," $3 }
+section == "uptime" { uptime = int($1) }
+section == "cpus" { cpus = $1 > 0 ? $1 : 1 }
+END {
+    elapsed = total[1] - total[0]
+    if (mem_available == "") mem_available = mem_free + mem_cache
+
+    printf "{\"uptime_s\":%d", uptime
+    printf ",\"cpu\":{\"usage\":%s,\"load\":[%s],\"cpus\":%d}", \
+        percent(elapsed - (idle[1] - idle[0]), elapsed), load, cpus
+    printf ",\"memory\":{\"total_kb\":%d,\"available_kb\":%d}", mem_total, mem_available
+    printf ",\"wlan0\":"
+    if (wireless || rx[1] != "") {
+        printf "{\"link\":%d,\"level_dbm\":%d,\"noise_dbm\":%d", link, level, noise
+        printf ",\"rx_kbps\":%d,\"tx_kbps\":%d}", \
+            (rx[1] - rx[0]) * 8 / 1000 / sample_s, (tx[1] - tx[0]) * 8 / 1000 / sample_s
+    } else {
+        printf "null"
+    }
+    printf ",\"dgiot\":"
+    if (pid == "") {
+        printf "null}\n"
+        exit
+    }
+
+    # Jiffies of one CPU over the sample
+    cpu_elapsed = elapsed / cpus
+    process = 0
+    for (i = 1; i <= threads; i++) {
+        used[i] = ticks[1, tids[i]] - ticks[0, tids[i]]
+        process += used[i]
+    }
+    printf "{\"pid\":%d,\"threads\":%d,\"cpu\":%s,\"busiest\":[", pid, threads, \
+        percent(process, cpu_elapsed)
+    for (n = 1; n <= busiest && n <= threads; n++) {
+        top = 0
+        for (i = 1; i <= threads; i++) {
+            if (!taken[i] && (top == 0 || used[i] > used[top])) top = i
+        }
+        taken[top] = 1
+        printf "%s{\"tid\":%d,\"name\":%s,\"cpu\":%s}", (n > 1 ? "," : ""), tids[top], \
+            json_string(names[tids[top]]), percent(used[top], cpu_elapsed)
+    }
+    printf "]}}\n"
+}'